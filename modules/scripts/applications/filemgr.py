@@ -103,25 +103,30 @@ def main(env, *args):
                                     fg=0, bg=252,
                                     width=win.inner_w)
 
+            # ilistdir() has each entry's type already -- no stat() per
+            # file, which is most of the time on an SD card full of MP3s.
             dirs = []
             files = []
-            for name in os.listdir(current_dir):
-                try:
-                    if os.stat(joinpath(current_dir, name))[0] & 0x4000:
-                        dirs.append(name)
-                    else:
-                        files.append(name)
-                except OSError:
-                    files.append(name)
+            for entry in os.ilistdir(current_dir):
+                if entry[1] == 0x4000:
+                    dirs.append(entry[0])
+                else:
+                    files.append(entry[0])
             dirs.sort()
             files.sort()
             items = dirs + files
-            display_items = [n + "/" for n in dirs] + files
             if current_dir != "/":
                 items.insert(0, "..")
-                display_items.insert(0, "..")
+            ndirs = len(items) - len(files)
+
+            # The list asks for the rows it draws only, instead of a
+            # second list of every entry with "/" on the directories.
+            def display_item(i):
+                if i < ndirs and items[i] != "..":
+                    return items[i] + "/"
+                return items[i]
 
-            lst = win.make_list(display_items,
+            lst = win.make_list(display_item, count=len(items),
                                 x=0, y=1,
                                 width=env.cols, height=win.inner_h-2,
                                 fg=252, bg=18,
@@ -182,6 +187,8 @@ def main(env, *args):
                 elif char == "b":
                     current_dir = get_parent(current_dir)
                     break
+                elif char.isupper() or char.isdigit():
+                    lst.search(char)   # type-ahead, see help
                 elif char == "i":    # file/dir info
                     selected_item = items[lst.selected]
                     if selected_item == "..":
@@ -472,7 +479,8 @@ def main(env, *args):
                                  f"{BOLD}c: {CLR}copy file or directory\n"
                                  f"{BOLD}r: {CLR}rename file or directory\n"
                                  f"{BOLD}d: {CLR}delete file or directory\n"
-                                 f"{BOLD}n: {CLR}create new directory\n",
+                                 f"{BOLD}n: {CLR}create new directory\n"
+                                 f"{BOLD}A-Z 0-9: {CLR}jump to name\n",
                                  1, 0,
                                  fg=252, bg=18)
 
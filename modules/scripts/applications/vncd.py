@@ -5,7 +5,9 @@
 #
 # Minimal RFB 3.8 server exposing the terminal screen over VNC. Pixels
 # come from vt.VT.render_row() (fb.c's render_row_rgb565()), rendered on
-# demand per row -- no persistent framebuffer.
+# demand per row -- no persistent framebuffer -- and encoded for the
+# client (pixel format, then ZRLE/TRLE/Raw) by the rfb C module
+# (modules/vt/rfb.c).
 
 import binascii
 import struct
@@ -14,6 +16,7 @@ import select
 import network
 import machine
 import micropython
+import rfb
 
 _MAX_FONT_HEIGHT = 16
 # Every tick makes one micropython.schedule() attempt, which competes for
@@ -32,8 +35,6 @@ _PIXEL_FORMAT = struct.pack(">BBBBHHHBBB",
                             16, 8, 0) + b"\x00\x00\x00"  # red/green/blue-shift + padding
 assert len(_PIXEL_FORMAT) == 16
 
-_DEFAULT_FORMAT = (32, 0, 255, 255, 255, 16, 8, 0)
-
 _SERVER_NAME = b"vtOS"
 
 _KEYSYM_MAP = {
@@ -85,44 +86,19 @@ def _parse_pixel_format(body):
     return (bpp, big_endian, true_color, r_max, g_max, b_max,
            r_shift, g_shift, b_shift)
 
-def _rgb565_row_to_pixfmt(src, n_bytes, dst, fmt):
-    """Converts n_bytes of big-endian RGB565 (render_row()'s native
-    output) into the true-color format `fmt` describes -- (bpp,
-    big_endian, red_max, green_max, blue_max, red_shift, green_shift,
-    blue_shift). Returns the number of bytes written to dst.
-
-    5/6-bit source channels are expanded to 8 bits by bit replication,
-    then scaled to the target's own max-value range before shifting into
-    place.
-    """
-    bpp, big_endian, r_max, g_max, b_max, r_shift, g_shift, b_shift = fmt
-    nbytes = bpp // 8
-    oi = 0
-    for i in range(0, n_bytes, 2):
-        v = (src[i] << 8) | src[i + 1]
-        r5 = (v >> 11) & 0x1F
-        g6 = (v >> 5) & 0x3F
-        b5 = v & 0x1F
-        r8 = (r5 << 3) | (r5 >> 2)
-        g8 = (g6 << 2) | (g6 >> 4)
-        b8 = (b5 << 3) | (b5 >> 2)
-        val = (((r8 * r_max) // 255) << r_shift |
-              ((g8 * g_max) // 255) << g_shift |
-              ((b8 * b_max) // 255) << b_shift)
-        if big_endian:
-            for k in range(nbytes):
-                dst[oi + k] = (val >> ((nbytes - 1 - k) * 8)) & 0xFF
-        else:
-            for k in range(nbytes):
-                dst[oi + k] = (val >> (k * 8)) & 0xFF
-        oi += nbytes
-    return oi
-
 def _scan_changed(conn):
+    # Only rows the VT engine stamped since our last look get rendered --
+    # see VT.changed_since(). The CRC stays as a second filter: a row can
+    # be stamped (rewritten, cursor passed over it) and still end up
+    # pixel-identical to what the client already has.
     term = conn.env.term
     mv = conn.row565_mv
     found = []
-    for idx, y in enumerate(conn.row_indices):
+    conn.gen_token, rows = term.changed_since(conn.gen_token)
+    for y in rows:
+        idx = y + 1  # row_indices is [-1, 0, 1, ...]
+        if idx < 0 or idx >= len(conn.row_indices):
+            continue  # bottom bar -- not part of the remote framebuffer
         n565 = term.render_row(y, conn.row565_buf)
         csum = binascii.crc32(mv[:n565])
         if csum != conn.prev_checksums[idx]:
@@ -136,18 +112,18 @@ def _queue_update(conn, changed):
     width = env.screen_width
     f_height = env.font.HEIGHT
     top_offset = env.status_height
-    fmt = conn.current_format
+    enc = conn.enc
 
     conn.queue(struct.pack(">BBH", 0, 0, len(changed)))
     for y in changed:
         n565 = term.render_row(y, conn.row565_buf)
-        n = _rgb565_row_to_pixfmt(conn.row565_buf, n565, conn.row_buf, fmt)
         y_pos = 0 if y == -1 else top_offset + y * f_height
-        # Header and payload queued separately -- concatenating them would
-        # allocate a second full-size copy of the row on top of the one
-        # bytes() already has to make (conn.row_buf gets overwritten by
-        # the next row before this one necessarily finishes sending).
-        conn.queue(struct.pack(">HHHHI", 0, y_pos, width, f_height, 0))
+        # rect() writes the rectangle header and the encoded pixels in
+        # one go; bytes() copies it out because conn.row_buf gets
+        # overwritten by the next row before this one necessarily
+        # finishes sending.
+        n = enc.rect(conn.row565_buf, 0, y_pos, width, n565 // (2 * width),
+                     conn.row_buf)
         conn.queue(bytes(conn.row_buf[:n]))
 
 class _Conn:
@@ -165,10 +141,11 @@ class _Conn:
 
         self.row565_buf = bytearray(env.screen_width * _MAX_FONT_HEIGHT * 2)
         self.row565_mv = memoryview(self.row565_buf)  # reused for crc32 -- avoids a new memoryview per row per scan
-        self.row_buf = bytearray(env.screen_width * _MAX_FONT_HEIGHT * 4)
-        self.current_format = _DEFAULT_FORMAT
+        self.enc = rfb.Encoder()  # Raw in _PIXEL_FORMAT until the client asks otherwise
+        self.row_buf = bytearray(self.enc.max_size(env.screen_width, _MAX_FONT_HEIGHT))
         self.row_indices = [-1] + list(range(env.rows))  # bar + text rows, computed once
         self.prev_checksums = [None] * (1 + env.rows)  # None forces a full first send
+        self.gen_token = None  # VT.changed_since() token; None = every row
 
         self.awaiting_update = False
         self.wait_ticks = 0
@@ -234,8 +211,8 @@ def _advance(conn, chunk):
         (bpp, big_endian, true_color, r_max, g_max, b_max,
          r_shift, g_shift, b_shift) = _parse_pixel_format(chunk[3:19])
         if true_color and bpp in (8, 16, 24, 32):
-            conn.current_format = (bpp, big_endian, r_max, g_max, b_max,
-                                   r_shift, g_shift, b_shift)
+            conn.enc.set_pixel_format(bpp, big_endian, r_max, g_max, b_max,
+                                      r_shift, g_shift, b_shift)
         # else: colour-map/palette mode or an unsupported bpp -- not
         # implemented, keep using whatever format was active.
         conn.state, conn.need = _ST_MSGTYPE, 1
@@ -248,7 +225,10 @@ def _advance(conn, chunk):
         else:
             conn.state, conn.need = _ST_MSGTYPE, 1
 
-    elif st == _ST_SETENC_LIST:  # Raw is mandatory anyway; list is ignored
+    elif st == _ST_SETENC_LIST:
+        # Signed: pseudo-encodings (cursor, desktop size...) are negative.
+        # The encoder picks the best of ZRLE/TRLE it can, else Raw.
+        conn.enc.set_encodings(struct.unpack(">%di" % conn._setenc_count, chunk))
         conn.state, conn.need = _ST_MSGTYPE, 1
 
     elif st == _ST_FBUR:
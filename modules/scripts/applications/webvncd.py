@@ -23,6 +23,19 @@
 # Wire protocol, client -> server (one binary WebSocket frame):
 #   KeyEvent:  0x02, <utf-8 bytes to inject via env.kvm.inject()>
 #
+# Cell mode -- the client connects to /cells instead of / and draws the
+# glyphs itself, so a changed row costs tens of bytes instead of ~7 KB:
+#   Init:      as above, then mode:u8 (1), cols:u16be, rows:u16be,
+#              cell_width:u8, top:u16be (pixel y of text row 0)
+#   CellRow:   0x03, y:i16be (-1 top bar, -2 bottom bar), <VT.cells()
+#              output -- see encode_row_cells() in modules/vt/fb.c>
+#   Glyph:     0x04, flags:u8 (1 bold, 2 wide), codepoint:u32be,
+#              <1bpp mask, MSB first, rows padded to a byte, 1 = ink>
+#   Cursor:    0x05, x:u16be, y:u16be, visible:u8, style:u8
+# and client -> server:
+#   GlyphReq:  0x03, flags:u8, codepoint:u32be... -- for glyphs the
+#              client hasn't been sent yet; answered with one Glyph each
+#
 # Usage: `webvncd [port]` to start (default 8080), `webvncd stop` to stop.
 
 import binascii
@@ -72,10 +85,18 @@ _ST_WS_MASK = 3     # 4-byte mask key (client frames are always masked)
 _ST_WS_PAYLOAD = 4
 
 def _scan_changed(conn):
+    # Only rows the VT engine stamped since our last look get rendered --
+    # see VT.changed_since(). The CRC stays as a second filter: a row can
+    # be stamped (rewritten, cursor passed over it) and still end up
+    # pixel-identical to what the client already has.
     term = conn.env.term
     mv = conn.row565_mv
     found = []
-    for idx, y in enumerate(conn.row_indices):
+    conn.gen_token, rows = term.changed_since(conn.gen_token)
+    for y in rows:
+        idx = y + 1  # row_indices is [-1, 0, 1, ...]
+        if idx < 0 or idx >= len(conn.row_indices):
+            continue  # bottom bar -- not part of the remote framebuffer
         n565 = term.render_row(y, conn.row565_buf)
         csum = binascii.crc32(mv[:n565])
         if csum != conn.prev_checksums[idx]:
@@ -83,6 +104,32 @@ def _scan_changed(conn):
             found.append(y)
     return found
 
+def _queue_cells(conn, y):
+    n = conn.env.term.cells(y, conn.cell_buf)
+    conn.queue(_ws_frame_header(0x2, 3 + n))
+    conn.queue(struct.pack(">Bh", 0x03, y))
+    conn.queue(bytes(conn.cell_buf[:n]))
+
+def _queue_glyph(conn, flags, cp):
+    n = conn.env.term.glyph(cp, flags, conn.glyph_buf)
+    conn.queue(_ws_frame_header(0x2, 6 + n))
+    conn.queue(struct.pack(">BBI", 0x04, flags, cp))
+    conn.queue(bytes(conn.glyph_buf[:n]))
+
+def _push_cells(conn):
+    # No CRC filter here (unlike _scan_changed()): re-sending a stamped
+    # but unchanged row is cheaper than rendering it to find out.
+    term = conn.env.term
+    conn.gen_token, rows = term.changed_since(conn.gen_token)
+    for y in rows:
+        _queue_cells(conn, y)
+    cur = term.cursor()
+    if cur != conn.cursor:
+        conn.cursor = cur
+        x, y, visible, style = cur
+        conn.queue(_ws_frame_header(0x2, 7))
+        conn.queue(struct.pack(">BHHBB", 0x05, x, y, visible, style))
+
 def _queue_row(conn, y):
     env = conn.env
     n565 = env.term.render_row(y, conn.row565_buf)
@@ -114,7 +161,12 @@ class _Conn:
         self.row565_mv = memoryview(self.row565_buf)
         self.row_indices = [-1] + list(range(env.rows))  # bar + text rows
         self.prev_checksums = [None] * (1 + env.rows)  # None forces a full first send
+        self.gen_token = None  # VT.changed_since() token; None = every row
         self.handshake_done = False  # scanning for changes starts once this flips
+        self.cell_mode = False  # client asked for /cells -- see header comment
+        self.cell_buf = bytearray(256 * 11 + 7)  # VT.cells(), bars can be 256 wide
+        self.glyph_buf = bytearray(4 * 32)  # one 1bpp glyph, up to 32x32
+        self.cursor = None
 
         self._ws_opcode = 0
         self._ws_masked = False
@@ -136,7 +188,10 @@ class _Conn:
 
 def _handle_http_headers(conn, header_bytes):
     key = None
-    for line in header_bytes.split(b"\r\n"):
+    lines = header_bytes.split(b"\r\n")
+    request = lines[0].split()
+    conn.cell_mode = len(request) > 1 and request[1] == b"/cells"
+    for line in lines:
         if line.lower().startswith(b"sec-websocket-key:"):
             key = line.split(b":", 1)[1].strip()
             break
@@ -155,6 +210,9 @@ def _handle_http_headers(conn, header_bytes):
     env = conn.env
     init = struct.pack(">BHHH", 0x00, env.screen_width, env.screen_height,
                        env.font.HEIGHT)
+    if conn.cell_mode:
+        init += struct.pack(">BHHBH", 1, env.term.cols, env.term.rows,
+                            env.font.WIDTH, env.status_height)
     conn.queue(_ws_frame_header(0x2, len(init)))
     conn.queue(init)
 
@@ -208,6 +266,10 @@ def _advance(conn, chunk):
                 text = None
             if text:
                 conn.env.kvm.inject(text)
+        elif opcode == 0x2 and len(payload) >= 6 and payload[0] == 0x03:  # GlyphReq
+            flags = payload[1] & 0x03
+            for i in range(2, len(payload) - 3, 4):
+                _queue_glyph(conn, flags, struct.unpack(">I", payload[i:i + 4])[0])
         elif opcode == 0x8:  # close
             conn.pending_close = True
         elif opcode == 0x9:  # ping -> pong
@@ -348,8 +410,11 @@ class _Server:
         # once past the handshake, just check for changes every tick and
         # push whatever's found. No long-poll/wait bookkeeping needed.
         if not conn.pending_close and conn.handshake_done:
-            for y in _scan_changed(conn):
-                _queue_row(conn, y)
+            if conn.cell_mode:
+                _push_cells(conn)
+            else:
+                for y in _scan_changed(conn):
+                    _queue_row(conn, y)
 
         # Drain as much of the queue as the socket will currently take,
         # rather than one item per tick -- a burst of changed rows (a
@@ -72,8 +72,21 @@ class Environment:
         self.update_font(font)
         self.update_icon_font(icon_font)
 
+    @staticmethod
+    def load_font(font_name):
+        # A packed font in the "fonts" partition (utils/fontpack.py) is
+        # drawn straight from flash; otherwise the frozen module, which
+        # may itself just carry a packed VTF (fontconvert.py --format
+        # vtf-py). Either way vt.Font reads like the module it replaces.
+        font = vt.flash_font(font_name)
+        if font is None:
+            font = __import__(f"fonts.{font_name}", None, None, [font_name])
+            if hasattr(font, "VTF"):
+                font = vt.Font(font.VTF)
+        return font
+
     def update_font(self, font_name):
-        self.font = __import__(f"fonts.{font_name}", None, None, [font_name])
+        self.font = self.load_font(font_name)
         self.font_name = font_name
 
         # Reserve 1 row for a topbar
@@ -94,7 +107,7 @@ class Environment:
             self.icon_font = None
             self.icon_font_name = None
         else:
-            self.icon_font = __import__(f"fonts.{font_name}", None, None, [font_name])
+            self.icon_font = self.load_font(font_name)
             self.icon_font_name = font_name
 
         if self.term:
@@ -109,12 +122,15 @@ tft = st7789.ST7789(spi,
                     dc=machine.Pin(board.TFT_DC, machine.Pin.OUT),
                     cs=machine.Pin(board.TFT_CS, machine.Pin.OUT),
                     backlight=machine.Pin(board.BL, machine.Pin.OUT),
-                    rotation=1,
-                    buffer_size=env.screen_width*16*2)  # buffer_size needs to be: (screen_width * max_font_height * 2)
+                    rotation=1,                         # landscape: the panel can't hardware-scroll vertically here, so the terminal redraws rows
+                    buffer_size=env.screen_width*16*2,  # buffer_size needs to be: (screen_width * max_font_height * 2)
+                    dma_host=1,                         # SPI2_HOST, the bus machine.SPI(1) set up above
+                    dma_baudrate=80000000)
 tft.init()
 
 # Initialize ST engine
-env.term = vt.VT(tft, env)
+env.term = vt.VT(tft, env, scrollback=5000,   # lines, compressed in PSRAM
+                 consoles=4)                  # see set_console_key() below
 env.term.top_offset(env.status_height)
 env.term.set_icon_font(env.icon_font)
 
@@ -132,6 +148,12 @@ tdeck_trk.init(up=board.TBOX_G01,
 # Combine ST & keyboard into one stream object
 env.kvm = tdeck_kvm.KVM(env.term, kbd)
 
+# Virtual consoles switch with env.term.console(n). A keyboard chord is
+# off by default: whatever key starts it is held back until the next one,
+# so it has to be one nothing types on its own -- e.g. if your keyboard
+# firmware sends control codes, Ctrl+\ then 1..4:
+#env.kvm.set_console_key("\x1c")
+
 # Redirect to REPL
 os.dupterm(env.kvm)
 
@@ -151,7 +173,7 @@ def scheduled_fast(_):
             env.kvm.inject("\x1b[B") # Injects 'Down' key into REPL
 
     # Trackball vertical movement translates into showing history
-    # Default history is 100 lines defined as HISTSIZE in st.h
+    # History depth is the scrollback= passed to vt.VT() above
     v_delta = tdeck_trk.get_scroll_vert()
     if abs(v_delta) > 1:
         if v_delta < 0:
@@ -164,8 +186,6 @@ def scheduled_fast(_):
     if tdeck_trk.get_click():
         env.kvm.inject("\x1b")
 
-    env.term.draw()
-
 def fast_loop(_):
     # Use schedule to keep the ISR (Interrupt Service Routine) light.
     # schedule() raises RuntimeError if its queue is already full (e.g.
@@ -188,9 +208,12 @@ def slow_loop(_):
     except RuntimeError:
         pass
 
-# 30ms = ~33 FPS.
-draw_timer = machine.Timer(0)
-draw_timer.init(period=30, mode=machine.Timer.PERIODIC, callback=fast_loop)
+# The VT draws on its own now, 10 ms after the first change and not at
+# all while nothing changes -- this timer only polls the trackball.
+env.term.autodraw(10)
+
+input_timer = machine.Timer(0)
+input_timer.init(period=30, mode=machine.Timer.PERIODIC, callback=fast_loop)
 
 statusbar_timer = machine.Timer(1)
 statusbar_timer.init(period=1000, mode=machine.Timer.PERIODIC, callback=slow_loop)
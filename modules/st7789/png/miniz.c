@@ -191,7 +191,7 @@
 //#define MINIZ_NO_MALLOC
 
 //
-#define MINIZ_NO_COMPRESSION
+//#define MINIZ_NO_COMPRESSION
 
 
 #if defined(__TINYC__) && (defined(__linux) || defined(__linux__))
@@ -780,7 +780,7 @@ struct tinfl_decompressor_tag
 // ------------------- Low-level Compression API Definitions
 
 // Set TDEFL_LESS_MEMORY to 1 to use less memory (compression will be slightly slower, and raw/dynamic blocks will be output more frequently).
-#define TDEFL_LESS_MEMORY 0
+#define TDEFL_LESS_MEMORY 1
 
 // tdefl_init() compression flags logically OR'd together (low 12 bits contain the max. number of probes per dictionary search):
 // TDEFL_DEFAULT_MAX_PROBES: The compressor defaults to 128 dictionary probes per dictionary search. 0=Huffman only, 1=Huffman+LZ (fastest/crap compression), 4095=Huffman+LZ (slowest/best compression).
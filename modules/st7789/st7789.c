@@ -46,6 +46,13 @@
 #include "extmod/machine_spi.h"
 #endif
 
+#ifdef ESP_PLATFORM
+#include "driver/gpio.h"
+#include "hal/gpio_ll.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#endif
+
 #include "mpfile.h"
 #include "st7789.h"
 #include "jpg/tjpgd565.h"
@@ -172,7 +179,270 @@ static void st7789_ST7789_print(const mp_print_t *print, mp_obj_t self_in, mp_pr
     mp_printf(print, "<ST7789 width=%u, height=%u, spi=%p>", self->width, self->height, self->spi_obj);
 }
 
+#ifdef ESP_PLATFORM
+// Shadow framebuffer. set_window() only moves fb's write position and the
+// data paths copy into it, marking the columns they touch in fb_dirty;
+// nothing reaches the panel until st7789_flush(). Layers drawn over each
+// other between two flushes -- terminal rows, bars, an image, an overlay
+// on top -- then cost one write of the final pixels instead of one per
+// layer, and fb always holds what the screen shows (or is about to).
+
+#define FB_ACTIVE(self) ((self)->fb && !(self)->fb_flushing)
+
+static void fb_mark(st7789_ST7789_obj_t *self, int y, uint16_t x0, uint16_t x1) {
+    uint16_t *d = &self->fb_dirty[y * 2];
+    if (x0 < d[0]) {
+        d[0] = x0;
+    }
+    if (x1 > d[1]) {
+        d[1] = x1;
+    }
+}
+
+static void fb_dirty_all(st7789_ST7789_obj_t *self) {
+    for (int y = 0; y < self->height; y++) {
+        self->fb_dirty[y * 2] = 0;
+        self->fb_dirty[y * 2 + 1] = self->width - 1;
+    }
+}
+
+// Writes len bytes at the current position in the window, the way the
+// panel would take them: row by row, wrapping back to the top when the
+// window is full. With fill, buf is one pixel, repeated len / 2 times.
+static void fb_put(st7789_ST7789_obj_t *self, const uint8_t *buf, size_t len, bool fill) {
+    size_t row_bytes = (self->fb_x1 - self->fb_x0 + 1) * 2;
+    size_t total = row_bytes * (self->fb_y1 - self->fb_y0 + 1);
+
+    while (len > 0) {
+        if (self->fb_pos >= total) {
+            self->fb_pos = 0;
+        }
+        size_t col = self->fb_pos % row_bytes;
+        size_t n = MIN(len, row_bytes - col);
+        int y = self->fb_y0 + self->fb_pos / row_bytes;
+        uint8_t *dst = self->fb + ((size_t)y * self->width + self->fb_x0) * 2 + col;
+
+        if (fill) {
+            for (size_t i = 0; i + 1 < n; i += 2) {
+                dst[i] = buf[0];
+                dst[i + 1] = buf[1];
+            }
+        } else {
+            memcpy(dst, buf, n);
+            buf += n;
+        }
+        fb_mark(self, y, self->fb_x0 + col / 2, self->fb_x0 + (col + n - 1) / 2);
+        self->fb_pos += n;
+        len -= n;
+    }
+}
+
+// Dirty rows go out as rectangles: consecutive rows with the same dirty
+// columns share one window, which set_window() can often continue from
+// the previous one anyway. Rows are copied out of PSRAM a stage buffer at
+// a time, ping-ponged under st7789_dma_write().
+static void fb_push(st7789_ST7789_obj_t *self) {
+    uint16_t *d = self->fb_dirty;
+    int stage = 0;
+
+    self->fb_flushing = true;
+    for (int y = 0; y < self->height;) {
+        uint16_t x0 = d[y * 2], x1 = d[y * 2 + 1];
+        if (x0 > x1) {
+            y++;
+            continue;
+        }
+        int y1 = y;
+        while (y1 + 1 < self->height && d[(y1 + 1) * 2] == x0 && d[(y1 + 1) * 2 + 1] == x1) {
+            y1++;
+        }
+
+        set_window(self, x0, y, x1, y1);
+        size_t row_bytes = (x1 - x0 + 1) * 2;
+        int rows_per = MAX(1, ST7789_FB_STAGE / row_bytes);
+        for (int r = y; r <= y1; r += rows_per) {
+            int n = MIN(rows_per, y1 - r + 1);
+            uint8_t *out = self->fb_stage[stage];
+            for (int k = 0; k < n; k++) {
+                memcpy(out + k * row_bytes, self->fb + ((size_t)(r + k) * self->width + x0) * 2, row_bytes);
+            }
+            if (st7789_dma_write(self, out, n * row_bytes)) {
+                stage ^= 1;
+            } else {
+                st7789_write_data(self, out, n * row_bytes);
+            }
+        }
+
+        for (int r = y; r <= y1; r++) {
+            d[r * 2] = 0xFFFF;
+            d[r * 2 + 1] = 0;
+        }
+        y = y1 + 1;
+    }
+    self->fb_flushing = false;
+}
+#endif
+
+void st7789_flush(st7789_ST7789_obj_t *self) {
+    #ifdef ESP_PLATFORM
+    if (self->fb) {
+        fb_push(self);
+    }
+    #endif
+    st7789_dma_wait(self);
+}
+
+// Accounts len bytes of pixel data against the window set_window() last
+// opened. Writing past its end isn't something set_window() can build
+// on, so that closes it.
+static void window_consume(st7789_ST7789_obj_t *self, uint32_t len) {
+    if (len > self->win_left) {
+        self->win_open = false;
+        self->win_left = 0;
+    } else {
+        self->win_left -= len;
+    }
+}
+
+bool st7789_dma_available(st7789_ST7789_obj_t *self) {
+    #ifdef ESP_PLATFORM
+    return self->dma_dev != NULL;
+    #else
+    return false;
+    #endif
+}
+
+#ifdef ESP_PLATFORM
+// The queued path doesn't hold CS across calls the way the blocking one
+// does: each transaction asserts CS and sets DC for itself just before
+// it is clocked out, and releases CS right after.
+//
+// The callbacks run in the SPI ISR, which may fire while the flash cache
+// is off, so they can't call into flash (gpio_set_level()) or read the
+// object (it's on the GC heap, in PSRAM). Everything they need is packed
+// into t->user instead -- the DC pin, the CS pin (0xff = none) and the
+// DC level -- and they write the GPIO registers through gpio_ll.
+#define DMA_USER(self, level) ((void *)(uintptr_t)( \
+    ((uint32_t)(self)->dc & 0xff) | \
+    (((self)->cs == GPIO_NUM_NC ? 0xffu : ((uint32_t)(self)->cs & 0xff)) << 8) | \
+    ((level) ? 1u << 16 : 0)))
+#define DMA_USER_DC_PIN(u) ((uintptr_t)(u) & 0xff)
+#define DMA_USER_CS_PIN(u) (((uintptr_t)(u) >> 8) & 0xff)
+#define DMA_USER_DC(u) (((uintptr_t)(u) >> 16) & 1)
+
+static void IRAM_ATTR dma_pre_cb(spi_transaction_t *t) {
+    gpio_ll_set_level(&GPIO, DMA_USER_DC_PIN(t->user), DMA_USER_DC(t->user));
+    if (DMA_USER_CS_PIN(t->user) != 0xff) {
+        gpio_ll_set_level(&GPIO, DMA_USER_CS_PIN(t->user), 0);
+    }
+}
+
+static void IRAM_ATTR dma_post_cb(spi_transaction_t *t) {
+    if (DMA_USER_CS_PIN(t->user) != 0xff) {
+        gpio_ll_set_level(&GPIO, DMA_USER_CS_PIN(t->user), 1);
+    }
+}
+
+// Collects the oldest queued transaction (they complete in order),
+// freeing its ring slot.
+static void dma_reap(st7789_ST7789_obj_t *self) {
+    spi_transaction_t *done;
+    spi_device_get_trans_result(self->dma_dev, &done, portMAX_DELAY);
+    self->dma_done++;
+}
+
+// Queues len bytes with DC at dc. Up to 4 bytes are copied into the
+// descriptor itself, so command bytes and their parameters need no
+// buffer that outlives the call; anything longer is sent straight from
+// buf, in ST7789_DMA_CHUNK pieces, and buf must stay put until it has
+// been reaped.
+static bool dma_queue(st7789_ST7789_obj_t *self, int dc, const uint8_t *buf, int len) {
+    while (len > 0) {
+        int n = MIN(len, ST7789_DMA_CHUNK);
+        if (self->dma_queued - self->dma_done == ST7789_QUEUE_DEPTH) {
+            dma_reap(self);
+        }
+        spi_transaction_t *t = &self->dma_ring[self->dma_queued % ST7789_QUEUE_DEPTH];
+        memset(t, 0, sizeof(*t));
+        t->length = n * 8;  // in bits
+        t->user = DMA_USER(self, dc);
+        if (n <= 4) {
+            t->flags = SPI_TRANS_USE_TXDATA;
+            memcpy(t->tx_data, buf, n);
+        } else {
+            t->tx_buffer = buf;
+        }
+        if (spi_device_queue_trans(self->dma_dev, t, portMAX_DELAY) != ESP_OK) {
+            return false;
+        }
+        self->dma_queued++;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+#endif
+
+bool st7789_dma_write(st7789_ST7789_obj_t *self, const uint8_t *buf, int len) {
+    #ifdef ESP_PLATFORM
+    if (FB_ACTIVE(self) && len > 0) {
+        fb_put(self, buf, len, false);
+        return true;
+    }
+    if (!self->dma_dev || len <= 0) {
+        return false;
+    }
+    window_consume(self, len);
+    while ((int32_t)(self->dma_done - self->dma_burst_end) < 0) {
+        dma_reap(self);
+    }
+    if (!dma_queue(self, 1, buf, len)) {
+        // Whatever part did get queued has to finish before the caller
+        // resends the lot the blocking way.
+        st7789_dma_wait(self);
+        return false;
+    }
+    self->dma_burst_end = self->dma_queued;
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+void st7789_dma_wait(st7789_ST7789_obj_t *self) {
+    #ifdef ESP_PLATFORM
+    if (!self->dma_dev) {
+        return;
+    }
+    while (self->dma_done != self->dma_queued) {
+        dma_reap(self);
+    }
+    #endif
+}
+
 static void write_cmd(st7789_ST7789_obj_t *self, uint8_t cmd, const uint8_t *data, int len) {
+    // Any command ends a RAMWR. Scrolling leaves CASET/RASET alone, but
+    // anything else (resets, MADCTL, init sequences, a CASET/RASET from
+    // somewhere other than set_window()) may not -- set_window() marks
+    // its own commands valid again after sending them.
+    self->win_open = false;
+    if (cmd != ST7789_VSCSAD && cmd != ST7789_VSCRDEF) {
+        self->win_valid = false;
+    }
+
+    #ifdef ESP_PLATFORM
+    // Queued, a command and up to 4 parameter bytes ride in their
+    // descriptors and nothing waits -- set_window() is five of these.
+    // Longer parameter lists (init sequences, VSCRDEF) are rare enough to
+    // just go the blocking way.
+    if (self->dma_dev && len <= 4) {
+        if ((!cmd || dma_queue(self, 0, &cmd, 1)) &&
+            (len <= 0 || dma_queue(self, 1, data, len))) {
+            return;
+        }
+    }
+    #endif
+    st7789_dma_wait(self);
     CS_LOW()
     if (cmd) {
         DC_LOW();
@@ -185,6 +455,102 @@ static void write_cmd(st7789_ST7789_obj_t *self, uint8_t cmd, const uint8_t *dat
     CS_HIGH()
 }
 
+void st7789_write_data(st7789_ST7789_obj_t *self, const uint8_t *buf, int len) {
+    if (len <= 0) {
+        return;
+    }
+    #ifdef ESP_PLATFORM
+    if (FB_ACTIVE(self)) {
+        fb_put(self, buf, len, false);
+        return;
+    }
+    #endif
+    window_consume(self, len);
+    #ifdef ESP_PLATFORM
+    if (self->dma_dev) {
+        bool queued = dma_queue(self, 1, buf, len);
+        // A short write was copied into its descriptor and can stay in
+        // flight; a longer one is still reading buf.
+        if (queued && len <= 4) {
+            return;
+        }
+        st7789_dma_wait(self);
+        if (queued) {
+            return;
+        }
+    }
+    #endif
+    DC_HIGH();
+    CS_LOW()
+    write_spi(self->spi_obj, buf, len);
+    CS_HIGH()
+}
+
+// Sends length pixels of color for the window just set. Queued, the
+// pixels come from a DMA buffer that holds its color until a fill with a
+// different one, so a fill can be left in flight like any command.
+static void fill_color(st7789_ST7789_obj_t *self, uint16_t color, int length) {
+    uint16_t color_swapped = _swap_bytes(color);
+
+    #ifdef ESP_PLATFORM
+    if (FB_ACTIVE(self)) {
+        if (length > 0) {
+            fb_put(self, (const uint8_t *)&color_swapped, length * 2, true);
+        }
+        return;
+    }
+    #endif
+
+    window_consume(self, length * 2);
+
+    #ifdef ESP_PLATFORM
+    if (self->dma_fill) {
+        if (!self->dma_fill_valid || self->dma_fill_color != color_swapped) {
+            st7789_dma_wait(self);
+            for (int i = 0; i < ST7789_FILL_PIXELS; i++) {
+                self->dma_fill[i] = color_swapped;
+            }
+            self->dma_fill_color = color_swapped;
+            self->dma_fill_valid = true;
+        }
+        while (length > 0) {
+            int n = MIN(length, ST7789_FILL_PIXELS);
+            if (!dma_queue(self, 1, (const uint8_t *)self->dma_fill, n * 2)) {
+                st7789_dma_wait(self);
+                break;
+            }
+            length -= n;
+        }
+        if (length <= 0) {
+            return;
+        }
+    }
+    #endif
+
+    const int buffer_pixel_size = 128;
+    int chunks = length / buffer_pixel_size;
+    int rest = length % buffer_pixel_size;
+    uint16_t buffer[buffer_pixel_size];      // 128 pixels
+
+    // fill buffer with color data
+
+    for (int i = 0; i < length && i < buffer_pixel_size; i++) {
+        buffer[i] = color_swapped;
+    }
+    st7789_dma_wait(self);
+    DC_HIGH();
+    CS_LOW();
+    if (chunks) {
+        for (int j = 0; j < chunks; j++) {
+            write_spi(self->spi_obj, (uint8_t *)buffer, buffer_pixel_size * 2);
+        }
+    }
+    if (rest) {
+        write_spi(self->spi_obj, (uint8_t *)buffer, rest * 2);
+    }
+    CS_HIGH();
+}
+
 void set_window(st7789_ST7789_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
     if (x0 > x1 || x1 >= self->width) {
         return;
@@ -208,11 +574,53 @@ void set_window(st7789_ST7789_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1
         }
     }
 
-    uint8_t bufx[4] = {(x0 + self->colstart) >> 8, (x0 + self->colstart) & 0xFF, (x1 + self->colstart) >> 8, (x1 + self->colstart) & 0xFF};
-    uint8_t bufy[4] = {(y0 + self->rowstart) >> 8, (y0 + self->rowstart) & 0xFF, (y1 + self->rowstart) >> 8, (y1 + self->rowstart) & 0xFF};
-    write_cmd(self, ST7789_CASET, bufx, 4);
-    write_cmd(self, ST7789_RASET, bufy, 4);
+    #ifdef ESP_PLATFORM
+    if (FB_ACTIVE(self)) {
+        self->fb_x0 = x0;
+        self->fb_x1 = x1;
+        self->fb_y0 = y0;
+        self->fb_y1 = y1;
+        self->fb_pos = 0;
+        return;
+    }
+    #endif
+
+    uint16_t cx0 = x0 + self->colstart, cx1 = x1 + self->colstart;
+    uint16_t cy0 = y0 + self->rowstart, cy1 = y1 + self->rowstart;
+    uint32_t bytes = (uint32_t)(x1 - x0 + 1) * (y1 - y0 + 1) * 2;
+
+    // RASET always runs to the bottom of the screen, not just to y1:
+    // the panel stops wherever the data does, and a window that picks up
+    // on the very next row with the same columns -- xdrawline() walking
+    // down a redraw, a jpg band after band -- is then just more data for
+    // the RAMWR already running, without any command at all.
+    if (self->win_open && self->win_left == 0 && self->win_x0 == cx0 &&
+        self->win_x1 == cx1 && self->win_next_y == cy0) {
+        self->win_next_y = cy1 + 1;
+        self->win_left = bytes;
+        return;
+    }
+
+    bool same_x = self->win_valid && self->win_x0 == cx0 && self->win_x1 == cx1;
+    bool same_y = self->win_valid && self->win_y0 == cy0;
+    uint16_t y_end = self->height - 1 + self->rowstart;
+    uint8_t bufx[4] = {cx0 >> 8, cx0 & 0xFF, cx1 >> 8, cx1 & 0xFF};
+    uint8_t bufy[4] = {cy0 >> 8, cy0 & 0xFF, y_end >> 8, y_end & 0xFF};
+    if (!same_x) {
+        write_cmd(self, ST7789_CASET, bufx, 4);
+    }
+    if (!same_y) {
+        write_cmd(self, ST7789_RASET, bufy, 4);
+    }
     write_cmd(self, ST7789_RAMWR, NULL, 0);
+
+    self->win_valid = true;
+    self->win_open = true;
+    self->win_x0 = cx0;
+    self->win_x1 = cx1;
+    self->win_y0 = cy0;
+    self->win_next_y = cy1 + 1;
+    self->win_left = bytes;
 }
 
 static mp_obj_t st7789_ST7789_set_window(size_t n_args, const mp_obj_t *args) {
@@ -222,33 +630,15 @@ static mp_obj_t st7789_ST7789_set_window(size_t n_args, const mp_obj_t *args) {
     mp_int_t x1 = mp_obj_get_int(args[3]);
     mp_int_t y1 = mp_obj_get_int(args[4]);
     set_window(self, x0, y0, x1, y1);
+    // The caller sends the pixels itself, through machine.SPI -- and
+    // maybe not exactly that many.
+    st7789_dma_wait(self);
+    self->win_open = false;
     return mp_const_none;
 }
 
 static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(st7789_ST7789_set_window_obj, 5, 5, st7789_ST7789_set_window);
 
-static void fill_color_buffer(mp_obj_base_t *spi_obj, uint16_t color, int length) {
-    const int buffer_pixel_size = 128;
-    int chunks = length / buffer_pixel_size;
-    int rest = length % buffer_pixel_size;
-    uint16_t color_swapped = _swap_bytes(color);
-    uint16_t buffer[buffer_pixel_size];      // 128 pixels
-
-    // fill buffer with color data
-
-    for (int i = 0; i < length && i < buffer_pixel_size; i++) {
-        buffer[i] = color_swapped;
-    }
-    if (chunks) {
-        for (int j = 0; j < chunks; j++) {
-            write_spi(spi_obj, (uint8_t *)buffer, buffer_pixel_size * 2);
-        }
-    }
-    if (rest) {
-        write_spi(spi_obj, (uint8_t *)buffer, rest * 2);
-    }
-}
-
 int mod(int x, int m) {
     int r = x % m;
     return (r < 0) ? r + m : r;
@@ -265,13 +655,9 @@ void draw_pixel(st7789_ST7789_obj_t *self, int16_t x, int16_t y, uint16_t color)
     }
 
     if ((x < self->width) && (y < self->height) && (x >= 0) && (y >= 0)) {
-        uint8_t hi = color >> 8, lo = color & 0xff;
+        uint8_t px[2] = {color >> 8, color & 0xff};
         set_window(self, x, y, x, y);
-        DC_HIGH();
-        CS_LOW();
-        write_spi(self->spi_obj, &hi, 1);
-        write_spi(self->spi_obj, &lo, 1);
-        CS_HIGH();
+        st7789_write_data(self, px, 2);
     }
 }
 
@@ -290,10 +676,7 @@ void fast_hline(st7789_ST7789_obj_t *self, int16_t x, int16_t y, int16_t w, uint
             if (w > 0) {
                 int16_t x2 = x + w - 1;
                 set_window(self, x, y, x2, y);
-                DC_HIGH();
-                CS_LOW();
-                fill_color_buffer(self->spi_obj, color, w);
-                CS_HIGH();
+                fill_color(self, color, w);
             }
         }
     } else {
@@ -319,10 +702,7 @@ static void fast_vline(st7789_ST7789_obj_t *self, int16_t x, int16_t y, int16_t
                 int16_t y2 = y + h - 1;
 
                 set_window(self, x, y, x, y2);
-                DC_HIGH();
-                CS_LOW();
-                fill_color_buffer(self->spi_obj, color, h);
-                CS_HIGH();
+                fill_color(self, color, h);
             }
         }
     } else {
@@ -335,6 +715,9 @@ static void fast_vline(st7789_ST7789_obj_t *self, int16_t x, int16_t y, int16_t
 static mp_obj_t st7789_ST7789_hard_reset(mp_obj_t self_in) {
     st7789_ST7789_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
+    st7789_dma_wait(self);
+    self->win_valid = false;
+    self->win_open = false;
     CS_LOW();
     RESET_HIGH();
     mp_hal_delay_ms(50);
@@ -401,10 +784,7 @@ static mp_obj_t st7789_ST7789_fill_rect(size_t n_args, const mp_obj_t *args) {
         }
 
         set_window(self, x, y, right, bottom);
-        DC_HIGH();
-        CS_LOW();
-        fill_color_buffer(self->spi_obj, color, w * h);
-        CS_HIGH();
+        fill_color(self, color, w * h);
     }
     return mp_const_none;
 }
@@ -415,10 +795,7 @@ static mp_obj_t st7789_ST7789_fill(mp_obj_t self_in, mp_obj_t _color) {
     mp_int_t color = mp_obj_get_int(_color);
 
     set_window(self, 0, 0, self->width - 1, self->height - 1);
-    DC_HIGH();
-    CS_LOW();
-    fill_color_buffer(self->spi_obj, color, self->width * self->height);
-    CS_HIGH();
+    fill_color(self, color, self->width * self->height);
 
     return mp_const_none;
 }
@@ -521,21 +898,7 @@ static mp_obj_t st7789_ST7789_blit_buffer(size_t n_args, const mp_obj_t *args) {
     mp_int_t h = mp_obj_get_int(args[5]);
 
     set_window(self, x, y, x + w - 1, y + h - 1);
-    DC_HIGH();
-    CS_LOW();
-
-    const int buf_size = 256;
-    int limit = MIN(buf_info.len, w * h * 2);
-    int chunks = limit / buf_size;
-    int rest = limit % buf_size;
-    int i = 0;
-    for (; i < chunks; i++) {
-        write_spi(self->spi_obj, (const uint8_t *)buf_info.buf + i * buf_size, buf_size);
-    }
-    if (rest) {
-        write_spi(self->spi_obj, (const uint8_t *)buf_info.buf + i * buf_size, rest);
-    }
-    CS_HIGH();
+    st7789_write_data(self, (const uint8_t *)buf_info.buf, MIN(buf_info.len, w * h * 2));
 
     return mp_const_none;
 }
@@ -860,10 +1223,7 @@ mp_obj_t st7789_ST7789_write_raw(st7789_ST7789_obj_t *self, mp_obj_module_t *fon
                 uint16_t y2 = y + height - 1;
                 if (x2 < self->width) {
                     set_window(self, x, y, x2, y2);
-                    DC_HIGH();
-                    CS_LOW();
-                    write_spi(self->spi_obj, (uint8_t *)self->i2c_buffer, data_size);
-                    CS_HIGH();
+                    st7789_write_data(self, (uint8_t *)self->i2c_buffer, data_size);
                     print_width += width;
                 }
                 x += width;
@@ -982,10 +1342,7 @@ static mp_obj_t st7789_ST7789_bitmap(size_t n_args, const mp_obj_t *args) {
     uint16_t x1 = x + width - 1;
     if (x1 < self->width) {
         set_window(self, x, y, x1, y + height - 1);
-        DC_HIGH();
-        CS_LOW();
-        write_spi(self->spi_obj, (uint8_t *)self->i2c_buffer, buf_size);
-        CS_HIGH();
+        st7789_write_data(self, (uint8_t *)self->i2c_buffer, buf_size);
     }
 
     if (self->buffer_size == 0) {
@@ -1084,10 +1441,7 @@ static mp_obj_t st7789_ST7789_text(size_t n_args, const mp_obj_t *args) {
                 uint16_t x1 = x0 + width - 1;
                 if (x1 < self->width) {
                     set_window(self, x0, y0, x1, y0 + height - 1);
-                    DC_HIGH();
-                    CS_LOW();
-                    write_spi(self->spi_obj, (uint8_t *)self->i2c_buffer, buf_size);
-                    CS_HIGH();
+                    st7789_write_data(self, (uint8_t *)self->i2c_buffer, buf_size);
                 }
                 x0 += width;
             }
@@ -1148,6 +1502,18 @@ static void set_rotation(st7789_ST7789_obj_t *self) {
 
     const uint8_t madctl[] = {madctl_value};
     write_cmd(self, ST7789_MADCTL, madctl, 1);
+
+    #ifdef ESP_PLATFORM
+    // The framebuffer's contents are laid out for the old width; the
+    // next flush sends all of it again in the new one.
+    if (self->fb) {
+        self->fb_x0 = self->fb_y0 = 0;
+        self->fb_x1 = self->width - 1;
+        self->fb_y1 = self->height - 1;
+        self->fb_pos = 0;
+        fb_dirty_all(self);
+    }
+    #endif
 }
 
 static mp_obj_t st7789_ST7789_rotation(mp_obj_t self_in, mp_obj_t value) {
@@ -1171,14 +1537,49 @@ static mp_obj_t st7789_ST7789_height(mp_obj_t self_in) {
 }
 static MP_DEFINE_CONST_FUN_OBJ_1(st7789_ST7789_height_obj, st7789_ST7789_height);
 
+void st7789_vscroll_define(st7789_ST7789_obj_t *self, uint16_t tfa, uint16_t vsa, uint16_t bfa) {
+    uint8_t buf[6] = {(tfa) >> 8, (tfa) & 0xFF, (vsa) >> 8, (vsa) & 0xFF, (bfa) >> 8, (bfa) & 0xFF};
+    write_cmd(self, ST7789_VSCRDEF, buf, 6);
+}
+
+void st7789_vscroll_start(st7789_ST7789_obj_t *self, uint16_t vssa) {
+    uint8_t buf[2] = {(vssa) >> 8, (vssa) & 0xFF};
+    write_cmd(self, ST7789_VSCSAD, buf, 2);
+}
+
+uint16_t st7789_vscroll_lines(st7789_ST7789_obj_t *self) {
+    // VSCRDEF/VSCSAD always scroll along the controller's 320 gate lines.
+    // That's only the logical y axis when rows aren't exchanged with
+    // columns (MV) or mirrored (MY), and only lines up 1:1 with logical y
+    // when the panel isn't offset into GRAM (rowstart) -- i.e. portrait
+    // rotations of a panel that is actually 320 lines tall.
+    //
+    // With MV set, as in the T-Deck's landscape rotation=1, the gate lines
+    // run along logical x: the panel can only scroll sideways, and no
+    // remapping turns that into a vertical scroll. Hardware scroll is
+    // therefore never used on the T-Deck; fb.c redraws the rows instead.
+    if (self->madctl & (ST7789_MADCTL_MV | ST7789_MADCTL_MY)) {
+        return 0;
+    }
+    #ifdef ESP_PLATFORM
+    // Scrolling the panel would leave the framebuffer behind.
+    if (self->fb) {
+        return 0;
+    }
+    #endif
+    if (self->rowstart != 0 || self->height > ST7789_GRAM_LINES) {
+        return 0;
+    }
+    return ST7789_GRAM_LINES;
+}
+
 static mp_obj_t st7789_ST7789_vscrdef(size_t n_args, const mp_obj_t *args) {
     st7789_ST7789_obj_t *self = MP_OBJ_TO_PTR(args[0]);
     mp_int_t tfa = mp_obj_get_int(args[1]);
     mp_int_t vsa = mp_obj_get_int(args[2]);
     mp_int_t bfa = mp_obj_get_int(args[3]);
 
-    uint8_t buf[6] = {(tfa) >> 8, (tfa) & 0xFF, (vsa) >> 8, (vsa) & 0xFF, (bfa) >> 8, (bfa) & 0xFF};
-    write_cmd(self, ST7789_VSCRDEF, buf, 6);
+    st7789_vscroll_define(self, tfa, vsa, bfa);
 
     return mp_const_none;
 }
@@ -1188,8 +1589,7 @@ static mp_obj_t st7789_ST7789_vscsad(mp_obj_t self_in, mp_obj_t vssa_in) {
     st7789_ST7789_obj_t *self = MP_OBJ_TO_PTR(self_in);
     mp_int_t vssa = mp_obj_get_int(vssa_in);
 
-    uint8_t buf[2] = {(vssa) >> 8, (vssa) & 0xFF};
-    write_cmd(self, ST7789_VSCSAD, buf, 2);
+    st7789_vscroll_start(self, vssa);
 
     return mp_const_none;
 }
@@ -1627,10 +2027,7 @@ static int out_slow(                                    // 1:Ok, 0:Aborted
         rect->right + jd->x_offs,
         rect->bottom + jd->y_offs);
 
-    DC_HIGH();
-    CS_LOW();
-    write_spi(self->spi_obj, (uint8_t *)dev->fbuf, wx2 * h);
-    CS_HIGH();
+    st7789_write_data(self, (uint8_t *)dev->fbuf, wx2 * h);
 
     return 1;     // Continue to decompress
 }
@@ -1712,10 +2109,7 @@ static mp_obj_t st7789_ST7789_jpg(size_t n_args, const mp_obj_t *args) {
             if (res == JDR_OK) {
                 if (mode == JPG_MODE_FAST) {
                     set_window(self, x, y, x + jdec.width - 1, y + jdec.height - 1);
-                    DC_HIGH();
-                    CS_LOW();
-                    write_spi(self->spi_obj, (uint8_t *)self->i2c_buffer, bufsize);
-                    CS_HIGH();
+                    st7789_write_data(self, (uint8_t *)self->i2c_buffer, bufsize);
                 }
             } else {
                 mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("jpg decompress failed."));
@@ -1893,10 +2287,7 @@ typedef struct _PNG_USER_DATA {
 
 void png_flush(st7789_ST7789_obj_t *self, PNG_USER_DATA *user_data) {
         set_window(self, user_data->first, user_data->row, user_data->last, user_data->row);
-        DC_HIGH();
-        CS_LOW();
-        write_spi(self->spi_obj, (uint8_t *)self->i2c_buffer, user_data->pixels * 2);
-        CS_HIGH();
+        st7789_write_data(self, (uint8_t *)self->i2c_buffer, user_data->pixels * 2);
         // reset buffer pointer and pixel count
         user_data->buffer = self->i2c_buffer;
         user_data->pixels = 0;
@@ -2353,6 +2744,69 @@ static mp_obj_t st7789_ST7789_bounding(size_t n_args, const mp_obj_t *args) {
 }
 static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(st7789_ST7789_bounding_obj, 1, 3, st7789_ST7789_bounding);
 
+// With a DMA device (dma_host=...) drawing methods return as soon as
+// their transfers are queued; flush() blocks until all of it is on the
+// panel, and is the one to call at the end of a frame: with a
+// framebuffer (framebuffer=True) it first sends whatever was drawn into
+// it, and nothing reaches the panel without it. A no-op on the blocking
+// path with no framebuffer.
+static mp_obj_t st7789_ST7789_flush(mp_obj_t self_in) {
+    st7789_ST7789_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    st7789_flush(self);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(st7789_ST7789_flush_obj, st7789_ST7789_flush);
+
+// deinit() -- lets whatever is still queued finish, detaches the DMA
+// device from the bus and frees the framebuffer; drawing after it takes
+// the blocking path straight to the panel. Also the finaliser: SPI2 only
+// has a few device slots, and the framebuffer is ~150KB of PSRAM (plus
+// DMA-capable staging and fill buffers from internal RAM) that each soft
+// reset would otherwise leave behind with a dead object.
+static mp_obj_t st7789_ST7789_deinit(mp_obj_t self_in) {
+    st7789_ST7789_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    #ifdef ESP_PLATFORM
+    if (self->dma_dev) {
+        st7789_dma_wait(self);
+        spi_bus_remove_device(self->dma_dev);
+        self->dma_dev = NULL;
+        heap_caps_free(self->dma_ring);
+        self->dma_ring = NULL;
+    }
+    heap_caps_free(self->dma_fill);
+    self->dma_fill = NULL;
+    self->dma_fill_valid = false;
+    if (self->fb) {
+        heap_caps_free(self->fb);
+        heap_caps_free(self->fb_dirty);
+        heap_caps_free(self->fb_stage[0]);
+        heap_caps_free(self->fb_stage[1]);
+        self->fb = NULL;
+        self->fb_dirty = NULL;
+        self->fb_stage[0] = self->fb_stage[1] = NULL;
+    }
+    #endif
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(st7789_ST7789_deinit_obj, st7789_ST7789_deinit);
+
+// framebuffer() -> memoryview of the shadow framebuffer (width * height
+// RGB565 pixels, big-endian, row-major at the current rotation), or None
+// without one. Reading it costs nothing: screenshots, or a remote viewer
+// after a flush(), can take the pixels straight from here instead of
+// rendering them again. It holds what has been drawn, which may be ahead
+// of the panel until the next flush().
+static mp_obj_t st7789_ST7789_framebuffer(mp_obj_t self_in) {
+    #ifdef ESP_PLATFORM
+    st7789_ST7789_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->fb) {
+        return mp_obj_new_memoryview('B', (size_t)self->width * self->height * 2, self->fb);
+    }
+    #endif
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(st7789_ST7789_framebuffer_obj, st7789_ST7789_framebuffer);
+
 static const mp_rom_map_elem_t st7789_ST7789_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&st7789_ST7789_write_obj)},
     {MP_ROM_QSTR(MP_QSTR_write_len), MP_ROM_PTR(&st7789_ST7789_write_len_obj)},
@@ -2393,6 +2847,10 @@ static const mp_rom_map_elem_t st7789_ST7789_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_polygon), MP_ROM_PTR(&st7789_ST7789_polygon_obj)},
     {MP_ROM_QSTR(MP_QSTR_fill_polygon), MP_ROM_PTR(&st7789_ST7789_fill_polygon_obj)},
     {MP_ROM_QSTR(MP_QSTR_bounding), MP_ROM_PTR(&st7789_ST7789_bounding_obj)},
+    {MP_ROM_QSTR(MP_QSTR_flush), MP_ROM_PTR(&st7789_ST7789_flush_obj)},
+    {MP_ROM_QSTR(MP_QSTR_framebuffer), MP_ROM_PTR(&st7789_ST7789_framebuffer_obj)},
+    {MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&st7789_ST7789_deinit_obj)},
+    {MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&st7789_ST7789_deinit_obj)},
 };
 static MP_DEFINE_CONST_DICT(st7789_ST7789_locals_dict, st7789_ST7789_locals_dict_table);
 /* methods end */
@@ -2437,7 +2895,10 @@ mp_obj_t st7789_ST7789_make_new(const mp_obj_type_t *type,
         ARG_color_order,
         ARG_inversion,
         ARG_options,
-        ARG_buffer_size
+        ARG_buffer_size,
+        ARG_dma_host,
+        ARG_dma_baudrate,
+        ARG_framebuffer
     };
     static const mp_arg_t allowed_args[] = {
         {MP_QSTR_spi, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL}},
@@ -2454,12 +2915,17 @@ mp_obj_t st7789_ST7789_make_new(const mp_obj_type_t *type,
         {MP_QSTR_inversion, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = true}},
         {MP_QSTR_options, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
         {MP_QSTR_buffer_size, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+        {MP_QSTR_dma_host, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1}},
+        {MP_QSTR_dma_baudrate, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 40000000}},
+        {MP_QSTR_framebuffer, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false}},
     };
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
     // create new object
-    st7789_ST7789_obj_t *self = m_new_obj(st7789_ST7789_obj_t);
+    // With a finaliser, so a dropped display (main.py makes a new one on
+    // every soft reset) gives its SPI device slot back -- see deinit().
+    st7789_ST7789_obj_t *self = m_new_obj_with_finaliser(st7789_ST7789_obj_t);
     self->base.type = &st7789_ST7789_type;
 
     // set parameters
@@ -2533,12 +2999,88 @@ mp_obj_t st7789_ST7789_make_new(const mp_obj_type_t *type,
         self->backlight = GPIO_NUM_NC;
     }
 
+    self->win_valid = false;
+    self->win_open = false;
+    self->win_left = 0;
+
     self->bounding = 0;
     self->min_x = self->display_width;
     self->min_y = self->display_height;
     self->max_x = 0;
     self->max_y = 0;
 
+    #ifdef ESP_PLATFORM
+    // dma_host is the ESP-IDF spi_host_device_t machine.SPI already
+    // initialized (machine.SPI(1) is SPI2_HOST == 1 on the ESP32-S3).
+    // Attaches a second device to that bus so commands and pixels can be
+    // queued for DMA instead of blocking in machine.SPI's transfer(). CS
+    // stays a plain GPIO -- same as RadioLib's EspHal does for the LoRa
+    // radio -- driven per transaction by dma_pre_cb()/dma_post_cb(), so
+    // the blocking paths can keep toggling it by hand. Optional: no
+    // dma_host, or a failed attach, just leaves every write on the
+    // blocking path.
+    self->dma_dev = NULL;
+    self->dma_ring = NULL;
+    self->dma_queued = 0;
+    self->dma_done = 0;
+    self->dma_burst_end = 0;
+    self->dma_fill = NULL;
+    self->dma_fill_valid = false;
+    if (args[ARG_dma_host].u_int >= 0) {
+        spi_device_interface_config_t dev_config = {
+            .mode = 0,
+            .clock_speed_hz = args[ARG_dma_baudrate].u_int,
+            .spics_io_num = -1,
+            .queue_size = ST7789_QUEUE_DEPTH,
+            .pre_cb = dma_pre_cb,
+            .post_cb = dma_post_cb,
+        };
+        // The descriptors are read from the SPI ISR too, so they go in
+        // internal RAM rather than in the object.
+        self->dma_ring = heap_caps_calloc(ST7789_QUEUE_DEPTH, sizeof(spi_transaction_t),
+            MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!self->dma_ring ||
+            spi_bus_add_device(args[ARG_dma_host].u_int, &dev_config, &self->dma_dev) != ESP_OK) {
+            heap_caps_free(self->dma_ring);
+            self->dma_ring = NULL;
+            self->dma_dev = NULL;
+        } else {
+            // Without it fills just take the blocking path.
+            self->dma_fill = heap_caps_malloc(ST7789_FILL_PIXELS * sizeof(uint16_t), MALLOC_CAP_DMA);
+        }
+    }
+
+    // framebuffer=True keeps a full-screen copy in PSRAM (150 KB at
+    // 320x240) and composes into that; see fb_put()/fb_push(). Like
+    // dma_host it's best-effort: if any of it can't be allocated, drawing
+    // just goes straight to the panel.
+    self->fb = NULL;
+    self->fb_flushing = false;
+    if (args[ARG_framebuffer].u_bool) {
+        size_t pixels = (size_t)self->display_width * self->display_height;
+        uint16_t rows = MAX(self->display_width, self->display_height);
+        self->fb = heap_caps_calloc(pixels, 2, MALLOC_CAP_SPIRAM);
+        self->fb_dirty = heap_caps_malloc(rows * 2 * sizeof(uint16_t), MALLOC_CAP_8BIT);
+        self->fb_stage[0] = heap_caps_malloc(ST7789_FB_STAGE, MALLOC_CAP_DMA);
+        self->fb_stage[1] = heap_caps_malloc(ST7789_FB_STAGE, MALLOC_CAP_DMA);
+        if (!self->fb || !self->fb_dirty || !self->fb_stage[0] || !self->fb_stage[1]) {
+            heap_caps_free(self->fb);
+            heap_caps_free(self->fb_dirty);
+            heap_caps_free(self->fb_stage[0]);
+            heap_caps_free(self->fb_stage[1]);
+            self->fb = NULL;
+        } else {
+            // The panel starts out as whatever it powered up with: the
+            // first flush sends all of it.
+            self->fb_x0 = self->fb_y0 = 0;
+            self->fb_x1 = self->width - 1;
+            self->fb_y1 = self->height - 1;
+            self->fb_pos = 0;
+            fb_dirty_all(self);
+        }
+    }
+    #endif
+
     return MP_OBJ_FROM_PTR(self);
 }
 
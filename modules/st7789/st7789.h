@@ -15,6 +15,27 @@ extern "C" {
 #include "py/runtime.h"
 #include "py/mphal.h"
 
+#ifdef ESP_PLATFORM
+#include "driver/spi_master.h"
+
+// Transactions the DMA device can have queued at once (a power of two).
+// A set_window() is five of them, so this covers a window, its pixels
+// and the next window without anyone having to wait.
+#define ST7789_QUEUE_DEPTH 16
+
+// Largest single transaction: 4092 bytes is all an ESP-IDF SPI bus takes
+// unless it was initialized with a bigger max_transfer_sz, which
+// machine.SPI doesn't promise. Longer writes are queued as several.
+#define ST7789_DMA_CHUNK 4092
+
+// Pixels in the DMA-capable buffer fills are sent from.
+#define ST7789_FILL_PIXELS 256
+
+// Bytes in each of the two bounce buffers flush() copies framebuffer rows
+// through on their way out of PSRAM.
+#define ST7789_FB_STAGE ST7789_DMA_CHUNK
+#endif
+
 
 // color modes
 #define COLOR_MODE_65K      0x50
@@ -50,6 +71,8 @@ extern "C" {
 #define ST7789_MADCTL  0x36
 #define ST7789_VSCSAD  0x37
 
+#define ST7789_GRAM_LINES 320   // gate lines in controller RAM, whatever the panel
+
 #define ST7789_MADCTL_MY  0x80  // Page Address Order
 #define ST7789_MADCTL_MX  0x40  // Column Address Order
 #define ST7789_MADCTL_MV  0x20  // Page/Column Order
@@ -136,6 +159,47 @@ typedef struct _st7789_ST7789_obj_t {
     uint16_t max_x;
     uint16_t max_y;
 
+    // Last window set_window() programmed, in controller coordinates, so
+    // it can leave out what the panel already has. win_valid: CASET
+    // (win_x0..win_x1) and RASET (from win_y0) are known. win_open: the
+    // RAMWR it started is still running -- no command since -- with
+    // win_left bytes of the window still to come; once those are in, the
+    // panel's write pointer sits at the start of row win_next_y.
+    bool win_valid;
+    bool win_open;
+    uint16_t win_x0;
+    uint16_t win_x1;
+    uint16_t win_y0;
+    uint16_t win_next_y;
+    uint32_t win_left;
+
+#ifdef ESP_PLATFORM
+    // Optional native ESP-IDF device on the same bus as spi_obj (see the
+    // dma_host constructor argument). When present every command and data
+    // write is queued on it instead of going through spi_obj's blocking
+    // transfer. NULL = the old blocking path for everything.
+    spi_device_handle_t dma_dev;
+    spi_transaction_t *dma_ring;    // ST7789_QUEUE_DEPTH, internal RAM
+    uint32_t dma_queued;            // transactions queued so far
+    uint32_t dma_done;              // ... and collected back; the ring
+                                    // slots in between are in flight
+    uint32_t dma_burst_end;         // dma_queued after the last pixel burst
+    uint16_t *dma_fill;             // ST7789_FILL_PIXELS of dma_fill_color
+    uint16_t dma_fill_color;
+    bool dma_fill_valid;
+
+    // Optional shadow framebuffer (the framebuffer constructor argument):
+    // every window/data write lands in fb instead of on the panel, and
+    // st7789_flush() sends what changed. NULL = draw straight to the panel.
+    uint8_t *fb;                    // width * height, as sent (RGB565 BE)
+    uint16_t *fb_dirty;             // per row: first, last dirty column;
+                                    // first > last = clean
+    uint8_t *fb_stage[2];           // ST7789_FB_STAGE each, DMA-capable
+    bool fb_flushing;               // flush() sending: writes go out
+    uint16_t fb_x0, fb_x1, fb_y0, fb_y1;    // window being written
+    uint32_t fb_pos;                // bytes into it so far
+#endif
+
 } st7789_ST7789_obj_t;
 
 mp_obj_t st7789_ST7789_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args);
@@ -154,6 +218,44 @@ extern void set_window(st7789_ST7789_obj_t *self, uint16_t x0, uint16_t y0, uint
 
 extern void write_spi(mp_obj_base_t *spi_obj, const uint8_t *buf, int len);
 
+// Data bytes for the command last sent (usually set_window()'s RAMWR):
+// queued when there is a DMA device, blocking otherwise. Either way buf
+// is free to reuse once this returns.
+extern void st7789_write_data(st7789_ST7789_obj_t *self, const uint8_t *buf, int len);
+
+// Non-blocking pixel burst: queues buf for DMA behind whatever is already
+// queued (typically the set_window() for it) and returns straight away.
+// At most one such burst is in flight: each call first waits for the
+// previous one, so buf must stay untouched (and should be DMA-capable)
+// only until the next st7789_dma_write() or st7789_dma_wait() returns --
+// two buffers are enough to ping-pong. Returns false if no DMA device is
+// configured, in which case nothing was sent and the caller should fall
+// back to st7789_write_data().
+extern bool st7789_dma_available(st7789_ST7789_obj_t *self);
+extern bool st7789_dma_write(st7789_ST7789_obj_t *self, const uint8_t *buf, int len);
+
+// Sends everything drawn into the shadow framebuffer since the last
+// flush (as few windows as the dirty rows allow), then st7789_dma_wait().
+// Without a framebuffer it's just the wait.
+extern void st7789_flush(st7789_ST7789_obj_t *self);
+
+// Fence: blocks until everything queued on the DMA device is on the
+// panel. Queued transactions drive CS and DC themselves (from the SPI
+// driver's pre/post callbacks), so other devices on the bus may run in
+// between them -- but anything that toggles DC/CS by hand, i.e. every
+// blocking write_spi() path, has to call this first.
+extern void st7789_dma_wait(st7789_ST7789_obj_t *self);
+
+// Hardware vertical scroll (VSCRDEF/VSCSAD), for callers that want to
+// move rows already on the panel instead of resending them. Both take
+// raw GRAM line numbers. st7789_vscroll_lines() returns the total the
+// three VSCRDEF areas must add up to, or 0 if the current rotation
+// doesn't scroll along the logical y axis at all (e.g. landscape), in
+// which case neither should be used.
+extern uint16_t st7789_vscroll_lines(st7789_ST7789_obj_t *self);
+extern void st7789_vscroll_define(st7789_ST7789_obj_t *self, uint16_t tfa, uint16_t vsa, uint16_t bfa);
+extern void st7789_vscroll_start(st7789_ST7789_obj_t *self, uint16_t vssa);
+
 
 #ifdef  __cplusplus
 }
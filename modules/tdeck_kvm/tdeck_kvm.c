@@ -16,17 +16,28 @@
 extern const mp_obj_type_t vt_VT_type;
 extern const mp_obj_type_t tdeck_kbd_type;
 
+// Defined in modules/vt/vt_module.c -- brings virtual console n forward.
+extern int vt_console_switch(int n);
+// Also vt_module.c: moves terminal replies parsed on its drain task into
+// the inject ring below, which only mp_task may write.
+extern void vt_reply_pump(void);
+
 // Ring buffer for injected "Ghost Keys"
 #define INJECT_BUF_SIZE 32
 static char inject_buf[INJECT_BUF_SIZE];
 static uint8_t inject_head = 0;
 static uint8_t inject_tail = 0;
 
+// Whether a KVM has a mirror attached, see internal_mirror_attached()
+static bool mirror_attached = false;
+
 typedef struct _tdeck_kvm_obj_t {
   mp_obj_base_t base;
   mp_obj_t vt_instance;
   mp_obj_t kbd_instance;
   mp_obj_t mirror_instance;
+  int console_key;   // set_console_key(), -1 = none
+  bool console_next; // console_key was the last key read
 } tdeck_kvm_obj_t;
 
 // --- Injection Logic ---
@@ -53,6 +64,10 @@ static mp_obj_t kvm_inject(mp_obj_t self_in, mp_obj_t arg) {
 }
 static MP_DEFINE_CONST_FUN_OBJ_2(kvm_inject_obj, kvm_inject);
 
+// vt_module.c's direct grid path (vttui) skips kvm_write() altogether, so
+// it asks here first: a mirror needs the ANSI byte stream.
+bool internal_mirror_attached(void) { return mirror_attached; }
+
 // Python Method: kvm.set_mirror(stream_or_None)
 //
 // Optional secondary output target -- every byte written via kvm_write()
@@ -65,10 +80,57 @@ static MP_DEFINE_CONST_FUN_OBJ_2(kvm_inject_obj, kvm_inject);
 static mp_obj_t kvm_set_mirror(mp_obj_t self_in, mp_obj_t arg) {
   tdeck_kvm_obj_t *self = MP_OBJ_TO_PTR(self_in);
   self->mirror_instance = arg;
+  mirror_attached = (arg != mp_const_none);
   return mp_const_none;
 }
 static MP_DEFINE_CONST_FUN_OBJ_2(kvm_set_mirror_obj, kvm_set_mirror);
 
+// Python Method: kvm.set_console_key(key_or_None)
+//
+// Console switching chord: console_key followed by 1..9 brings that
+// virtual console forward (vt.VT(consoles=)), like Alt+Fn on a Linux VT.
+// Both keys are swallowed. console_key followed by anything else types
+// both keys, so the key itself stays usable -- only the few combinations
+// that name a console are taken. Only keys from the keyboard count:
+// injected bytes (ghost keys, VNC input, terminal replies) pass through.
+static mp_obj_t kvm_set_console_key(mp_obj_t self_in, mp_obj_t arg) {
+  tdeck_kvm_obj_t *self = MP_OBJ_TO_PTR(self_in);
+  if (arg == mp_const_none) {
+    self->console_key = -1;
+  } else {
+    size_t len;
+    const char *key = mp_obj_str_get_data(arg, &len);
+    if (len != 1)
+      mp_raise_ValueError(MP_ERROR_TEXT("console key must be one byte"));
+    self->console_key = (uint8_t)key[0];
+  }
+  self->console_next = false;
+  return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(kvm_set_console_key_obj, kvm_set_console_key);
+
+// Filters one key just read from the keyboard through the console chord.
+// Returns false if it was swallowed.
+static bool kvm_console_chord(tdeck_kvm_obj_t *self, char *key) {
+  uint8_t c = (uint8_t)*key;
+
+  if (self->console_next) {
+    self->console_next = false;
+    if (c >= '1' && c <= '9' && vt_console_switch(c - '1') >= 0)
+      return false;
+    // Not a console: deliver the held-back console key now and this one
+    // right after it, through the ghost key ring kvm_read() serves first.
+    *key = (char)self->console_key;
+    internal_inject_n((const char *)&c, 1);
+    return true;
+  }
+  if (c == self->console_key) {
+    self->console_next = true;
+    return false;
+  }
+  return true;
+}
+
 // --- Stream Protocol ---
 
 static mp_uint_t kvm_read(mp_obj_t self_in, void *buf, mp_uint_t size,
@@ -77,6 +139,7 @@ static mp_uint_t kvm_read(mp_obj_t self_in, void *buf, mp_uint_t size,
   char *dest = (char *)buf;
   mp_uint_t bytes_read = 0;
 
+  vt_reply_pump();
   while (bytes_read < size && inject_tail != inject_head) {
     dest[bytes_read++] = inject_buf[inject_tail];
     inject_tail = (inject_tail + 1) % INJECT_BUF_SIZE;
@@ -89,7 +152,15 @@ static mp_uint_t kvm_read(mp_obj_t self_in, void *buf, mp_uint_t size,
       mp_obj_get_type(self->kbd_instance), protocol);
 
   if (stream && stream->read) {
-    return stream->read(self->kbd_instance, buf, size, errcode);
+    mp_uint_t n = stream->read(self->kbd_instance, buf, size, errcode);
+    if (n == MP_STREAM_ERROR || n == 0 || self->console_key < 0)
+      return n;
+    // The keyboard hands over one key per read.
+    if (!kvm_console_chord(self, dest)) {
+      *errcode = MP_EAGAIN;
+      return MP_STREAM_ERROR;
+    }
+    return n;
   }
 
   *errcode = MP_EOPNOTSUPP;
@@ -135,6 +206,7 @@ static mp_uint_t kvm_ioctl(mp_obj_t self_in, mp_uint_t request, uintptr_t arg,
     // before ever touching the keyboard -- poll must report readable for
     // that case too, or select()-based callers can be told "not ready"
     // while a read() would actually return data immediately.
+    vt_reply_pump();
     if ((flags & MP_STREAM_POLL_RD) && inject_tail != inject_head) {
       ret |= MP_STREAM_POLL_RD;
     }
@@ -171,6 +243,8 @@ static mp_obj_t tdeck_kvm_make_new(const mp_obj_type_t *type, size_t n_args,
   self->vt_instance = args[0];
   self->kbd_instance = args[1];
   self->mirror_instance = mp_const_none;
+  self->console_key = -1;
+  self->console_next = false;
 
   return MP_OBJ_FROM_PTR(self);
 }
@@ -179,6 +253,8 @@ static mp_obj_t tdeck_kvm_make_new(const mp_obj_type_t *type, size_t n_args,
 static const mp_rom_map_elem_t kvm_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_inject), MP_ROM_PTR(&kvm_inject_obj)},
     {MP_ROM_QSTR(MP_QSTR_set_mirror), MP_ROM_PTR(&kvm_set_mirror_obj)},
+    {MP_ROM_QSTR(MP_QSTR_set_console_key),
+     MP_ROM_PTR(&kvm_set_console_key_obj)},
     {MP_ROM_QSTR(MP_QSTR_read), MP_ROM_PTR(&mp_stream_read_obj)},
     {MP_ROM_QSTR(MP_QSTR_readinto), MP_ROM_PTR(&mp_stream_readinto_obj)},
     {MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&mp_stream_write_obj)},
@@ -344,13 +344,12 @@ void *vi_xrealloc(void *ptr, size_t old_size, size_t new_size) {
   return ret;
 }
 
-int vi_wcwidth(uint32_t u) {
-  if (u == 0)
-    return 0;
-  if (u < 32 || (u >= 0x7f && u < 0xa0))
-    return -1; // Control characters
-  return 1;    // Everything else is 1 cell wide
-}
+// The terminal's own table (vt/st.c), so the cursor vi computes lands
+// where st actually put the glyph -- CJK and the other wide ranges take
+// two cells there.
+extern int st_wcwidth(uint32_t u);
+
+int vi_wcwidth(uint32_t u) { return st_wcwidth(u); }
 
 int utf8towc(unsigned *wc, char *str, unsigned len) {
   unsigned result, mask, first;
@@ -6,10 +6,13 @@
  * License: MIT
  */
 
+#include "esp_heap_caps.h"
 #include "fb.h"
 #include "st.h"
 #include "win.h"
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 int pselect(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
             const struct timespec *timeout, const sigset_t *sigmask) {
@@ -22,7 +25,7 @@ int pselect(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
 // mp_obj_dict_get() raises a real Python KeyError for a missing key
 // (matching Python's d[key] semantics) rather than returning MP_OBJ_NULL --
 // fine for keys a font is required to define (WIDTH/HEIGHT/REGULAR/etc,
-// see xdrawline()'s "Setup Metrics"), but wrong for genuinely optional
+// see vt_font_compile()), but wrong for genuinely optional
 // per-font blocks like UNICODE_FONT/WIDE_FONT, which most fonts don't
 // define at all. Look up through the map directly for those instead --
 // same underlying lookup mp_obj_dict_get() uses, just without the raise.
@@ -32,11 +35,591 @@ static mp_obj_t dict_get_optional(mp_obj_dict_t *dict, qstr key) {
   return elem ? elem->value : MP_OBJ_NULL;
 }
 
+static bool dict_get_int_optional(mp_obj_dict_t *dict, const char *key,
+                                  mp_int_t *out) {
+  mp_obj_t obj = dict_get_optional(dict, qstr_from_str(key));
+  if (obj == MP_OBJ_NULL || obj == mp_const_none)
+    return false;
+  *out = mp_obj_get_int(obj);
+  return true;
+}
+
+static const uint8_t *dict_get_bitmap_optional(mp_obj_dict_t *dict,
+                                               const char *key, size_t *len) {
+  *len = 0;
+  mp_obj_t obj = dict_get_optional(dict, qstr_from_str(key));
+  if (obj == MP_OBJ_NULL || obj == mp_const_none)
+    return NULL;
+  mp_buffer_info_t buf;
+  mp_get_buffer_raise(obj, &buf, MP_BUFFER_READ);
+  *len = buf.len;
+  return (const uint8_t *)buf.buf;
+}
+
+static int glyph_index_cmp(const void *a, const void *b) {
+  uint32_t ca = ((const vt_glyph_index_t *)a)->codepoint;
+  uint32_t cb = ((const vt_glyph_index_t *)b)->codepoint;
+  return (ca > cb) - (ca < cb);
+}
+
+// Builds a sorted codepoint -> slot index from an explicit codepoint
+// sequence (UNICODE_CHARS/WIDE_CHARS). No 32-entry cap like the old
+// per-row stack copies had, since this only runs once per font change.
+static void glyph_table_load_chars(vt_glyph_table_t *t, mp_obj_t chars_obj) {
+  size_t n = (size_t)mp_obj_get_int(mp_obj_len(chars_obj));
+  if (n == 0)
+    return;
+  vt_glyph_index_t *index = m_new(vt_glyph_index_t, n);
+  for (size_t j = 0; j < n; j++) {
+    index[j].codepoint = (uint32_t)mp_obj_get_int(
+        mp_obj_subscr(chars_obj, MP_OBJ_NEW_SMALL_INT(j), MP_OBJ_SENTINEL));
+    index[j].slot = (uint16_t)j;
+    index[j].pad = 0;
+  }
+  qsort(index, n, sizeof(vt_glyph_index_t), glyph_index_cmp);
+  t->index = index;
+  t->index_len = n;
+  t->index_owned = true;
+}
+
+// Slot of `cp` within `t`, or -1 if the table doesn't cover it. Range
+// first, then the paged or sorted index -- the same precedence the old
+// per-row WIDE_FONT lookup used.
+static int glyph_table_slot(const vt_glyph_table_t *t, uint32_t cp) {
+  if (!t->bitmap)
+    return -1;
+  if (t->range_count > 0 && cp >= t->range_first &&
+      cp < t->range_first + t->range_count)
+    return (int)(cp - t->range_first);
+  if (t->pages) {
+    if (cp > 0xffff)
+      return -1;
+    uint16_t page = t->pages[cp >> 8];
+    if (page == VTF_NONE)
+      return -1;
+    uint16_t slot =
+        t->pages[VTF_PAGE_SIZE + page * VTF_PAGE_SIZE + (cp & 0xff)];
+    return slot == VTF_NONE ? -1 : slot;
+  }
+  size_t lo = 0, hi = t->index_len;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    uint32_t c = t->index[mid].codepoint;
+    if (c == cp)
+      return t->index[mid].slot;
+    if (c < cp)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return -1;
+}
+
+// Bitmap of `cp` within `t`, or NULL if the table doesn't cover it or
+// its slot lies past the end of the bitmap. vt_vtf_check() already
+// rejects that where the header gives the glyph size, but a WIDE block
+// without WIDE_WIDTH/WIDE_HEIGHT only learns its size from the font it's
+// drawn with, and a font module's lists aren't checked at all.
+static const uint8_t *glyph_table_glyph(const vt_glyph_table_t *t,
+                                        uint32_t cp, size_t glyph_bytes) {
+  int slot = glyph_table_slot(t, cp);
+  if (slot < 0 || glyph_bytes == 0 ||
+      (size_t)slot >= t->bitmap_len / glyph_bytes)
+    return NULL;
+  return t->bitmap + slot * glyph_bytes;
+}
+
+static void glyph_table_release(vt_glyph_table_t *t) {
+  if (!t->index_owned)
+    return;
+  if (t->pages)
+    m_del(uint16_t, (uint16_t *)t->pages, t->index_len);
+  else
+    m_del(vt_glyph_index_t, (vt_glyph_index_t *)t->index, t->index_len);
+}
+
+void vt_font_release(vt_font_t *font) {
+  glyph_table_release(&font->unicode);
+  glyph_table_release(&font->wide);
+  memset(font, 0, sizeof(*font));
+}
+
+// The index is read in place as vt_glyph_index_t, so the struct has to be
+// exactly the 8 bytes fontconvert.py packs per entry.
+_Static_assert(sizeof(vt_glyph_index_t) == 8, "VTF index entry layout");
+_Static_assert(sizeof(vt_vtf_header_t) == 48, "VTF header layout");
+_Static_assert(sizeof(vt_vtf_block_t) == 28, "VTF block layout");
+
+static bool vtf_span_ok(uint32_t off, uint32_t len, uint32_t size) {
+  return off <= size && len <= size - off;
+}
+
+// Bytes per glyph in a block of kind `id`, from the header alone. 0 when
+// the header can't say -- an icon-only container's zero cell, a WIDE
+// block sized by whatever font it's paired with, or a kind from a newer
+// fontconvert.py that nothing here draws.
+static uint32_t vtf_glyph_bytes(const vt_vtf_header_t *hdr, uint32_t id) {
+  switch (VTF_KIND(id)) {
+  case VTF_REGULAR:
+  case VTF_BOLD:
+  case VTF_UNICODE:
+  case VTF_ICONS:
+    return hdr->height * ((hdr->width + 7) / 8);
+  case VTF_WIDE:
+    return hdr->wide_height * ((hdr->wide_width + 7) / 8);
+  default:
+    return 0;
+  }
+}
+
+size_t vt_vtf_check(const uint8_t *p, size_t len) {
+  vt_vtf_header_t hdr;
+
+  if (len < sizeof(hdr))
+    return 0;
+  memcpy(&hdr, p, sizeof(hdr));
+  if (memcmp(hdr.magic, VTF_MAGIC, 4) != 0 || hdr.size < sizeof(hdr) ||
+      hdr.size > len)
+    return 0;
+  if ((size_t)hdr.nblocks * sizeof(vt_vtf_block_t) >
+      hdr.size - sizeof(hdr))
+    return 0;
+
+  for (uint16_t i = 0; i < hdr.nblocks; i++) {
+    vt_vtf_block_t b;
+    memcpy(&b, p + sizeof(hdr) + i * sizeof(b), sizeof(b));
+    if (!vtf_span_ok(b.bitmap_off, b.bitmap_len, hdr.size) ||
+        b.index_count > hdr.size / sizeof(vt_glyph_index_t))
+      return 0;
+    // Every glyph a block names has to be inside its bitmap:
+    // REGULAR/BOLD are indexed straight off FIRST..LAST, the others by
+    // range offset or index slot.
+    uint32_t glyph_bytes = vtf_glyph_bytes(&hdr, b.id);
+    uint32_t nglyphs = glyph_bytes ? b.bitmap_len / glyph_bytes : 0;
+    if (glyph_bytes && b.bitmap_len) {
+      if (VTF_KIND(b.id) == VTF_REGULAR || VTF_KIND(b.id) == VTF_BOLD) {
+        if (hdr.last < hdr.first || hdr.last - hdr.first >= nglyphs)
+          return 0;
+      } else if (b.range_count > nglyphs) {
+        return 0;
+      }
+    }
+    if (!(b.id & VTF_PAGED)) {
+      if (!vtf_span_ok(b.index_off,
+                       b.index_count * sizeof(vt_glyph_index_t), hdr.size))
+        return 0;
+      for (uint32_t j = 0; glyph_bytes && j < b.index_count; j++) {
+        const uint8_t *e =
+            p + b.index_off + j * sizeof(vt_glyph_index_t) + 4;
+        if ((uint32_t)(e[0] | (e[1] << 8)) >= nglyphs)
+          return 0;
+      }
+      continue;
+    }
+    // Paged: the directory has to stay inside the pages that follow it,
+    // so glyph_table_slot() can index without checking.
+    if (b.index_count >= VTF_NONE ||
+        !vtf_span_ok(b.index_off,
+                     (1 + b.index_count) * VTF_PAGE_SIZE * sizeof(uint16_t),
+                     hdr.size))
+      return 0;
+    for (int page = 0; page < VTF_PAGE_SIZE; page++) {
+      const uint8_t *e = p + b.index_off + page * sizeof(uint16_t);
+      uint16_t n = e[0] | (e[1] << 8);
+      if (n != VTF_NONE && n >= b.index_count)
+        return 0;
+    }
+    const uint8_t *slots = p + b.index_off + VTF_PAGE_SIZE * sizeof(uint16_t);
+    for (uint32_t j = 0; glyph_bytes && j < b.index_count * VTF_PAGE_SIZE;
+         j++) {
+      uint16_t slot = slots[2 * j] | (slots[2 * j + 1] << 8);
+      if (slot != VTF_NONE && slot >= nglyphs)
+        return 0;
+    }
+  }
+  return hdr.size;
+}
+
+// Points `t` at a VTF block's index where it lies. Flash mappings and
+// GC blocks are always aligned enough; a bytes object frozen into the
+// firmware need not be, and the index is read with 32-bit loads, so that
+// one case gets a heap copy instead.
+static void glyph_table_load_vtf(vt_glyph_table_t *t, const uint8_t *base,
+                                 const vt_vtf_block_t *b) {
+  const uint8_t *src = base + b->index_off;
+
+  if (b->id & VTF_PAGED) {
+    size_t n = (1 + b->index_count) * VTF_PAGE_SIZE;
+    if (((uintptr_t)src & 1) == 0) {
+      t->pages = (const uint16_t *)src;
+    } else {
+      uint16_t *pages = m_new(uint16_t, n);
+      memcpy(pages, src, n * sizeof(uint16_t));
+      t->pages = pages;
+      t->index_owned = true;
+    }
+    t->index_len = n;
+    return;
+  }
+  if (b->index_count == 0)
+    return;
+  if (((uintptr_t)src & 3) == 0) {
+    t->index = (const vt_glyph_index_t *)src;
+  } else {
+    vt_glyph_index_t *index = m_new(vt_glyph_index_t, b->index_count);
+    memcpy(index, src, b->index_count * sizeof(vt_glyph_index_t));
+    t->index = index;
+    t->index_owned = true;
+  }
+  t->index_len = b->index_count;
+}
+
+// vt_font_compile() for a vt.Font: a header and block table read, no
+// glyph data touched. vt.Font() already ran vt_vtf_check() on it, and
+// there are no missing keys to raise about -- an icon-only container
+// used as the main font just has a zero cell, which draws nothing.
+static void vt_font_compile_vtf(vt_font_t *out, const vt_font_obj_t *font) {
+  const vt_vtf_header_t *hdr = &font->hdr;
+
+  out->width = hdr->width;
+  out->height = hdr->height;
+  out->row_bytes = (out->width + 7) / 8;
+  out->first = hdr->first;
+  out->last = hdr->last;
+  out->wide.width = hdr->wide_width;
+  out->wide.height = hdr->wide_height;
+
+  for (uint16_t i = 0; i < hdr->nblocks; i++) {
+    vt_vtf_block_t b;
+    vt_glyph_table_t *t = NULL;
+    memcpy(&b, font->data + sizeof(*hdr) + i * sizeof(b), sizeof(b));
+    const uint8_t *bitmap = b.bitmap_len ? font->data + b.bitmap_off : NULL;
+
+    switch (VTF_KIND(b.id)) {
+    case VTF_REGULAR:
+      out->regular = bitmap;
+      break;
+    case VTF_BOLD:
+      out->bold = bitmap;
+      break;
+    case VTF_UNICODE:
+      t = &out->unicode;
+      break;
+    case VTF_ICONS:
+      t = &out->icons;
+      break;
+    case VTF_WIDE:
+      t = &out->wide;
+      break;
+    default: // from a newer fontconvert.py -- not ours to draw
+      break;
+    }
+    if (!t || !bitmap)
+      continue;
+    t->bitmap = bitmap;
+    t->bitmap_len = b.bitmap_len;
+    t->range_first = b.range_first;
+    t->range_count = b.range_count;
+    glyph_table_load_vtf(t, font->data, &b);
+  }
+}
+
+// Shrinks a font module's FIRST..LAST to the glyphs REGULAR (and BOLD,
+// when there is one) actually hold: render_row_rgb565() indexes them by
+// codepoint without looking at their length.
+static void font_clamp_range(vt_font_t *out, size_t regular_len,
+                             size_t bold_len) {
+  size_t glyph_bytes = (size_t)out->height * out->row_bytes;
+  if (!out->regular || glyph_bytes == 0 || out->last < out->first)
+    return;
+  size_t n = regular_len / glyph_bytes;
+  if (out->bold && bold_len / glyph_bytes < n)
+    n = bold_len / glyph_bytes;
+  if (n == 0) {
+    out->regular = out->bold = NULL;
+    return;
+  }
+  if (out->last - out->first >= n)
+    out->last = out->first + (uint32_t)(n - 1);
+}
+
+// The only place a font module's globals are read. Everything
+// render_row_rgb565() used to look up per row -- metrics, REGULAR/BOLD,
+// and the optional UNICODE_FONT/ICONS/WIDE_FONT blocks -- is resolved
+// here once, when the font is selected, into plain pointers and integers.
+// Required keys still go through mp_obj_dict_get() so a broken main font
+// raises KeyError from update_layout() instead of from the draw timer.
+void vt_font_compile(vt_font_t *out, mp_obj_t font, bool required) {
+  vt_font_release(out);
+  if (font == MP_OBJ_NULL)
+    return;
+  if (mp_obj_is_type(font, &vt_Font_type)) {
+    vt_font_compile_vtf(out, MP_OBJ_TO_PTR(font));
+    return;
+  }
+
+  mp_obj_module_t *mod = MP_OBJ_TO_PTR(font);
+  mp_obj_dict_t *dict = MP_OBJ_TO_PTR(mod->globals);
+  mp_int_t v;
+
+  if (required) {
+    out->width =
+        mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_WIDTH)));
+    out->height = mp_obj_get_int(
+        mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_HEIGHT)));
+    out->first =
+        mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_FIRST)));
+    out->last =
+        mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_LAST)));
+  } else {
+    if (dict_get_int_optional(dict, "WIDTH", &v))
+      out->width = (uint8_t)v;
+    if (dict_get_int_optional(dict, "HEIGHT", &v))
+      out->height = (uint8_t)v;
+    if (dict_get_int_optional(dict, "FIRST", &v))
+      out->first = (uint32_t)v;
+    if (dict_get_int_optional(dict, "LAST", &v))
+      out->last = (uint32_t)v;
+  }
+  out->row_bytes = (out->width + 7) / 8;
+
+  // REGULAR/BOLD are optional even for the main font: fontconvert.py's
+  // --icons mode produces an icons-only module with neither, and missing
+  // REGULAR just means ASCII renders blank rather than crashing.
+  size_t regular_len, bold_len;
+  out->regular = dict_get_bitmap_optional(dict, "REGULAR", &regular_len);
+  out->bold = dict_get_bitmap_optional(dict, "BOLD", &bold_len);
+  font_clamp_range(out, regular_len, bold_len);
+
+  // Box drawing and other single-width extras: explicit codepoint list.
+  out->unicode.bitmap = dict_get_bitmap_optional(dict, "UNICODE_FONT",
+                                                 &out->unicode.bitmap_len);
+  if (out->unicode.bitmap) {
+    mp_obj_t chars_obj = dict_get_optional(dict, qstr_from_str("UNICODE_CHARS"));
+    if (chars_obj != MP_OBJ_NULL && chars_obj != mp_const_none)
+      glyph_table_load_chars(&out->unicode, chars_obj);
+  }
+
+  // fontconvert.py --icons: one contiguous range, no per-glyph table.
+  out->icons.bitmap = dict_get_bitmap_optional(dict, "ICONS",
+                                               &out->icons.bitmap_len);
+  if (out->icons.bitmap) {
+    if (dict_get_int_optional(dict, "ICON_FIRST", &v))
+      out->icons.range_first = (uint32_t)v;
+    if (dict_get_int_optional(dict, "ICON_COUNT", &v))
+      out->icons.range_count = (uint32_t)v;
+  }
+
+  // Double-width glyphs: contiguous range (WIDE_FIRST + WIDE_COUNT, e.g.
+  // Siji's ~400 icons) and/or an explicit list (WIDE_CHARS, e.g.
+  // Unifont's dozen Chess Symbols). Own bitmap geometry, independent of
+  // the 2*width x height cell they're centered into -- see
+  // render_row_rgb565().
+  out->wide.bitmap = dict_get_bitmap_optional(dict, "WIDE_FONT",
+                                              &out->wide.bitmap_len);
+  if (out->wide.bitmap) {
+    mp_int_t wfirst, wcount;
+    if (dict_get_int_optional(dict, "WIDE_FIRST", &wfirst) &&
+        dict_get_int_optional(dict, "WIDE_COUNT", &wcount)) {
+      out->wide.range_first = (uint32_t)wfirst;
+      out->wide.range_count = (uint32_t)wcount;
+    }
+    mp_obj_t wchars_obj = dict_get_optional(dict, qstr_from_str("WIDE_CHARS"));
+    if (wchars_obj != MP_OBJ_NULL && wchars_obj != mp_const_none)
+      glyph_table_load_chars(&out->wide, wchars_obj);
+    if (dict_get_int_optional(dict, "WIDE_WIDTH", &v))
+      out->wide.width = (uint8_t)v;
+    if (dict_get_int_optional(dict, "WIDE_HEIGHT", &v))
+      out->wide.height = (uint8_t)v;
+  }
+}
+
+// The tile block belongs to the module, not to a VT: VT() starts its
+// cache out zeroed (every soft reset builds a new VT), so a block held
+// only by the object would be dropped unfreed each time. Kept here it is
+// picked up again instead, the same way row_dma_buf is.
+static uint8_t *glyph_cache_block;
+static size_t glyph_cache_block_pixels; // tile_pixels it was sized for
+
+void vt_glyph_cache_reset(vt_glyph_cache_t *cache, uint8_t width,
+                          uint8_t height) {
+  const size_t n = VT_GLYPH_CACHE_SETS * VT_GLYPH_CACHE_WAYS;
+  const size_t keys_bytes = n * sizeof(vt_glyph_tile_key_t);
+  size_t tile_pixels = (size_t)width * height;
+
+  cache->keys = NULL;
+  cache->tiles = NULL;
+  cache->tile_pixels = 0;
+  cache->clock = 0;
+
+  if (glyph_cache_block && glyph_cache_block_pixels == tile_pixels) {
+    memset(glyph_cache_block, 0, keys_bytes);
+  } else {
+    if (glyph_cache_block)
+      heap_caps_free(glyph_cache_block);
+    glyph_cache_block = NULL;
+    glyph_cache_block_pixels = 0;
+    if (tile_pixels == 0)
+      return;
+    // One PSRAM block for both arrays. No PSRAM (or not enough of it)
+    // just leaves the cache disabled -- render_row_rgb565() rasterizes
+    // every cell directly, same as before the cache existed.
+    glyph_cache_block =
+        heap_caps_calloc(1, keys_bytes + n * tile_pixels * sizeof(uint16_t),
+                         MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!glyph_cache_block)
+      return;
+    glyph_cache_block_pixels = tile_pixels;
+  }
+
+  cache->keys = (vt_glyph_tile_key_t *)glyph_cache_block;
+  cache->tiles = (uint16_t *)(glyph_cache_block + keys_bytes);
+  cache->tile_pixels = tile_pixels;
+}
+
+// Like glyph_cache_block: one set of slots, shared by every VT and kept
+// across VT() calls. A VT attaching to it clears it first -- what's there
+// may point into the font tables of one that's gone.
+static vt_hot_glyph_t *hot_glyph_slots;
+
+void vt_hot_glyphs_reset(vt_hot_glyphs_t *hot) {
+  if (hot->slots)
+    memset(hot->slots, 0, VT_HOT_GLYPHS * sizeof(vt_hot_glyph_t));
+}
+
+// Bitmap of `cp` in `t` (glyph_bytes per glyph), or NULL if `t` doesn't
+// have it. Sorted-list and range tables are small and usually in RAM, so
+// they're read in place. A paged table is a big flash font: its glyphs
+// are copied into vt->hot_glyphs on first use so a screenful of, say,
+// CJK text doesn't cycle through the flash cache on every redraw.
+//
+// The pointer returned has to stay good for the rest of the row, since
+// render_row_rgb565() collects one per cell before it draws any; a slot
+// already handed out this row is never evicted, the colliding glyph is
+// just read from flash instead.
+static const uint8_t *glyph_table_bitmap(vt_hot_glyphs_t *hot,
+                                         const vt_glyph_table_t *t,
+                                         uint32_t cp, size_t glyph_bytes) {
+  if (t->pages && glyph_bytes <= VT_HOT_GLYPH_BYTES && !hot->slots) {
+    if (hot_glyph_slots)
+      memset(hot_glyph_slots, 0, VT_HOT_GLYPHS * sizeof(vt_hot_glyph_t));
+    else
+      hot_glyph_slots = heap_caps_calloc(VT_HOT_GLYPHS, sizeof(vt_hot_glyph_t),
+                                         MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    hot->slots = hot_glyph_slots;
+  }
+  if (!t->pages || glyph_bytes > VT_HOT_GLYPH_BYTES || !hot->slots) {
+    return glyph_table_glyph(t, cp, glyph_bytes);
+  }
+
+  vt_hot_glyph_t *h = &hot->slots[cp % VT_HOT_GLYPHS];
+  if (h->table == t && h->cp == cp) {
+    h->row = hot->row;
+    return h->present ? h->bits : NULL;
+  }
+
+  const uint8_t *src = glyph_table_glyph(t, cp, glyph_bytes);
+  if (h->table && h->row == hot->row)
+    return src;
+  h->table = t;
+  h->cp = cp;
+  h->row = hot->row;
+  h->present = src != NULL;
+  if (!src)
+    return NULL;
+  memcpy(h->bits, src, glyph_bytes);
+  return h->bits;
+}
+
+// Rasterizes one narrow, non-cursor cell -- the same pixels the generic
+// per-cell path in render_row_rgb565() produces, just for all f_height
+// scanlines at once into a contiguous tile. Font bitmaps are inverted
+// (a set bit is background).
+static void glyph_tile_render(uint16_t *tile, const uint8_t *glyph,
+                              uint8_t f_width, uint8_t f_height,
+                              uint8_t row_bytes, uint16_t fg, uint16_t bg,
+                              bool underline) {
+  for (uint8_t line_y = 0; line_y < f_height; line_y++) {
+    uint16_t *out = tile + line_y * f_width;
+    if (underline && line_y >= f_height - 2) {
+      for (uint8_t p = 0; p < f_width; p++)
+        out[p] = fg;
+    } else if (glyph) {
+      const uint8_t *data_ptr = glyph + line_y * row_bytes;
+      for (uint8_t p = 0; p < f_width; p++)
+        out[p] = (data_ptr[p / 8] & (0x80 >> (p % 8))) ? bg : fg;
+    } else {
+      for (uint8_t p = 0; p < f_width; p++)
+        out[p] = bg;
+    }
+  }
+}
+
+// Set by render_glyph_mask() around its render_row_rgb565() call: a
+// remote viewer's glyph requests shouldn't evict the panel's tiles or
+// show up in glyph_cache_stats().
+static bool glyph_cache_bypass;
+
+// Returns the cached tile for this cell, rasterizing it into the set's
+// least-recently-used way on a miss. NULL only if the cache is disabled.
+static const uint16_t *glyph_cache_lookup(vt_glyph_cache_t *cache,
+                                          const vt_font_t *font,
+                                          uint32_t rune, uint16_t mode,
+                                          uint16_t fg, uint16_t bg,
+                                          const uint8_t *glyph) {
+  if (!cache->tile_pixels)
+    return NULL;
+
+  mode &= ATTR_BOLD | ATTR_UNDERLINE | ATTR_REVERSE;
+  uint32_t h = (rune * 2654435761u) ^ ((uint32_t)fg << 16 | bg) ^
+               ((uint32_t)mode * 40503u);
+  h ^= h >> 15;
+  size_t base = (h % VT_GLYPH_CACHE_SETS) * VT_GLYPH_CACHE_WAYS;
+
+  // Stamps start at 1 so 0 can mean "empty"; on the (very) rare wrap,
+  // everything just looks equally old for one round of evictions.
+  if (++cache->clock == 0)
+    cache->clock = 1;
+
+  size_t victim = base;
+  for (size_t w = base; w < base + VT_GLYPH_CACHE_WAYS; w++) {
+    vt_glyph_tile_key_t *k = &cache->keys[w];
+    if (k->stamp && k->rune == rune && k->fg == fg && k->bg == bg &&
+        k->mode == mode) {
+      k->stamp = cache->clock;
+      cache->hits++;
+      return cache->tiles + w * cache->tile_pixels;
+    }
+    if (k->stamp < cache->keys[victim].stamp)
+      victim = w;
+  }
+
+  cache->misses++;
+  vt_glyph_tile_key_t *k = &cache->keys[victim];
+  k->rune = rune;
+  k->fg = fg;
+  k->bg = bg;
+  k->mode = mode;
+  k->stamp = cache->clock;
+  uint16_t *tile = cache->tiles + victim * cache->tile_pixels;
+  glyph_tile_render(tile, glyph, font->width, font->height, font->row_bytes,
+                    fg, bg, mode & ATTR_UNDERLINE);
+  return tile;
+}
+
 uint16_t map_st_color(int number) {
   uint16_t r565;
 
+  // Packed Glyphs keep truecolors in a side table (see st.h)
+  number = tcolorunpack(number);
+
+  // 0. Truecolor (38;2;r;g;b / 48;2;r;g;b)
+  if (IS_TRUECOL(number)) {
+    r565 = (((number >> 16) & 0xF8) << 8) | (((number >> 8) & 0xFC) << 3) |
+           ((number & 0xF8) >> 3);
+  }
   // 1. Standard/Bright (0-15)
-  if (number < 16) {
+  else if (number < 16) {
     static const uint16_t ansi_16[16] = {
         0x0000, 0x8000, 0x0400, 0x8400, 0x0010, 0x8010, 0x0410, 0xBDF7,
         0x8410, 0xF800, 0x07E0, 0xFFE0, 0x001F, 0xF81F, 0x07FF, 0xFFFF};
@@ -86,77 +669,24 @@ void draw_bar_ansi(const char *text, size_t len, int bar_type) {
   Glyph *now = (bar_type == -1) ? top_line_now : bot_line_now;
   Glyph *last = (bar_type == -1) ? top_line_last : bot_line_last;
 
-  TCursor save_cursor = term.c;
-  int save_esc = term.esc;
-  Line *original_lines = term.line;
-  // term.line is Line* -- a pointer to an ARRAY of row pointers, indexed
-  // as term.line[y]. A single `Line virtual_line = now;` only backs
-  // term.line[0]; if bar text ever overflows term.col, tputc()'s
-  // unconditional wrap check (`term.c.x + 1 > term.col`, fires
-  // regardless of wrap mode) calls tnewline() -> tmoveto(), which clamps
-  // term.c.y to [0, term.row - 1] -- the REAL terminal's full height, not
-  // just +1. tsetchar() then dereferences term.line[term.c.y] as a
-  // Glyph* -- reading whatever garbage sits past a too-small stack
-  // buffer and writing through it. Sized to term.row (every entry
-  // aliased to the same `now` buffer) so term.c.y can never land outside
-  // it, regardless of how many wraps occur -- an unexpected wrap just
-  // harmlessly overlaps the one real row instead of corrupting memory.
-  Line virtual_line[term.row];
-  for (int i = 0; i < term.row; i++)
-    virtual_line[i] = now;
-  term.line = virtual_line;
-
-  // csiescseq/strescseq are the accumulation buffers for an in-progress
-  // CSI/OSC-style escape sequence -- separate globals from `term`, shared
-  // with whatever the main terminal is mid-way through parsing (e.g. one
-  // of vttui's own SGR color codes). Save and reset them the same way as
-  // term.c/term.line/term.esc above, or the status bar's own escape
-  // sequences silently clobber the interrupted sequence's accumulated
-  // bytes even though term.esc itself now correctly round-trips.
-  CSIEscape save_csiescseq = csiescseq;
-  STREscape save_strescseq = strescseq;
-  memset(&csiescseq, 0, sizeof(csiescseq));
-  memset(&strescseq, 0, sizeof(strescseq));
-
-  // Reset buffer and cursor
+  // The bar has a parser of its own (tbarwrite(), st.c), so this never
+  // touches the terminal's cursor or escape state -- a refresh can land
+  // in the middle of one of vttui's sequences and leave it intact.
+  TBar bar;
   memset(now, 0, sizeof(Glyph) * 256);
-  term.c.x = 0;
-  term.c.y = 0;
-  term.c.attr.mode = ATTR_NULL;
-  term.c.attr.fg = defaultfg;
-  term.c.attr.bg = defaultbg;
-  term.esc = 0;
-
-  // Decode UTF-8 the same way twrite() does (st.c) -- tputc() expects a
-  // full, already-decoded Rune, not raw bytes. Feeding it one byte at a
-  // time (the old code here) silently "worked" only as long as the
-  // status bar's own text was pure ASCII, where every byte already is
-  // its own valid codepoint; it breaks for real multi-byte UTF-8 like
-  // the icon glyphs, splitting each 3-byte sequence into three bogus
-  // single-byte "codepoints" that never match anything (or trigger
-  // ATTR_WIDE via st_wcwidth()).
-  for (size_t i = 0; i < len;) {
-    Rune u;
-    size_t charsize = utf8decode(text + i, &u, len - i);
-    if (charsize == 0)
-      break;
-    tputc(u);
-    i += charsize;
-  }
-
-  term.line = original_lines;
-  term.c = save_cursor;
-  term.esc = save_esc;
-  csiescseq = save_csiescseq;
-  strescseq = save_strescseq;
+  tbarinit(&bar, now, SMIN(term.col, 256));
+  tbarwrite(&bar, text, len);
 
   // Dirty check: Compare results
   if (memcmp(now, last, term.col * sizeof(Glyph)) == 0) {
     return;
   }
 
+  term.bargen[bar_type == -1 ? 0 : 1] = ++term.gen;
+
   // Render to the specific hardware location (-1 or -2)
   xdrawline(now, 0, bar_type, term.col);
+  xfinishdraw();
 
   // Sync back-buffer
   memcpy(last, now, term.col * sizeof(Glyph));
@@ -185,17 +715,15 @@ row_render_t render_row_rgb565(Line ln, int _x1, int _y1, int _x2,
   vt_VT_obj_t *vt = current_vt_obj;
   st7789_ST7789_obj_t *display = vt->display_drv;
 
-  // 1. Setup Metrics
-  mp_obj_dict_t *dict = MP_OBJ_TO_PTR(vt->font->globals);
-  const uint8_t f_width =
-      mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_WIDTH)));
-  const uint8_t f_height =
-      mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_HEIGHT)));
-  const uint8_t first =
-      mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_FIRST)));
-  const uint8_t last =
-      mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_LAST)));
-  uint8_t wide = (f_width + 7) / 8;
+  // 1. Setup Metrics -- all pre-resolved by vt_font_compile(), see fb.h.
+  const vt_font_t *font = &vt->font_desc;
+  const uint8_t f_width = font->width;
+  const uint8_t f_height = font->height;
+  const uint8_t wide = font->row_bytes;
+  if (f_width == 0 || f_height == 0)
+    return result;
+  // New row: every hot glyph slot may be evicted again.
+  vt->hot_glyphs.row++;
 
   uint16_t x_start = _x1 * f_width;
   uint16_t y_start;
@@ -249,61 +777,23 @@ row_render_t render_row_rgb565(Line ln, int _x1, int _y1, int _x2,
       uint8_t wide_height_cache[num_cols];
       int16_t wide_x_off_cache[num_cols];
       int16_t wide_y_off_cache[num_cols];
+      // Pre-rendered tile from vt->glyph_cache for plain narrow cells,
+      // NULL for anything rendered the slow way below (wide glyphs, the
+      // cursor cell, or a disabled cache).
+      const uint16_t *tile_cache[num_cols];
 
-      // REGULAR/BOLD are normally required -- every font shipped by
-      // fontconvert.py's default (non---icons) mode defines them. But
-      // --icons mode produces an icons-ONLY module with neither, so an
-      // icons-only font selected as the active font (see icontest.py's
-      // earlier approach, before ICONS could live alongside a real font)
-      // would otherwise hit the same "mp_obj_dict_get raises KeyError on
-      // a missing key" crash WIDE_FONT/UNICODE_FONT already hit. Optional
-      // here too: missing REGULAR just means ASCII text renders blank
-      // for this font rather than crashing (see the ASCII-range branch
-      // below, which now checks reg_buf.buf before using it).
-      mp_buffer_info_t reg_buf = {0}, bold_buf = {0};
-      mp_obj_t reg_obj = dict_get_optional(MP_OBJ_TO_PTR(vt->font->globals),
-                                           MP_QSTR_REGULAR);
-      if (reg_obj != MP_OBJ_NULL && reg_obj != mp_const_none) {
-        mp_get_buffer_raise(reg_obj, &reg_buf, MP_BUFFER_READ);
-      }
-      mp_obj_t bold_obj = dict_get_optional(MP_OBJ_TO_PTR(vt->font->globals),
-                                            MP_QSTR_BOLD);
-      if (bold_obj != MP_OBJ_NULL && bold_obj != mp_const_none) {
-        mp_get_buffer_raise(bold_obj, &bold_buf, MP_BUFFER_READ);
-      }
-
-      // Unicode font handling
-      mp_buffer_info_t box_buf = {0};
-      uint32_t box_codepoints[32];
-      size_t box_count = 0;
-      mp_obj_t box_font_obj = dict_get_optional(
-          MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("UNICODE_FONT"));
-      if (box_font_obj != MP_OBJ_NULL && box_font_obj != mp_const_none) {
-        mp_get_buffer_raise(box_font_obj, &box_buf, MP_BUFFER_READ);
-        mp_obj_t chars_obj = dict_get_optional(
-            MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("UNICODE_CHARS"));
-        if (chars_obj != MP_OBJ_NULL && chars_obj != mp_const_none) {
-          box_count = (size_t)mp_obj_get_int(mp_obj_len(chars_obj));
-          if (box_count > 32)
-            box_count = 32;
-          for (size_t j = 0; j < box_count; j++)
-            box_codepoints[j] = (uint32_t)mp_obj_get_int(mp_obj_subscr(
-                chars_obj, MP_OBJ_NEW_SMALL_INT(j), MP_OBJ_SENTINEL));
-        }
-      }
+      // Cursor Stats
+      uint16_t cursor_fg = 0xFFFF;
+      int cur_x = term.c.x;
+      int cur_y = term.c.y;
+      bool show_cursor = !(wmode & MODE_HIDE);
+      int style = term.cursor_style;
 
       // Wide (double-width) glyph handling, e.g. Chess Symbols (bundled
       // directly into Unifont's own WIDE_FONT block) or an icon font like
       // Siji (loaded independently via VT.set_icon_font() -- see fb.h).
-      // Two supported shapes for WIDE_FONT, checked in this order:
-      //   1. Contiguous range (WIDE_FIRST + WIDE_COUNT): O(1) index, no
-      //      per-glyph table -- for a big set like Siji's ~400 icons,
-      //      where a codepoint array would mean a many-hundred-entry
-      //      stack allocation on every single redraw.
-      //   2. Explicit small list (WIDE_CHARS): for a handful of
-      //      non-contiguous codepoints, e.g. the dozen Chess Symbols.
-      // Optional either way: no icon_font set, or a main font with
-      // neither shape, just means ATTR_WIDE cells render narrow, same as
+      // Optional either way: no icon_font set, or a main font without a
+      // WIDE_FONT block, just means ATTR_WIDE cells render narrow, same as
       // any other missing glyph.
       //
       // icon_font and the main font's own WIDE_FONT are NOT mutually
@@ -311,103 +801,21 @@ row_render_t render_row_rgb565(Line ln, int _x1, int _y1, int _x2,
       // the main font currently is (see VT.set_icon_font()), and apps
       // like chess.py temporarily swap the main font to one with its own
       // WIDE_FONT (Unifont's chess pieces) while the icon font stays set
-      // for the status bar. So both tables are loaded and checked --
-      // icon font first, then the main font's own WIDE_FONT as a
-      // fallback -- instead of one silently shadowing the other.
-      mp_buffer_info_t wide_buf = {0};
-      uint32_t wide_codepoints[32];
-      size_t wide_count = 0;
-      uint32_t wide_first = 0;
-      uint32_t wide_range_count = 0;
-      uint8_t wide_width = f_width;
-      uint8_t wide_height = f_height;
-      uint8_t wide_row_bytes = wide;
-      mp_obj_module_t *icon_font_mod = vt->icon_font ? vt->icon_font : vt->font;
-      mp_obj_t wide_font_obj = dict_get_optional(
-          MP_OBJ_TO_PTR(icon_font_mod->globals), qstr_from_str("WIDE_FONT"));
-      if (wide_font_obj != MP_OBJ_NULL && wide_font_obj != mp_const_none) {
-        mp_get_buffer_raise(wide_font_obj, &wide_buf, MP_BUFFER_READ);
-        mp_obj_t wfirst_obj = dict_get_optional(
-            MP_OBJ_TO_PTR(icon_font_mod->globals), qstr_from_str("WIDE_FIRST"));
-        mp_obj_t wrange_count_obj = dict_get_optional(
-            MP_OBJ_TO_PTR(icon_font_mod->globals), qstr_from_str("WIDE_COUNT"));
-        if (wfirst_obj != MP_OBJ_NULL && wfirst_obj != mp_const_none &&
-            wrange_count_obj != MP_OBJ_NULL && wrange_count_obj != mp_const_none) {
-          wide_first = (uint32_t)mp_obj_get_int(wfirst_obj);
-          wide_range_count = (uint32_t)mp_obj_get_int(wrange_count_obj);
-        }
-        mp_obj_t wchars_obj = dict_get_optional(
-            MP_OBJ_TO_PTR(icon_font_mod->globals), qstr_from_str("WIDE_CHARS"));
-        if (wchars_obj != MP_OBJ_NULL && wchars_obj != mp_const_none) {
-          wide_count = (size_t)mp_obj_get_int(mp_obj_len(wchars_obj));
-          if (wide_count > 32)
-            wide_count = 32;
-          for (size_t j = 0; j < wide_count; j++)
-            wide_codepoints[j] = (uint32_t)mp_obj_get_int(mp_obj_subscr(
-                wchars_obj, MP_OBJ_NEW_SMALL_INT(j), MP_OBJ_SENTINEL));
-        }
-        mp_obj_t wwidth_obj = dict_get_optional(
-            MP_OBJ_TO_PTR(icon_font_mod->globals), qstr_from_str("WIDE_WIDTH"));
-        if (wwidth_obj != MP_OBJ_NULL && wwidth_obj != mp_const_none) {
-          wide_width = (uint8_t)mp_obj_get_int(wwidth_obj);
-          wide_row_bytes = (wide_width + 7) / 8;
-        }
-        mp_obj_t wheight_obj = dict_get_optional(
-            MP_OBJ_TO_PTR(icon_font_mod->globals), qstr_from_str("WIDE_HEIGHT"));
-        if (wheight_obj != MP_OBJ_NULL && wheight_obj != mp_const_none) {
-          wide_height = (uint8_t)mp_obj_get_int(wheight_obj);
-        }
-      }
-
-      // Fallback table: the main font's own WIDE_FONT. Only worth loading
-      // separately when an icon font is actually set -- otherwise
-      // icon_font_mod above already IS vt->font and this would just be a
-      // duplicate lookup of the same table.
-      mp_buffer_info_t wide_buf2 = {0};
-      uint32_t wide_codepoints2[32];
-      size_t wide_count2 = 0;
-      uint32_t wide_first2 = 0;
-      uint32_t wide_range_count2 = 0;
-      uint8_t wide_width2 = f_width;
-      uint8_t wide_height2 = f_height;
-      uint8_t wide_row_bytes2 = wide;
-      if (vt->icon_font) {
-        mp_obj_t wide_font_obj2 = dict_get_optional(
-            MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("WIDE_FONT"));
-        if (wide_font_obj2 != MP_OBJ_NULL && wide_font_obj2 != mp_const_none) {
-          mp_get_buffer_raise(wide_font_obj2, &wide_buf2, MP_BUFFER_READ);
-          mp_obj_t wfirst_obj2 = dict_get_optional(
-              MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("WIDE_FIRST"));
-          mp_obj_t wrange_count_obj2 = dict_get_optional(
-              MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("WIDE_COUNT"));
-          if (wfirst_obj2 != MP_OBJ_NULL && wfirst_obj2 != mp_const_none &&
-              wrange_count_obj2 != MP_OBJ_NULL && wrange_count_obj2 != mp_const_none) {
-            wide_first2 = (uint32_t)mp_obj_get_int(wfirst_obj2);
-            wide_range_count2 = (uint32_t)mp_obj_get_int(wrange_count_obj2);
-          }
-          mp_obj_t wchars_obj2 = dict_get_optional(
-              MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("WIDE_CHARS"));
-          if (wchars_obj2 != MP_OBJ_NULL && wchars_obj2 != mp_const_none) {
-            wide_count2 = (size_t)mp_obj_get_int(mp_obj_len(wchars_obj2));
-            if (wide_count2 > 32)
-              wide_count2 = 32;
-            for (size_t j = 0; j < wide_count2; j++)
-              wide_codepoints2[j] = (uint32_t)mp_obj_get_int(mp_obj_subscr(
-                  wchars_obj2, MP_OBJ_NEW_SMALL_INT(j), MP_OBJ_SENTINEL));
-          }
-          mp_obj_t wwidth_obj2 = dict_get_optional(
-              MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("WIDE_WIDTH"));
-          if (wwidth_obj2 != MP_OBJ_NULL && wwidth_obj2 != mp_const_none) {
-            wide_width2 = (uint8_t)mp_obj_get_int(wwidth_obj2);
-            wide_row_bytes2 = (wide_width2 + 7) / 8;
-          }
-          mp_obj_t wheight_obj2 = dict_get_optional(
-              MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("WIDE_HEIGHT"));
-          if (wheight_obj2 != MP_OBJ_NULL && wheight_obj2 != mp_const_none) {
-            wide_height2 = (uint8_t)mp_obj_get_int(wheight_obj2);
-          }
-        }
-      }
+      // for the status bar. So both tables are checked -- icon font
+      // first, then the main font's own WIDE_FONT as a fallback --
+      // instead of one silently shadowing the other.
+      static const vt_glyph_table_t no_table = {0};
+      const vt_glyph_table_t *wide_tbl =
+          vt->icon_font != MP_OBJ_NULL ? &vt->icon_font_desc.wide
+                                       : &font->wide;
+      const vt_glyph_table_t *wide_tbl2 =
+          vt->icon_font != MP_OBJ_NULL ? &font->wide : &no_table;
+      uint8_t wide_width = wide_tbl->width ? wide_tbl->width : f_width;
+      uint8_t wide_height = wide_tbl->height ? wide_tbl->height : f_height;
+      uint8_t wide_row_bytes = (wide_width + 7) / 8;
+      uint8_t wide_width2 = wide_tbl2->width ? wide_tbl2->width : f_width;
+      uint8_t wide_height2 = wide_tbl2->height ? wide_tbl2->height : f_height;
+      uint8_t wide_row_bytes2 = (wide_width2 + 7) / 8;
 
       // Wide glyphs always occupy a fixed 2*f_width x f_height cell (that's
       // what ATTR_WIDE + the following ATTR_WDUMMY actually reserve in the
@@ -423,34 +831,12 @@ row_render_t render_row_rgb565(Line ln, int _x1, int _y1, int _x2,
       int16_t wide_x_off2 = ((int16_t)(2 * f_width) - (int16_t)wide_width2) / 2;
       int16_t wide_y_off2 = ((int16_t)f_height - (int16_t)wide_height2) / 2;
 
-      // Icon glyph handling (fontconvert.py --icons), e.g. Siji. One
-      // contiguous codepoint range starting at ICON_FIRST, so unlike
-      // UNICODE_FONT/WIDE_FONT this doesn't need a per-glyph codepoint
-      // table -- just a base + count to compute the index directly.
-      // Optional: most fonts don't define ICONS.
-      mp_buffer_info_t icons_buf = {0};
-      uint32_t icon_first = 0;
-      uint32_t icon_count = 0;
-      mp_obj_t icons_font_obj = dict_get_optional(
-          MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("ICONS"));
-      if (icons_font_obj != MP_OBJ_NULL && icons_font_obj != mp_const_none) {
-        mp_get_buffer_raise(icons_font_obj, &icons_buf, MP_BUFFER_READ);
-        mp_obj_t ifirst_obj = dict_get_optional(
-            MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("ICON_FIRST"));
-        if (ifirst_obj != MP_OBJ_NULL && ifirst_obj != mp_const_none) {
-          icon_first = (uint32_t)mp_obj_get_int(ifirst_obj);
-        }
-        mp_obj_t icount_obj = dict_get_optional(
-            MP_OBJ_TO_PTR(vt->font->globals), qstr_from_str("ICON_COUNT"));
-        if (icount_obj != MP_OBJ_NULL && icount_obj != mp_const_none) {
-          icon_count = (uint32_t)mp_obj_get_int(icount_obj);
-        }
-      }
-
       // Populate caching
       for (uint16_t i = 0; i < num_cols; i++) {
         int col_idx = _x1 + i;
 
+        tile_cache[i] = NULL;
+
         uint16_t fg = map_st_color(ln[col_idx].fg);
         uint16_t bg = map_st_color(ln[col_idx].bg);
         if (ln[col_idx].mode & ATTR_REVERSE) {
@@ -491,79 +877,48 @@ row_render_t render_row_rgb565(Line ln, int _x1, int _y1, int _x2,
           wide_x_off_cache[i] = wide_x_off;
           wide_y_off_cache[i] = wide_y_off;
 
-          if (wide_buf.buf) {
-            if (wide_range_count > 0 && char_val >= wide_first &&
-                char_val < wide_first + wide_range_count) {
-              uint32_t index = char_val - wide_first;
-              font_ptr_cache[i] = (uint8_t *)wide_buf.buf +
-                                  index * (wide_height * wide_row_bytes);
-            } else if (wide_count > 0) {
-              for (size_t j = 0; j < wide_count; j++) {
-                if (wide_codepoints[j] == char_val) {
-                  font_ptr_cache[i] = (uint8_t *)wide_buf.buf +
-                                      j * (wide_height * wide_row_bytes);
-                  break;
-                }
-              }
-            }
-          }
-
-          if (!font_ptr_cache[i] && wide_buf2.buf) {
+          const uint8_t *glyph;
+          if ((glyph = glyph_table_bitmap(&vt->hot_glyphs, wide_tbl, char_val,
+                                          wide_height * wide_row_bytes))) {
+            font_ptr_cache[i] = glyph;
+          } else if ((glyph = glyph_table_bitmap(
+                          &vt->hot_glyphs, wide_tbl2, char_val,
+                          wide_height2 * wide_row_bytes2))) {
             wide_row_bytes_cache[i] = wide_row_bytes2;
             wide_width_cache[i] = wide_width2;
             wide_height_cache[i] = wide_height2;
             wide_x_off_cache[i] = wide_x_off2;
             wide_y_off_cache[i] = wide_y_off2;
-            if (wide_range_count2 > 0 && char_val >= wide_first2 &&
-                char_val < wide_first2 + wide_range_count2) {
-              uint32_t index = char_val - wide_first2;
-              font_ptr_cache[i] = (uint8_t *)wide_buf2.buf +
-                                  index * (wide_height2 * wide_row_bytes2);
-            } else if (wide_count2 > 0) {
-              for (size_t j = 0; j < wide_count2; j++) {
-                if (wide_codepoints2[j] == char_val) {
-                  font_ptr_cache[i] = (uint8_t *)wide_buf2.buf +
-                                      j * (wide_height2 * wide_row_bytes2);
-                  break;
-                }
-              }
-            }
+            font_ptr_cache[i] = glyph;
           }
           continue;
         }
 
         col_width_cache[i] = f_width;
-        if (char_val >= first && char_val <= last && reg_buf.buf) {
-          uint32_t offset = (char_val - first) * (f_height * wide);
-          const uint8_t *base = ((ln[col_idx].mode & ATTR_BOLD) && bold_buf.buf)
-                                    ? (uint8_t *)bold_buf.buf
-                                    : (uint8_t *)reg_buf.buf;
+        font_ptr_cache[i] = NULL;
+        if (char_val >= font->first && char_val <= font->last &&
+            font->regular) {
+          uint32_t offset = (char_val - font->first) * (f_height * wide);
+          const uint8_t *base = ((ln[col_idx].mode & ATTR_BOLD) && font->bold)
+                                    ? font->bold
+                                    : font->regular;
           font_ptr_cache[i] = base + offset;
-        } else if (icons_buf.buf && icon_count > 0 && char_val >= icon_first &&
-                   char_val < icon_first + icon_count) {
-          uint32_t index = char_val - icon_first;
+        } else {
           font_ptr_cache[i] =
-              (uint8_t *)icons_buf.buf + index * (f_height * wide);
-        } else if (box_buf.buf && box_count > 0) {
-          font_ptr_cache[i] = NULL;
-          for (size_t j = 0; j < box_count; j++) {
-            if (box_codepoints[j] == char_val) {
-              font_ptr_cache[i] =
-                  (uint8_t *)box_buf.buf + j * (f_height * wide);
-              break;
-            }
+              glyph_table_glyph(&font->icons, char_val, f_height * wide);
+          if (!font_ptr_cache[i]) {
+            font_ptr_cache[i] = glyph_table_bitmap(
+                &vt->hot_glyphs, &font->unicode, char_val, f_height * wide);
           }
-        } else {
-          font_ptr_cache[i] = NULL;
         }
-      }
 
-      // Cursor Stats
-      uint16_t cursor_fg = 0xFFFF;
-      int cur_x = term.c.x;
-      int cur_y = term.c.y;
-      bool show_cursor = !(wmode & MODE_HIDE);
-      int style = term.cursor_style;
+        if (!(show_cursor && _y1 == cur_y && col_idx == cur_x) &&
+            !glyph_cache_bypass) {
+          tile_cache[i] = glyph_cache_lookup(
+              &vt->glyph_cache, font, char_val, ln[col_idx].mode,
+              fg_cache[i], bg_cache[i], font_ptr_cache[i]);
+        }
+      }
 
       // Rendering loop
       for (uint8_t line_y = 0; line_y < f_height; line_y++) {
@@ -577,6 +932,13 @@ row_render_t render_row_rgb565(Line ln, int _x1, int _y1, int _x2,
             continue;
           }
 
+          if (tile_cache[i]) {
+            memcpy(&out_buf[buf_idx], tile_cache[i] + line_y * f_width,
+                   f_width * sizeof(uint16_t));
+            buf_idx += f_width;
+            continue;
+          }
+
           const uint8_t *char_row_data = font_ptr_cache[i];
           int col_idx = _x1 + i;
           bool is_cursor_cell =
@@ -718,17 +1080,318 @@ row_render_t render_row_rgb565(Line ln, int _x1, int _y1, int _x2,
   return result;
 }
 
+// Row -> cell records, for a client that draws the glyphs itself. A row
+// is a stream of:
+//
+//   0xFF mode fg bg   attributes for the cells that follow: mode is the
+//                     ATTR_BOLD/UNDERLINE/WIDE bits, fg/bg big-endian
+//                     RGB565 -- all u16, colors already resolved the way
+//                     render_row_rgb565() resolves them (palette,
+//                     truecolor, ATTR_REVERSE)
+//   0xFE n <rune>     n cells of the same rune
+//   <rune>            one cell
+//
+// Runes are UTF-8, which never contains 0xFE/0xFF, so no escaping is
+// needed. A wide rune covers its ATTR_WDUMMY partner too; the partner
+// itself isn't sent. A typical shell line comes out at 20-60 bytes
+// against ~7 KB of pixels.
+size_t encode_row_cells(Line ln, uint8_t *out, size_t cap) {
+  const uint16_t keep = ATTR_BOLD | ATTR_UNDERLINE | ATTR_WIDE;
+  size_t n = 0;
+  int have_attr = 0;
+  uint16_t mode = 0, fg = 0, bg = 0;
+  char enc[UTF_SIZ];
+
+  if (cap < ROW_CELLS_MAX(term.col))
+    return 0;
+
+  for (int x = 0; x < term.col;) {
+    const Glyph *g = &ln[x];
+    if (g->mode & ATTR_WDUMMY) {
+      x++;
+      continue;
+    }
+
+    uint16_t m = g->mode & keep;
+    uint16_t f = map_st_color(g->fg), b = map_st_color(g->bg);
+    if (g->mode & ATTR_REVERSE) {
+      uint16_t t = f;
+      f = b;
+      b = t;
+    }
+    if (!have_attr || m != mode || f != fg || b != bg) {
+      have_attr = 1;
+      mode = m;
+      fg = f;
+      bg = b;
+      out[n++] = 0xFF;
+      out[n++] = mode >> 8;
+      out[n++] = mode;
+      // map_st_color() is already byte-swapped for the panel
+      out[n++] = fg;
+      out[n++] = fg >> 8;
+      out[n++] = bg;
+      out[n++] = bg >> 8;
+    }
+
+    // same rune and attributes: collapse into one repeat record
+    int run = 1;
+    while (x + run < term.col && run < 255 && ln[x + run].u == g->u &&
+           ln[x + run].mode == g->mode && ln[x + run].fg == g->fg &&
+           ln[x + run].bg == g->bg && !(g->mode & ATTR_WIDE))
+      run++;
+
+    size_t len = utf8encode(g->u ? g->u : ' ', enc);
+    if (run >= 3) {
+      out[n++] = 0xFE;
+      out[n++] = run;
+    } else {
+      run = 1;
+    }
+    memcpy(out + n, enc, len);
+    n += len;
+    x += run;
+  }
+  return n;
+}
+
+bool cursor_visible(void) { return !(wmode & MODE_HIDE); }
+
+// One glyph as a 1bpp mask (MSB first, rows padded to a byte, 1 = ink),
+// f_width or 2 * f_width wide by f_height. Rendered through
+// render_row_rgb565() itself rather than a second copy of its font
+// lookup, so the remote side gets the same glyph -- bold table, icon
+// font, WIDE_FONT centering and all -- that the panel shows.
+size_t render_glyph_mask(Rune u, bool bold, bool wide, uint8_t *out,
+                         size_t cap) {
+  if (!current_vt_obj)
+    return 0;
+  const vt_font_t *font = &current_vt_obj->font_desc;
+  int w = font->width * (wide ? 2 : 1), h = font->height;
+  int row_bytes = (w + 7) / 8;
+  if (w == 0 || h == 0 || cap < (size_t)row_bytes * h)
+    return 0;
+
+  // Two cells: the glyph and, for a wide one, its WDUMMY partner. Drawn
+  // as the top bar (y -1) so the cursor can never land on it.
+  Glyph cells[2] = {
+      {.u = u, .mode = (bold ? ATTR_BOLD : 0) | (wide ? ATTR_WIDE : 0),
+       .fg = defaultfg, .bg = defaultbg},
+      {.u = ' ', .mode = wide ? ATTR_WDUMMY : 0, .fg = defaultfg,
+       .bg = defaultbg},
+  };
+  int ncols = wide ? 2 : 1;
+  if (ncols >= term.col)
+    return 0; // would pick up render_row_rgb565()'s right-margin padding
+  // From the heap, not the stack: a wide glyph of a big font is several
+  // KB, and this runs on mp_task under vt_lock(), so it mustn't raise
+  // either.
+  uint16_t *px = heap_caps_malloc((size_t)w * h * sizeof(uint16_t),
+                                  MALLOC_CAP_8BIT);
+  if (!px)
+    return 0;
+  glyph_cache_bypass = true;
+  row_render_t r = render_row_rgb565(cells, 0, -1, ncols, px, w * h);
+  glyph_cache_bypass = false;
+  if (r.pixel_count != (size_t)w * h) {
+    heap_caps_free(px);
+    return 0;
+  }
+
+  uint16_t bgc = map_st_color(defaultbg);
+  memset(out, 0, row_bytes * h);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      if (px[y * w + x] != bgc)
+        out[y * row_bytes + x / 8] |= 0x80 >> (x % 8);
+    }
+  }
+  heap_caps_free(px);
+  return (size_t)row_bytes * h;
+}
+
+// Ping-pong row buffers for the DMA path of xdrawline(), allocated on
+// first use in DMA-capable internal RAM (the GC heap, where i2c_buffer
+// lives, is in PSRAM on the T-Deck). While one is on the wire the other
+// is being rasterized into; row_dma_next is whichever one isn't queued.
+static uint16_t *row_dma_buf[2];
+static size_t row_dma_size; // bytes, per buffer
+static int row_dma_next;
+
+static bool row_dma_ready(st7789_ST7789_obj_t *display) {
+  if (!st7789_dma_available(display))
+    return false;
+  if (row_dma_buf[0] && row_dma_size == display->buffer_size)
+    return true;
+
+  st7789_dma_wait(display);
+  for (int i = 0; i < 2; i++) {
+    if (row_dma_buf[i])
+      heap_caps_free(row_dma_buf[i]);
+    row_dma_buf[i] = heap_caps_malloc(display->buffer_size, MALLOC_CAP_DMA);
+  }
+  row_dma_size = display->buffer_size;
+  if (!row_dma_buf[0] || !row_dma_buf[1]) {
+    for (int i = 0; i < 2; i++) {
+      if (row_dma_buf[i])
+        heap_caps_free(row_dma_buf[i]);
+      row_dma_buf[i] = NULL;
+    }
+    row_dma_size = 0;
+    return false;
+  }
+  return true;
+}
+
+// Hardware vertical scroll state for xscroll(). Once a scroll has been
+// handed to the panel, text row y no longer lives at top_offset + y *
+// f_height in GRAM: the whole text area is a ring of term.row bands,
+// rotated by vscroll.offset pixels, and xdrawline() maps into it. The
+// bars and bottom margin sit in the fixed top/bottom areas and never
+// move. vscroll.pending means offset changed since the panel was last
+// told (VSCSAD is only sent on the next draw, so a burst of newlines
+// between frames costs one command, not one per line). The VSCRDEF that
+// sets the areas up is deferred the same way: xscroll() runs inside the
+// parser, which may be on the async drain task (vt_module.c), and must
+// never touch the SPI bus itself.
+//
+// Portrait only: st7789_vscroll_lines() is 0 in a landscape rotation
+// (including the T-Deck's), where the panel's scroll axis is horizontal,
+// and with a framebuffer. This all stays inactive then, and a scroll is
+// a redraw of the text rows like it always was.
+static struct {
+  st7789_ST7789_obj_t *display;
+  uint16_t lines;  // st7789_vscroll_lines() when defined, 0 = inactive
+  uint16_t tfa;    // == term.top_offset at define time
+  uint16_t vsa;    // == term.row * f_height at define time
+  uint16_t offset; // pixels, always a multiple of f_height
+  bool defined;    // VSCRDEF has been sent
+  bool pending;
+  bool stale;      // geometry changed under us, vscroll_reset() on commit
+} vscroll;
+
+// Puts the panel back to an unscrolled, undefined state. Layout changes
+// (vt.update_layout()/top_offset()) call this -- they repaint every row
+// anyway, and the old ring geometry no longer matches.
+void vscroll_reset(void) {
+  if (vscroll.defined) {
+    st7789_vscroll_define(vscroll.display, 0, vscroll.lines, 0);
+    st7789_vscroll_start(vscroll.display, 0);
+  }
+  memset(&vscroll, 0, sizeof(vscroll));
+}
+
+// Where a text row rendered for unscrolled y_start actually lives in GRAM.
+static uint16_t vscroll_map(uint16_t y_start) {
+  if (!vscroll.lines)
+    return y_start;
+  return vscroll.tfa +
+         (y_start - vscroll.tfa + vscroll.offset) % vscroll.vsa;
+}
+
+static void vscroll_commit(void) {
+  if (vscroll.stale)
+    vscroll_reset();
+  if (!vscroll.pending)
+    return;
+  vscroll.pending = false;
+  if (!vscroll.defined) {
+    vscroll.defined = true;
+    st7789_vscroll_define(vscroll.display, vscroll.tfa, vscroll.vsa,
+                          vscroll.lines - vscroll.tfa - vscroll.vsa);
+  }
+  st7789_vscroll_start(vscroll.display, vscroll.tfa + vscroll.offset);
+}
+
+// st.c's tscrollup()/tscrolldown() call this for a full-screen scroll of
+// n rows (n > 0 = content moves up, i.e. a newline at the bottom). Returns
+// 1 if the panel will do the move, in which case the caller only has to
+// dirty the rows the scroll exposes; 0 means repaint as usual. Only
+// possible when the rotation scrolls along logical y -- not the T-Deck's
+// landscape mode, where the gate axis runs left-right.
+int xscroll(int n) {
+  // A console in the background has nothing on the panel to move -- its
+  // rows are just marked dirty, for the repaint when it's switched to.
+  if (!current_vt_obj || tcur != tfront)
+    return 0;
+
+  vt_VT_obj_t *vt = current_vt_obj;
+  st7789_ST7789_obj_t *display = vt->display_drv;
+  const uint8_t f_height = vt->font_desc.height;
+  if (!display || f_height == 0 || term.row <= 0)
+    return 0;
+
+  int tfa = term.top_offset;
+  int vsa = term.row * f_height;
+
+  if (vscroll.stale)
+    return 0;
+  if (!vscroll.lines) {
+    uint16_t lines = st7789_vscroll_lines(display);
+    if (lines == 0 || tfa < 0 || tfa + vsa > display->height)
+      return 0;
+    vscroll.display = display;
+    vscroll.lines = lines;
+    vscroll.tfa = tfa;
+    vscroll.vsa = vsa;
+    vscroll.offset = 0;
+  } else if (vscroll.display != display || vscroll.tfa != tfa ||
+             vscroll.vsa != vsa) {
+    // Layout moved under us without a vscroll_reset() -- bail out to a
+    // full repaint rather than guess where the rows are. The panel is
+    // put back on the next xstartdraw(), before any row is drawn.
+    vscroll.stale = true;
+    return 0;
+  }
+
+  int delta = (n % term.row) * f_height;
+  vscroll.offset = (vscroll.offset + delta + vsa) % vsa;
+  vscroll.pending = true;
+  return 1;
+}
+
 // Physical-display half of the old xdrawline(): renders the row via
-// render_row_rgb565() into display->i2c_buffer (the same resident
-// scratch buffer it always used), then bursts it out over SPI. Any
-// caller that just wants the pixels -- not a screen update -- should
-// call render_row_rgb565() directly instead, with its own buffer.
+// render_row_rgb565(), then bursts it out over SPI. Any caller that just
+// wants the pixels -- not a screen update -- should call
+// render_row_rgb565() directly instead, with its own buffer.
+//
+// With a DMA device configured on the display (ST7789(..., dma_host=...)),
+// the window and the burst are only queued: this returns while row N is
+// still on the wire, so the caller can already be rasterizing row N+1
+// into the other ping-pong buffer. st7789_dma_write() waits out the
+// previous burst before queueing the next, and xfinishdraw() fences the
+// last one -- anything calling xdrawline() outside of draw() must call
+// xfinishdraw() after, or the buffer may be reused while still being
+// sent. Without DMA it's the old blocking path through
+// display->i2c_buffer.
 void xdrawline(Line ln, int _x1, int _y1, int _x2) {
   if (!current_vt_obj)
     return;
 
   vt_VT_obj_t *vt = current_vt_obj;
   st7789_ST7789_obj_t *display = vt->display_drv;
+
+  if (row_dma_ready(display)) {
+    uint16_t *buf = row_dma_buf[row_dma_next];
+    row_render_t r = render_row_rgb565(ln, _x1, _y1, _x2, buf,
+                                       row_dma_size / sizeof(uint16_t));
+    if (r.pixel_count == 0)
+      return;
+    if (_y1 >= 0)
+      r.y_start = vscroll_map(r.y_start);
+
+    set_window(display, r.x_start, r.y_start, r.x_end,
+               r.y_start + r.f_height - 1);
+    if (st7789_dma_write(display, (uint8_t *)buf, r.pixel_count * 2)) {
+      row_dma_next ^= 1;
+      return;
+    }
+    // Queueing failed -- nothing was sent, fall through to a blocking
+    // write of the same pixels.
+    st7789_write_data(display, (uint8_t *)buf, r.pixel_count * 2);
+    return;
+  }
+
   if (!display->i2c_buffer)
     return;
 
@@ -736,16 +1399,15 @@ void xdrawline(Line ln, int _x1, int _y1, int _x2) {
                                      display->buffer_size / sizeof(uint16_t));
   if (r.pixel_count == 0)
     return;
+  if (_y1 >= 0)
+    r.y_start = vscroll_map(r.y_start);
 
   set_window(display, r.x_start, r.y_start, r.x_end,
             r.y_start + r.f_height - 1);
 
   // SPI Burst for the core row line
-  mp_hal_pin_write(display->dc, 1);
-  mp_hal_pin_write(display->cs, 0);
-  write_spi(display->spi_obj, (uint8_t *)display->i2c_buffer,
-           r.pixel_count * 2);
-  mp_hal_pin_write(display->cs, 1);
+  st7789_write_data(display, (uint8_t *)display->i2c_buffer,
+                    r.pixel_count * 2);
 }
 
 // Fills the pixel band below the last text row, when the font's height
@@ -766,9 +1428,7 @@ void fill_bottom_margin(void) {
   if (!display || !display->i2c_buffer)
     return;
 
-  mp_obj_dict_t *dict = MP_OBJ_TO_PTR(vt->font->globals);
-  const uint8_t f_height =
-      mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_HEIGHT)));
+  const uint8_t f_height = vt->font_desc.height;
 
   int content_bottom = term.top_offset + (term.row * f_height);
   if (content_bottom >= display->height)
@@ -784,25 +1444,29 @@ void fill_bottom_margin(void) {
 
   set_window(display, 0, content_bottom, display->width - 1,
             display->height - 1);
-  mp_hal_pin_write(display->dc, 1);
-  mp_hal_pin_write(display->cs, 0);
-  write_spi(display->spi_obj, (uint8_t *)display->i2c_buffer, n_pixels * 2);
-  mp_hal_pin_write(display->cs, 1);
+  st7789_write_data(display, (uint8_t *)display->i2c_buffer, n_pixels * 2);
 }
 
 void repaint_bars(void) {
   if (!current_vt_obj || term.col <= 0)
     return;
   xdrawline(top_line_now, 0, -1, term.col);
+  xfinishdraw();
 }
 
 int xstartdraw(void) {
-  // Prepare a display for a frame update
+  // Prepare a display for a frame update: the scroll has to land before
+  // any newly exposed row is painted into the band it vacated.
+  vscroll_commit();
   return 1;
 }
 
 void xfinishdraw(void) {
-  // Push a buffer to the hardware
+  // Fence for xdrawline()'s DMA path: the last queued row is on the panel
+  // once this returns. With a shadow framebuffer on the display the rows
+  // only went into that, and this is what sends them.
+  if (current_vt_obj)
+    st7789_flush(current_vt_obj->display_drv);
 }
 
 void xximspot(int x, int y) {
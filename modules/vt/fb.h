@@ -14,17 +14,207 @@
 #include "win.h" /* To ensure we match original X11 signatures */
 #include <stdint.h>
 
+// One entry of a vt_glyph_table_t's sorted codepoint index: which glyph
+// slot (multiply by the table's per-glyph byte size) a codepoint maps to.
+// Also the on-flash layout of a VTF index entry (see below), padding
+// included, so a packed font's index is searched where it lies.
+typedef struct {
+  uint32_t codepoint;
+  uint16_t slot;
+  uint16_t pad;
+} vt_glyph_index_t;
+
+// Packed font container -- what utils/fontconvert.py --format vtf writes
+// and vt.Font() wraps. It carries the same blocks a font module does
+// (REGULAR, BOLD, UNICODE_FONT, ICONS, WIDE_FONT), but already in the
+// shape vt_font_compile() would have built: bitmaps and sorted codepoint
+// indexes are used in place, straight out of a bytes object or memory-
+// mapped flash (vt.flash_font()), so selecting one allocates nothing and
+// reads nothing but the header and block table.
+//
+// Little-endian throughout. Offsets are from the start of the container
+// and 4-byte aligned; containers in a fonts partition follow each other
+// at 4-byte aligned offsets, ended by anything that isn't VTF_MAGIC
+// (erased flash reads 0xFF).
+#define VTF_MAGIC "VTF1"
+#define VTF_NAME_MAX 24
+
+enum {
+  VTF_REGULAR = 1,
+  VTF_BOLD,
+  VTF_UNICODE, // index only, like UNICODE_CHARS
+  VTF_ICONS,   // range only, like ICON_FIRST/ICON_COUNT
+  VTF_WIDE,    // range and/or index, like WIDE_FIRST/WIDE_CHARS
+};
+#define VTF_KIND(id) ((id) & 0xff)
+
+// Set in a block's id when its index is paged rather than a sorted list:
+// index_off points at 256 uint16_t page numbers, one per high byte of a
+// BMP codepoint, followed by index_count pages of 256 uint16_t glyph
+// slots, one per low byte. VTF_NONE marks a missing page or glyph. A
+// lookup is two loads instead of a binary search, and at full-Unifont
+// scale it is also a quarter of the list's size. BMP only.
+#define VTF_PAGED 0x100
+#define VTF_NONE 0xffff
+#define VTF_PAGE_SIZE 256
+
+typedef struct {
+  char magic[4];
+  uint32_t size; // whole container, header included
+  char name[VTF_NAME_MAX]; // NUL-padded, what vt.flash_font() matches
+  uint8_t width;  // 0 for an icon-only font, like a module without WIDTH
+  uint8_t height;
+  uint8_t wide_width; // WIDE_WIDTH/WIDE_HEIGHT, 0 = the main font's cell
+  uint8_t wide_height;
+  uint32_t first;
+  uint32_t last;
+  uint16_t nblocks; // vt_vtf_block_t entries right after the header
+  uint16_t flags;   // none defined yet, written as 0
+} vt_vtf_header_t;
+
+typedef struct {
+  uint32_t id; // VTF_REGULAR ...
+  uint32_t bitmap_off;
+  uint32_t bitmap_len;
+  uint32_t range_first;
+  uint32_t range_count;
+  uint32_t index_off; // vt_glyph_index_t entries sorted by codepoint
+  uint32_t index_count; // entries, or pages with VTF_PAGED
+} vt_vtf_block_t;
+
+// vt.Font: a checked VTF container. `owner` is the object the bytes live
+// in, kept alive for as long as the Font is; MP_OBJ_NULL for a container
+// in mapped flash, which never goes away.
+typedef struct {
+  mp_obj_base_t base;
+  mp_obj_t owner;
+  const uint8_t *data;
+  vt_vtf_header_t hdr;
+} vt_font_obj_t;
+
+extern const mp_obj_type_t vt_Font_type;
+
+// Size of the VTF container at `p` if `len` bytes hold a well-formed one
+// (header, block table and every block inside it, and every glyph its
+// ranges and indexes name inside that block's bitmap), otherwise 0.
+size_t vt_vtf_check(const uint8_t *p, size_t len);
+
+// One optional glyph block of a font module (UNICODE_FONT, ICONS,
+// WIDE_FONT), resolved down to a raw bitmap pointer plus whichever of the
+// two addressing shapes the module defines: a contiguous range
+// (range_first + range_count, O(1)) and/or an explicit codepoint list
+// (UNICODE_CHARS/WIDE_CHARS), sorted into `index` for a binary search.
+// bitmap == NULL means the font doesn't define this block at all.
+// width/height of 0 mean "same as the main font's cell" -- an icon font
+// like Siji doesn't carry its own WIDTH/HEIGHT, and its WIDE_WIDTH/
+// WIDE_HEIGHT default to whatever text font it happens to be paired with.
+typedef struct {
+  const uint8_t *bitmap;
+  size_t bitmap_len; // bytes behind `bitmap`; no slot is read past it
+  uint32_t range_first;
+  uint32_t range_count;
+  const vt_glyph_index_t *index; // sorted by codepoint
+  size_t index_len;
+  bool index_owned; // m_new'd by vt_font_compile(), not a VTF's own
+  // A VTF_PAGED index instead of `index`: the page directory, with the
+  // pages right behind it. Always the container's own.
+  const uint16_t *pages;
+  uint8_t width;
+  uint8_t height;
+} vt_glyph_table_t;
+
+// Compiled, C-side view of a font module or vt.Font -- see
+// vt_font_compile() in fb.c. Built once when the font is selected (VT() /
+// update_layout() / set_icon_font()) so render_row_rgb565() never has to
+// go back through the module's globals dict on the per-row path. The
+// bitmap pointers borrow from the module's own bytes/memoryview objects
+// (or the Font's container), which stay alive for as long as vt_VT_obj_t
+// holds the font object itself.
+typedef struct {
+  uint8_t width;     // WIDTH, 0 if the module doesn't define one
+  uint8_t height;    // HEIGHT, 0 if the module doesn't define one
+  uint8_t row_bytes; // (width + 7) / 8
+  uint32_t first;    // FIRST..LAST: the REGULAR/BOLD codepoint range
+  uint32_t last;
+  const uint8_t *regular;
+  const uint8_t *bold;
+  vt_glyph_table_t unicode; // UNICODE_FONT + UNICODE_CHARS
+  vt_glyph_table_t icons;   // ICONS + ICON_FIRST/ICON_COUNT
+  vt_glyph_table_t wide;    // WIDE_FONT + WIDE_FIRST/WIDE_COUNT/WIDE_CHARS
+} vt_font_t;
+
+// Pre-rendered RGB565 tiles for narrow (single-cell) glyphs -- see
+// glyph_cache_lookup() in fb.c. 4-way set-associative, LRU within each
+// set, stored in PSRAM. A tile is exactly what render_row_rgb565() would
+// have produced for that cell (font->width x font->height pixels,
+// row-major), so a hit turns the cell into one memcpy per scanline.
+#define VT_GLYPH_CACHE_WAYS 4
+#define VT_GLYPH_CACHE_SETS 128
+
+typedef struct {
+  uint32_t rune;
+  uint32_t stamp; // last-use tick for LRU eviction, 0 = empty slot
+  uint16_t fg;    // final RGB565 colors, ATTR_REVERSE already applied
+  uint16_t bg;
+  uint16_t mode;  // ATTR_BOLD | ATTR_UNDERLINE | ATTR_REVERSE subset
+} vt_glyph_tile_key_t;
+
+typedef struct {
+  vt_glyph_tile_key_t *keys; // VT_GLYPH_CACHE_SETS * VT_GLYPH_CACHE_WAYS
+  uint16_t *tiles;           // same count, tile_pixels each
+  uint16_t tile_pixels;      // 0 = cache disabled (no PSRAM / no font)
+  uint32_t clock;
+  uint32_t hits;
+  uint32_t misses;
+} vt_glyph_cache_t;
+
+// RAM copies of glyphs recently drawn from a paged table -- which in
+// practice means a large font in a mapped flash partition, where every
+// glyph read would otherwise go through the flash cache. Direct-mapped on
+// the codepoint; see glyph_table_bitmap() in fb.c. Only allocated once a
+// paged table is actually drawn from, then shared by every VT and reused
+// across VT() calls.
+#define VT_HOT_GLYPHS 128
+#define VT_HOT_GLYPH_BYTES 64 // 16x32 or 32x16 at 1bpp; bigger goes uncached
+
+typedef struct {
+  const vt_glyph_table_t *table; // NULL = empty slot
+  uint32_t cp;
+  uint32_t row; // vt_hot_glyphs_t.row it was last handed out in
+  bool present; // false caches a miss
+  uint8_t bits[VT_HOT_GLYPH_BYTES];
+} vt_hot_glyph_t;
+
+typedef struct {
+  vt_hot_glyph_t *slots; // VT_HOT_GLYPHS, internal RAM
+  uint32_t row;          // bumped per rendered row
+} vt_hot_glyphs_t;
+
 typedef struct _vt_VT_obj_t {
   mp_obj_base_t base;
   st7789_ST7789_obj_t *display_drv;
-  mp_obj_module_t *font;
+  // A font module or a vt.Font.
+  mp_obj_t font;
   // Optional, independent of `font`: a supplemental double-width glyph
   // source (WIDE_FONT/WIDE_FIRST/WIDE_COUNT/WIDE_WIDTH -- see fb.c's
   // xdrawline()) for ATTR_WIDE codepoints, e.g. an icon font like Siji
-  // paired with whichever text font is active. NULL if unset -- ATTR_WIDE
-  // cells then just render narrow, same as any other missing glyph.
-  // Set via VT.set_icon_font(), independent of the main font/layout.
-  mp_obj_module_t *icon_font;
+  // paired with whichever text font is active. MP_OBJ_NULL if unset --
+  // ATTR_WIDE cells then just render narrow, same as any other missing
+  // glyph. Set via VT.set_icon_font(), independent of the main font.
+  mp_obj_t icon_font;
+  // Compiled descriptors for `font`/`icon_font` above -- rebuilt whenever
+  // either one changes, never on the draw path.
+  vt_font_t font_desc;
+  vt_font_t icon_font_desc;
+  // Keyed on font_desc's cell size, so rebuilt (emptied) on every main
+  // font change -- see vt_glyph_cache_reset().
+  vt_glyph_cache_t glyph_cache;
+  // Emptied on every font or icon font change -- see
+  // vt_hot_glyphs_reset().
+  vt_hot_glyphs_t hot_glyphs;
+  // VT.record()'s open file, MP_OBJ_NULL when not recording. Kept here,
+  // in a GC-allocated object, so the collector sees it.
+  mp_obj_t rec_file;
 } vt_VT_obj_t;
 
 // Persistent line for the status bar -- defined once in fb.c. Was
@@ -43,7 +233,8 @@ extern Glyph bot_line_last[256]; // Back-buffer for bottom bar
 
 extern vt_VT_obj_t *current_vt_obj;
 
-static unsigned int wmode = MODE_VISIBLE;
+// Per console, like the rest of the terminal's state (st.h).
+#define wmode (term.wmode)
 
 /* Window/UI operations */
 void xsettitle(char *p);
@@ -74,9 +265,28 @@ extern char *vtiden;
 extern wchar_t *worddelimiters;
 extern unsigned int defaultcs;
 
+// Resolves a font module's globals, or a vt.Font's blocks, into `out`
+// (releasing whatever `out` previously held first). `required` makes
+// WIDTH/HEIGHT/FIRST/LAST mandatory -- true for the main text font, false
+// for an icon font, which only ever supplies WIDE_FONT. Passing
+// MP_OBJ_NULL just releases `out`.
+void vt_font_compile(vt_font_t *out, mp_obj_t font, bool required);
+void vt_font_release(vt_font_t *font);
+
+// (Re)allocates `cache` for cells of `width` x `height` pixels and drops
+// every tile. Zero width/height just frees it. Hit/miss counters survive.
+// The storage is shared by every VT (only one draws at a time) and reused
+// across VT() calls rather than allocated per object.
+void vt_glyph_cache_reset(vt_glyph_cache_t *cache, uint8_t width,
+                          uint8_t height);
+
+// Drops every cached glyph; the buffer itself is kept.
+void vt_hot_glyphs_reset(vt_hot_glyphs_t *hot);
+
 void draw_bar_ansi(const char *text, size_t len, int bar_type);
 void repaint_bars(void);
 void fill_bottom_margin(void);
+void vscroll_reset(void);
 
 // Result of render_row_rgb565() -- see fb.c. x_start/y_start/x_end/
 // f_height are the same coordinates xdrawline() would pass to
@@ -101,5 +311,20 @@ typedef struct {
 // pull the same pixels a redraw would produce.
 row_render_t render_row_rgb565(Line ln, int _x1, int _y1, int _x2,
                                uint16_t *out_buf, size_t out_cap);
+// The byte-swapped RGB565 value render_row_rgb565() uses for a st color.
+uint16_t map_st_color(int number);
+
+// Cell-level counterparts of render_row_rgb565(), for remote viewers that
+// rasterize glyphs themselves (webvncd.py's cell mode). encode_row_cells()
+// serializes term.col cells of ln -- see fb.c for the byte format -- and
+// returns the bytes written, 0 if cap is under ROW_CELLS_MAX(term.col).
+// render_glyph_mask() renders one glyph as a 1bpp ink mask, exactly as
+// render_row_rgb565() would pick and draw it; 0 if there's no font or the
+// buffer is too small.
+bool cursor_visible(void);
+#define ROW_CELLS_MAX(cols) ((size_t)(cols) * 11 + 7)
+size_t encode_row_cells(Line ln, uint8_t *out, size_t cap);
+size_t render_glyph_mask(Rune u, bool bold, bool wide, uint8_t *out,
+                         size_t cap);
 
 #endif /* FB_H */
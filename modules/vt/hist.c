@@ -0,0 +1,359 @@
+/* See LICENSE for license details. */
+
+// Scrollback storage for st.c. Lines that scroll off the top are
+// compressed into fixed-size pages (PSRAM where there is any) instead of
+// each keeping a full-width Glyph row around, and only decoded again --
+// into a small cache of term.row lines -- when TLINE() asks for one,
+// i.e. when kscrollup() has actually moved the view into history.
+//
+// A compressed line is a run of opcodes, each followed by its operands:
+//
+//   HIST_ATTR                 mode (2 bytes), fg, bg (4 bytes each) --
+//                             applies to every cell that follows;
+//                             truecolors are stored as themselves, not
+//                             as tcolorpack() slots, which get reused
+//   HIST_LITERAL | (n - 1)    n cells, one LEB128 rune each
+//   HIST_REPEAT  | (n - 1)    n copies of the one LEB128 rune after it
+//
+// n is 1..64. A plain shell line is then one HIST_ATTR, one or two
+// literals and a repeat for the trailing blanks -- ~20-60 bytes instead
+// of term.col * sizeof(Glyph).
+//
+// Lines are appended to the current page in order and pages are reused
+// in order, so the lines in the oldest page are always the oldest lines:
+// when a page is needed and none are free, everything in the oldest one
+// is dropped with it. hist.size separately caps the number of lines.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+
+#include "st.h"
+
+#define HIST_LITERAL 0x00
+#define HIST_REPEAT 0x40
+#define HIST_ATTR 0x80
+#define HIST_RUN_MAX 64
+
+#define HISTPAGE 4096    /* bytes per page; a line never spans two */
+#define HISTLINEBYTES 64 /* budgeted average per line, see thistsetup() */
+
+static void *hist_alloc(size_t len) {
+  void *p = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return p ? p : heap_caps_malloc(len, MALLOC_CAP_8BIT);
+}
+
+static void thistcachefree(void) {
+  THist *h = &term.hist;
+  int i;
+
+  if (h->cache) {
+    for (i = 0; i < h->cacherows; i++)
+      free(h->cache[i]);
+    free(h->cache);
+  }
+  free(h->cachetag);
+  h->cache = NULL;
+  h->cachetag = NULL;
+  h->cacherows = h->cachecols = 0;
+}
+
+/*
+ * Forgets what the cache holds, so every line is decoded afresh -- with
+ * fresh tcolorpack() slots -- the next time it's asked for. See
+ * tcolorreclaim().
+ */
+void thistcachedrop(void) {
+  THist *h = &term.hist;
+
+  if (h->cachetag)
+    memset(h->cachetag, 0, h->cacherows * sizeof(*h->cachetag));
+}
+
+static void thistfree(void) {
+  THist *h = &term.hist;
+  int i;
+
+  if (h->pages) {
+    for (i = 0; i < h->npages; i++) {
+      if (h->pages[i])
+        heap_caps_free(h->pages[i]);
+    }
+    free(h->pages);
+  }
+  if (h->lines)
+    heap_caps_free(h->lines);
+  thistcachefree();
+  memset(h, 0, sizeof(*h));
+}
+
+/*
+ * (Re)configures the scrollback for `lines` lines, dropping anything
+ * already in it. The page budget is sized for an average line, not the
+ * worst case: a screenful of heavily colored lines just keeps fewer of
+ * them. Returns 0 if the line index couldn't be allocated, in which case
+ * there's no scrollback at all.
+ */
+int thistsetup(int lines) {
+  THist *h = &term.hist;
+
+  thistfree();
+  term.scr = 0;
+  if (lines <= 0)
+    return 1;
+
+  h->lines = hist_alloc(lines * sizeof(*h->lines));
+  h->npages = SMAX(2, DIVCEIL(lines * HISTLINEBYTES, HISTPAGE));
+  h->pages = calloc(h->npages, sizeof(*h->pages));
+  if (!h->lines || !h->pages) {
+    thistfree();
+    return 0;
+  }
+  h->size = lines;
+  h->headpage = -1;
+  return 1;
+}
+
+static size_t leb_put(uint8_t *p, uint32_t v) {
+  size_t n = 0;
+
+  while (v >= 0x80) {
+    p[n++] = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  p[n++] = v;
+  return n;
+}
+
+static const uint8_t *leb_get(const uint8_t *p, const uint8_t *end,
+                              uint32_t *v) {
+  uint32_t r = 0;
+  int shift = 0;
+
+  while (p < end) {
+    uint8_t b = *p++;
+    r |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      break;
+    shift += 7;
+  }
+  *v = r;
+  return p;
+}
+
+static size_t put32(uint8_t *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+  return 4;
+}
+
+static uint32_t get32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* cells from gp[i] on that repeat gp[i]'s rune and attributes */
+static int runlen(const Glyph *gp, int i, int len) {
+  int n = 1;
+
+  while (i + n < len && n < HIST_RUN_MAX && gp[i + n].u == gp[i].u &&
+         !ATTRCMP(gp[i + n], gp[i]))
+    n++;
+  return n;
+}
+
+/*
+ * Worst case per cell is an attribute change, an opcode and a 3-byte
+ * rune; stop early rather than overrun `cap` -- the decoder pads a short
+ * line out with blanks.
+ */
+static size_t thistencode(const Glyph *gp, int len, uint8_t *out,
+                          size_t cap) {
+  size_t n = 0;
+  int i = 0, have_attr = 0, j, cnt;
+  Glyph attr = {0};
+
+  while (i < len) {
+    if (!have_attr || ATTRCMP(gp[i], attr)) {
+      if (n + 11 > cap)
+        break;
+      attr = gp[i];
+      have_attr = 1;
+      out[n++] = HIST_ATTR;
+      out[n++] = attr.mode;
+      out[n++] = attr.mode >> 8;
+      n += put32(out + n, tcolorunpack(attr.fg));
+      n += put32(out + n, tcolorunpack(attr.bg));
+    }
+
+    cnt = runlen(gp, i, len);
+    if (cnt >= 3) {
+      if (n + 1 + 5 > cap)
+        break;
+      out[n++] = HIST_REPEAT | (cnt - 1);
+      n += leb_put(out + n, gp[i].u);
+      i += cnt;
+      continue;
+    }
+
+    /* literal: up to the next attribute change or worthwhile repeat */
+    for (cnt = 0; i + cnt < len && cnt < HIST_RUN_MAX; cnt++) {
+      if (ATTRCMP(gp[i + cnt], attr) ||
+          (cnt > 0 && runlen(gp, i + cnt, len) >= 3))
+        break;
+    }
+    if (n + 1 + cnt * 5 > cap)
+      break;
+    out[n++] = HIST_LITERAL | (cnt - 1);
+    for (j = 0; j < cnt; j++)
+      n += leb_put(out + n, gp[i + j].u);
+    i += cnt;
+  }
+
+  return n;
+}
+
+static void thistdecode(const uint8_t *p, size_t len, Line dst, int col) {
+  const uint8_t *end = p + len;
+  Glyph g = {.fg = defaultfg, .bg = defaultbg};
+  uint32_t u;
+  int x = 0, cnt;
+
+  while (p < end && x < col) {
+    uint8_t op = *p++;
+
+    if (op == HIST_ATTR) {
+      if (end - p < 10)
+        break;
+      g.mode = p[0] | (p[1] << 8);
+      g.fg = tcolorpack(get32(p + 2));
+      g.bg = tcolorpack(get32(p + 6));
+      p += 10;
+      continue;
+    }
+
+    cnt = (op & (HIST_RUN_MAX - 1)) + 1;
+    if (op & HIST_REPEAT) {
+      p = leb_get(p, end, &u);
+      g.u = u;
+      while (cnt-- && x < col)
+        dst[x++] = g;
+    } else {
+      while (cnt-- && x < col && p < end) {
+        p = leb_get(p, end, &u);
+        g.u = u;
+        dst[x++] = g;
+      }
+    }
+  }
+
+  /* the line was wider than the terminal is now: don't split a pair */
+  if (x == col && col > 0 && (dst[col - 1].mode & ATTR_WIDE)) {
+    dst[col - 1].u = ' ';
+    dst[col - 1].mode &= ~ATTR_WIDE;
+  }
+  for (; x < col; x++)
+    dst[x] = (Glyph){.u = ' ', .fg = defaultfg, .bg = defaultbg};
+}
+
+/* frees the oldest page for reuse, dropping every line stored in it */
+static void thistrecycle(int page) {
+  THist *h = &term.hist;
+
+  while (h->count > 0 &&
+         h->lines[(h->seq - h->count) % h->size].page == page)
+    h->count--;
+}
+
+/*
+ * Appends one line as the newest history entry. Called by tscrollup()
+ * for every line that scrolls off the top.
+ */
+void thistpush(const Glyph *gp, int len) {
+  static uint8_t buf[HISTPAGE];
+  THist *h = &term.hist;
+  THistLine *l;
+  size_t n;
+  int next;
+
+  if (h->size <= 0)
+    return;
+
+  n = thistencode(gp, len, buf, sizeof(buf));
+
+  if (h->headpage < 0 || h->headoff + n > HISTPAGE) {
+    next = (h->headpage + 1) % h->npages;
+    thistrecycle(next);
+    if (!h->pages[next] && !(h->pages[next] = hist_alloc(HISTPAGE))) {
+      /* out of memory: keep going with the pages we already have */
+      if (h->headpage < 0)
+        return;
+      next = (h->headpage + 1) % h->npages;
+      while (!h->pages[next])
+        next = (next + 1) % h->npages;
+      thistrecycle(next);
+    }
+    h->headpage = next;
+    h->headoff = 0;
+  }
+
+  if (h->count == h->size)
+    h->count--;
+
+  l = &h->lines[h->seq % h->size];
+  l->page = h->headpage;
+  l->off = h->headoff;
+  l->len = n;
+  memcpy(h->pages[h->headpage] + h->headoff, buf, n);
+  h->headoff += n;
+  h->seq++;
+  h->count++;
+
+  if (term.scr > h->count)
+    term.scr = h->count;
+}
+
+/*
+ * The age'th newest history line (1 = the one that scrolled off last),
+ * decoded at the current term.col. The result lives in a cache slot
+ * chosen by line number mod term.row, so any term.row consecutive lines
+ * -- one screenful, which is all TLINE() ever needs at once -- can be
+ * held simultaneously. It is only valid until the next call for a line
+ * term.row further away, or the next resize.
+ */
+Line thistline(int age) {
+  THist *h = &term.hist;
+  uint32_t seq;
+  int i, slot;
+
+  if (h->cacherows != term.row || h->cachecols != term.col) {
+    thistcachefree();
+    h->cache = xmalloc(term.row * sizeof(Line));
+    h->cachetag = calloc(term.row, sizeof(*h->cachetag));
+    if (!h->cachetag)
+      die("calloc: out of memory\n");
+    for (i = 0; i < term.row; i++)
+      h->cache[i] = xmalloc(term.col * sizeof(Glyph));
+    h->cacherows = term.row;
+    h->cachecols = term.col;
+  }
+
+  seq = h->seq - age;
+  slot = seq % term.row;
+  if (h->cachetag[slot] == seq + 1)
+    return h->cache[slot];
+
+  if (age < 1 || age > h->count) {
+    /* not (or no longer) in history -- blank, and don't cache it */
+    h->cachetag[slot] = 0;
+    thistdecode(NULL, 0, h->cache[slot], term.col);
+  } else {
+    THistLine *l = &h->lines[seq % h->size];
+    h->cachetag[slot] = seq + 1;
+    thistdecode(h->pages[l->page] + l->off, l->len, h->cache[slot],
+                term.col);
+  }
+  return h->cache[slot];
+}
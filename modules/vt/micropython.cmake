@@ -5,6 +5,8 @@ target_sources(usermod_term INTERFACE
     ${CMAKE_CURRENT_LIST_DIR}/st.c
     ${CMAKE_CURRENT_LIST_DIR}/fb.c
     ${CMAKE_CURRENT_LIST_DIR}/vt_module.c
+    ${CMAKE_CURRENT_LIST_DIR}/hist.c
+    ${CMAKE_CURRENT_LIST_DIR}/rfb.c
 )
 
 # Add the include directory so headers are found
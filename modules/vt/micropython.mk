@@ -4,6 +4,8 @@ TERM_MOD_DIR := $(USERMOD_DIR)
 SRC_USERMOD += $(TERM_MOD_DIR)/vt_module.c
 SRC_USERMOD += $(TERM_MOD_DIR)/st.c
 SRC_USERMOD += $(TERM_MOD_DIR)/fb.c
+SRC_USERMOD += $(TERM_MOD_DIR)/hist.c
+SRC_USERMOD += $(TERM_MOD_DIR)/rfb.c
 
 # We can add our module folder to include paths if needed
 # This is not actually needed in this example.
@@ -0,0 +1,522 @@
+/*
+ * rfb.c
+ *
+ * RFB (VNC) rectangle encoder for vncd.py. Takes the big-endian RGB565
+ * rows VT.render_row() produces (fb.c's render_row_rgb565()) and writes
+ * complete FramebufferUpdate rectangles -- header and pixel data -- into
+ * a caller-supplied buffer, already in the client's pixel format.
+ *
+ * Pixel format conversion is three small tables (one per RGB565 channel,
+ * each entry already scaled to the client's max and shifted into place),
+ * OR'd together per pixel -- the channels never overlap in a true-color
+ * format, so that's exact, and it replaces vncd.py's per-pixel Python loop.
+ *
+ * Encodings, best first: ZRLE (16), TRLE (15), Raw (0). TRLE and ZRLE
+ * share the tile coder below -- solid, packed palette, plain RLE and
+ * palette RLE, whichever is smallest per tile -- ZRLE just uses 64x64
+ * tiles instead of 16x16 and runs the result through one deflate stream
+ * that lives as long as the connection (miniz's tdefl, vendored under
+ * st7789/png/). A terminal row is mostly long runs of one background
+ * color with a handful of foreground colors on top, which is the best
+ * case for all of that.
+ *
+ * One Encoder per client connection: the ZRLE stream carries state from
+ * one rectangle to the next, and the client's inflater has to see every
+ * byte of it in order.
+ */
+
+#include <string.h>
+
+#include "py/runtime.h"
+
+#include "png/miniz.h"
+
+#define RFB_ENC_RAW 0
+#define RFB_ENC_TRLE 15
+#define RFB_ENC_ZRLE 16
+
+#define RFB_TRLE_TILE 16
+#define RFB_ZRLE_TILE 64
+#define RFB_PALETTE_MAX 16 /* packed palettes stop at 16 colors */
+
+#define RFB_SUB_RAW 0
+#define RFB_SUB_SOLID 1
+#define RFB_SUB_RLE 128
+
+// Greedy parsing with a shallow search: the tiles are already run-length
+// coded, deflate only has to find the repeats between rows and glyphs.
+#define RFB_TDEFL_FLAGS (TDEFL_WRITE_ZLIB_HEADER | TDEFL_GREEDY_PARSING_FLAG | 16)
+
+typedef struct _rfb_encoder_obj_t {
+  mp_obj_base_t base;
+  uint32_t rtab[32]; // RGB565 channel value -> client pixel bits
+  uint32_t gtab[64];
+  uint32_t btab[32];
+  uint8_t bypp;       // bytes per pixel on the wire
+  uint8_t big_endian;
+  uint8_t cbypp;      // bytes per CPIXEL (TRLE/ZRLE), see rfb_cpixel_layout()
+  uint8_t coff;       // where the CPIXEL bytes sit within a full pixel
+  int encoding;
+  tdefl_compressor *zs; // ZRLE's stream, allocated on first use
+  uint8_t *zbuf;        // ZRLE tile data before deflate
+  size_t zbuf_len;
+} rfb_encoder_obj_t;
+
+extern const mp_obj_type_t rfb_Encoder_type;
+
+// 5/6-bit channel -> 8 bits by bit replication, then onto the client's
+// own 0..max range -- the same math vncd.py's Python converter used.
+static void rfb_build_table(uint32_t *tab, int bits, uint32_t max, int shift) {
+  int n = 1 << bits;
+  for (int i = 0; i < n; i++) {
+    uint32_t v8 = (bits == 5) ? ((i << 3) | (i >> 2)) : ((i << 2) | (i >> 4));
+    tab[i] = ((v8 * max) / 255) << shift;
+  }
+}
+
+// RFB's CPIXEL is a 32bpp pixel cut down to 3 bytes when the depth fits
+// in either the low or the high 24 bits; any other format sends pixels
+// whole.
+static void rfb_cpixel_layout(rfb_encoder_obj_t *self) {
+  uint32_t used = self->rtab[31] | self->gtab[63] | self->btab[31];
+
+  self->cbypp = self->bypp;
+  self->coff = 0;
+  if (self->bypp != 4)
+    return;
+  if (!(used & 0xFF000000)) {
+    self->cbypp = 3;
+    self->coff = self->big_endian ? 1 : 0;
+  } else if (!(used & 0x000000FF)) {
+    self->cbypp = 3;
+    self->coff = self->big_endian ? 0 : 1;
+  }
+}
+
+static inline uint32_t rfb_value(const rfb_encoder_obj_t *self, uint16_t c) {
+  return self->rtab[c >> 11] | self->gtab[(c >> 5) & 0x3F] |
+         self->btab[c & 0x1F];
+}
+
+static inline uint8_t *rfb_put_pixel(const rfb_encoder_obj_t *self,
+                                     uint8_t *out, uint16_t c) {
+  uint32_t v = rfb_value(self, c);
+  int n = self->bypp;
+
+  if (self->big_endian) {
+    for (int k = n - 1; k >= 0; k--, v >>= 8)
+      out[k] = v;
+  } else {
+    for (int k = 0; k < n; k++, v >>= 8)
+      out[k] = v;
+  }
+  return out + n;
+}
+
+static inline uint8_t *rfb_put_cpixel(const rfb_encoder_obj_t *self,
+                                      uint8_t *out, uint16_t c) {
+  uint8_t full[4];
+
+  if (self->cbypp == self->bypp)
+    return rfb_put_pixel(self, out, c);
+  rfb_put_pixel(self, full, c);
+  memcpy(out, full + self->coff, self->cbypp);
+  return out + self->cbypp;
+}
+
+static inline uint16_t rfb_src(const uint8_t *src, int stride, int x, int y) {
+  const uint8_t *p = src + y * stride + x * 2;
+  return (p[0] << 8) | p[1];
+}
+
+static inline size_t rfb_runlen_bytes(int run) { return (run - 1) / 255 + 1; }
+
+static inline uint8_t *rfb_put_runlen(uint8_t *out, int run) {
+  int n = run - 1;
+  while (n >= 255) {
+    *out++ = 255;
+    n -= 255;
+  }
+  *out++ = n;
+  return out;
+}
+
+static inline int rfb_palette_index(const uint16_t *pal, int npal,
+                                    uint16_t c) {
+  for (int i = 0; i < npal; i++) {
+    if (pal[i] == c)
+      return i;
+  }
+  return -1;
+}
+
+// One TRLE/ZRLE tile of tw x th pixels at src. Counts colors (up to
+// RFB_PALETTE_MAX) and runs in one pass, then emits whichever
+// subencoding comes out smallest. Returns the end of what it wrote,
+// never more than 1 + tw * th * cbypp bytes.
+static uint8_t *rfb_tile(const rfb_encoder_obj_t *self, const uint8_t *src,
+                         int stride, int tw, int th, uint8_t *out) {
+  uint16_t pal[RFB_PALETTE_MAX];
+  int npal = 0;
+  size_t runs = 0, rle_lens = 0, prle_lens = 0;
+  uint16_t cur = rfb_src(src, stride, 0, 0);
+  int run = 0;
+  const size_t cp = self->cbypp;
+
+  for (int y = 0; y < th; y++) {
+    for (int x = 0; x < tw; x++) {
+      uint16_t c = rfb_src(src, stride, x, y);
+      if (run > 0 && c == cur) {
+        run++;
+        continue;
+      }
+      if (run > 0) {
+        runs++;
+        rle_lens += rfb_runlen_bytes(run);
+        if (run > 1)
+          prle_lens += rfb_runlen_bytes(run);
+      }
+      cur = c;
+      run = 1;
+      if (npal <= RFB_PALETTE_MAX && rfb_palette_index(pal, npal, c) < 0) {
+        if (npal < RFB_PALETTE_MAX)
+          pal[npal] = c;
+        npal++;
+      }
+    }
+  }
+  runs++;
+  rle_lens += rfb_runlen_bytes(run);
+  if (run > 1)
+    prle_lens += rfb_runlen_bytes(run);
+
+  if (npal == 1) {
+    *out++ = RFB_SUB_SOLID;
+    return rfb_put_cpixel(self, out, pal[0]);
+  }
+
+  int sub = RFB_SUB_RAW;
+  size_t best = (size_t)tw * th * cp;
+  int bits = 0;
+
+  size_t rle = runs * cp + rle_lens;
+  if (rle < best) {
+    best = rle;
+    sub = RFB_SUB_RLE;
+  }
+  if (npal <= RFB_PALETTE_MAX) {
+    bits = (npal <= 2) ? 1 : (npal <= 4) ? 2 : 4;
+    size_t packed = npal * cp + (size_t)th * ((tw * bits + 7) / 8);
+    size_t prle = npal * cp + runs + prle_lens;
+    if (packed < best) {
+      best = packed;
+      sub = npal;
+    }
+    if (prle < best) {
+      best = prle;
+      sub = RFB_SUB_RLE + npal;
+    }
+  }
+
+  *out++ = sub;
+
+  if (sub == RFB_SUB_RAW) {
+    for (int y = 0; y < th; y++) {
+      for (int x = 0; x < tw; x++)
+        out = rfb_put_cpixel(self, out, rfb_src(src, stride, x, y));
+    }
+    return out;
+  }
+
+  if (sub != RFB_SUB_RLE) {
+    for (int i = 0; i < npal; i++)
+      out = rfb_put_cpixel(self, out, pal[i]);
+  }
+
+  if (sub < RFB_SUB_RLE) {
+    // packed palette: indices MSB first, every row padded to a byte
+    for (int y = 0; y < th; y++) {
+      int acc = 0, nbits = 0, last = 0;
+      uint16_t lastc = pal[0];
+      for (int x = 0; x < tw; x++) {
+        uint16_t c = rfb_src(src, stride, x, y);
+        if (c != lastc) {
+          last = rfb_palette_index(pal, npal, c);
+          lastc = c;
+        }
+        acc = (acc << bits) | last;
+        nbits += bits;
+        if (nbits == 8) {
+          *out++ = acc;
+          acc = nbits = 0;
+        }
+      }
+      if (nbits)
+        *out++ = acc << (8 - nbits);
+    }
+    return out;
+  }
+
+  // plain or palette RLE: runs carry on across rows within the tile
+  cur = rfb_src(src, stride, 0, 0);
+  run = 0;
+  for (int i = 0; i <= tw * th; i++) {
+    uint16_t c = 0;
+    if (i < tw * th) {
+      c = rfb_src(src, stride, i % tw, i / tw);
+      if (run > 0 && c == cur) {
+        run++;
+        continue;
+      }
+    }
+    if (run > 0) {
+      if (sub == RFB_SUB_RLE) {
+        out = rfb_put_cpixel(self, out, cur);
+        out = rfb_put_runlen(out, run);
+      } else if (run == 1) {
+        *out++ = rfb_palette_index(pal, npal, cur);
+      } else {
+        *out++ = 0x80 | rfb_palette_index(pal, npal, cur);
+        out = rfb_put_runlen(out, run);
+      }
+    }
+    cur = c;
+    run = 1;
+  }
+  return out;
+}
+
+static uint8_t *rfb_tiles(const rfb_encoder_obj_t *self, const uint8_t *src,
+                          int stride, int w, int h, int tile, uint8_t *out) {
+  for (int ty = 0; ty < h; ty += tile) {
+    int th = (h - ty < tile) ? h - ty : tile;
+    for (int tx = 0; tx < w; tx += tile) {
+      int tw = (w - tx < tile) ? w - tx : tile;
+      out = rfb_tile(self, src + ty * stride + tx * 2, stride, tw, th, out);
+    }
+  }
+  return out;
+}
+
+// Worst case for any encoding: every tile raw plus its subencoding byte,
+// full-size pixels, deflate's stored-block overhead, and the rectangle
+// header. Callers size their output buffer from this (max_size()).
+static size_t rfb_bound(int w, int h) {
+  size_t tiles = (size_t)((w + RFB_TRLE_TILE - 1) / RFB_TRLE_TILE) *
+                 ((h + RFB_TRLE_TILE - 1) / RFB_TRLE_TILE);
+  size_t data = (size_t)w * h * 4 + tiles;
+  return 12 + 4 + data + data / 64 + 64;
+}
+
+static void rfb_put16(uint8_t *p, uint16_t v) {
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+static void rfb_put32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static uint8_t *rfb_zrle(rfb_encoder_obj_t *self, const uint8_t *src,
+                         int stride, int w, int h, uint8_t *out,
+                         uint8_t *out_end) {
+  size_t need = (size_t)w * h * self->cbypp +
+                (size_t)((w + RFB_ZRLE_TILE - 1) / RFB_ZRLE_TILE) *
+                    ((h + RFB_ZRLE_TILE - 1) / RFB_ZRLE_TILE);
+  if (self->zbuf_len < need) {
+    self->zbuf = m_renew(uint8_t, self->zbuf, self->zbuf_len, need);
+    self->zbuf_len = need;
+  }
+
+  size_t in_len =
+      rfb_tiles(self, src, stride, w, h, RFB_ZRLE_TILE, self->zbuf) -
+      self->zbuf;
+  size_t in_size = in_len;
+  size_t out_size = out_end - (out + 4);
+  tdefl_status st = tdefl_compress(self->zs, self->zbuf, &in_size, out + 4,
+                                   &out_size, TDEFL_SYNC_FLUSH);
+
+  // A short buffer here would leave half a flush queued inside the
+  // stream, and the client can't recover from that -- rfb_bound() is
+  // generous enough that it never should.
+  if (st != TDEFL_STATUS_OKAY || in_size != in_len ||
+      self->zs->m_output_flush_remaining) {
+    mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("rfb: zlib failed"));
+  }
+  rfb_put32(out, out_size);
+  return out + 4 + out_size;
+}
+
+// Encoder() -- starts out Raw, in vncd.py's default 32bpp little-endian
+// BGRX format; set_pixel_format()/set_encodings() follow the client's.
+static mp_obj_t rfb_encoder_make_new(const mp_obj_type_t *type, size_t n_args,
+                                     size_t n_kw, const mp_obj_t *args) {
+  mp_arg_check_num(n_args, n_kw, 0, 0, false);
+
+  rfb_encoder_obj_t *self = mp_obj_malloc(rfb_encoder_obj_t, type);
+  self->bypp = 4;
+  self->big_endian = 0;
+  rfb_build_table(self->rtab, 5, 255, 16);
+  rfb_build_table(self->gtab, 6, 255, 8);
+  rfb_build_table(self->btab, 5, 255, 0);
+  rfb_cpixel_layout(self);
+  self->encoding = RFB_ENC_RAW;
+  self->zs = NULL;
+  self->zbuf = NULL;
+  self->zbuf_len = 0;
+  return MP_OBJ_FROM_PTR(self);
+}
+
+// enc.set_pixel_format(bpp, big_endian, red_max, green_max, blue_max,
+//                      red_shift, green_shift, blue_shift)
+// -- the same tuple vncd.py keeps as conn.current_format. True color only.
+static mp_obj_t rfb_encoder_set_pixel_format(size_t n_args,
+                                             const mp_obj_t *args) {
+  rfb_encoder_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+  mp_int_t bpp = mp_obj_get_int(args[1]);
+
+  if (bpp != 8 && bpp != 16 && bpp != 24 && bpp != 32) {
+    mp_raise_ValueError(MP_ERROR_TEXT("unsupported bpp"));
+  }
+  self->bypp = bpp / 8;
+  self->big_endian = mp_obj_is_true(args[2]);
+  rfb_build_table(self->rtab, 5, mp_obj_get_int(args[3]),
+                  mp_obj_get_int(args[6]));
+  rfb_build_table(self->gtab, 6, mp_obj_get_int(args[4]),
+                  mp_obj_get_int(args[7]));
+  rfb_build_table(self->btab, 5, mp_obj_get_int(args[5]),
+                  mp_obj_get_int(args[8]));
+  rfb_cpixel_layout(self);
+  return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(rfb_encoder_set_pixel_format_obj, 9,
+                                           9, rfb_encoder_set_pixel_format);
+
+// enc.set_encodings(list) -> int. Picks the best encoding out of the
+// client's SetEncodings list and returns it. ZRLE needs ~160 KB for its
+// deflate state; without that it settles for TRLE.
+static mp_obj_t rfb_encoder_set_encodings(mp_obj_t self_in, mp_obj_t list_in) {
+  rfb_encoder_obj_t *self = MP_OBJ_TO_PTR(self_in);
+  bool zrle = false, trle = false;
+
+  mp_obj_iter_buf_t iter_buf;
+  mp_obj_t iterable = mp_getiter(list_in, &iter_buf);
+  mp_obj_t item;
+  while ((item = mp_iternext(iterable)) != MP_OBJ_STOP_ITERATION) {
+    mp_int_t enc = mp_obj_get_int(item);
+    zrle |= (enc == RFB_ENC_ZRLE);
+    trle |= (enc == RFB_ENC_TRLE);
+  }
+
+  if (zrle && !self->zs) {
+    self->zs = m_malloc_maybe(sizeof(tdefl_compressor));
+    if (self->zs &&
+        tdefl_init(self->zs, NULL, NULL, RFB_TDEFL_FLAGS) != TDEFL_STATUS_OKAY) {
+      m_free(self->zs);
+      self->zs = NULL;
+    }
+  }
+
+  if (zrle && self->zs)
+    self->encoding = RFB_ENC_ZRLE;
+  else if (trle)
+    self->encoding = RFB_ENC_TRLE;
+  else
+    self->encoding = RFB_ENC_RAW;
+  return MP_OBJ_NEW_SMALL_INT(self->encoding);
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(rfb_encoder_set_encodings_obj,
+                                 rfb_encoder_set_encodings);
+
+// enc.max_size(w, h) -> bytes rect() may need for a w x h rectangle.
+static mp_obj_t rfb_encoder_max_size(mp_obj_t self_in, mp_obj_t w_in,
+                                     mp_obj_t h_in) {
+  return mp_obj_new_int(rfb_bound(mp_obj_get_int(w_in), mp_obj_get_int(h_in)));
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(rfb_encoder_max_size_obj,
+                                 rfb_encoder_max_size);
+
+// enc.rect(src, x, y, w, h, out) -> int bytes written. src is w x h
+// pixels of render_row() output; out gets one complete rectangle
+// (header included) and must be at least max_size(w, h) bytes.
+static mp_obj_t rfb_encoder_rect(size_t n_args, const mp_obj_t *args) {
+  rfb_encoder_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+  mp_int_t x = mp_obj_get_int(args[2]);
+  mp_int_t y = mp_obj_get_int(args[3]);
+  mp_int_t w = mp_obj_get_int(args[4]);
+  mp_int_t h = mp_obj_get_int(args[5]);
+
+  mp_buffer_info_t src, dst;
+  mp_get_buffer_raise(args[1], &src, MP_BUFFER_READ);
+  mp_get_buffer_raise(args[6], &dst, MP_BUFFER_WRITE);
+
+  if (x < 0 || y < 0 || w <= 0 || h <= 0 || w > 0xFFFF || h > 0xFFFF ||
+      src.len < (size_t)w * h * 2) {
+    mp_raise_ValueError(MP_ERROR_TEXT("bad rectangle"));
+  }
+  if (dst.len < rfb_bound(w, h)) {
+    mp_raise_ValueError(MP_ERROR_TEXT("output buffer too small"));
+  }
+
+  const uint8_t *in = src.buf;
+  uint8_t *out = dst.buf;
+  int stride = w * 2;
+
+  rfb_put16(out, x);
+  rfb_put16(out + 2, y);
+  rfb_put16(out + 4, w);
+  rfb_put16(out + 6, h);
+  rfb_put32(out + 8, self->encoding);
+  uint8_t *p = out + 12;
+
+  switch (self->encoding) {
+  case RFB_ENC_ZRLE:
+    p = rfb_zrle(self, in, stride, w, h, p, out + dst.len);
+    break;
+  case RFB_ENC_TRLE:
+    p = rfb_tiles(self, in, stride, w, h, RFB_TRLE_TILE, p);
+    break;
+  default:
+    for (mp_int_t i = 0; i < w * h; i++)
+      p = rfb_put_pixel(self, p, (in[2 * i] << 8) | in[2 * i + 1]);
+    break;
+  }
+
+  return mp_obj_new_int(p - out);
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(rfb_encoder_rect_obj, 7, 7,
+                                           rfb_encoder_rect);
+
+static const mp_rom_map_elem_t rfb_encoder_locals_dict_table[] = {
+    {MP_ROM_QSTR(MP_QSTR_set_pixel_format),
+     MP_ROM_PTR(&rfb_encoder_set_pixel_format_obj)},
+    {MP_ROM_QSTR(MP_QSTR_set_encodings),
+     MP_ROM_PTR(&rfb_encoder_set_encodings_obj)},
+    {MP_ROM_QSTR(MP_QSTR_max_size), MP_ROM_PTR(&rfb_encoder_max_size_obj)},
+    {MP_ROM_QSTR(MP_QSTR_rect), MP_ROM_PTR(&rfb_encoder_rect_obj)},
+};
+static MP_DEFINE_CONST_DICT(rfb_encoder_locals_dict,
+                            rfb_encoder_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(rfb_Encoder_type, MP_QSTR_Encoder, MP_TYPE_FLAG_NONE,
+                         make_new, rfb_encoder_make_new, locals_dict,
+                         &rfb_encoder_locals_dict);
+
+static const mp_rom_map_elem_t rfb_module_globals_table[] = {
+    {MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_rfb)},
+    {MP_ROM_QSTR(MP_QSTR_Encoder), MP_ROM_PTR(&rfb_Encoder_type)},
+    {MP_ROM_QSTR(MP_QSTR_RAW), MP_ROM_INT(RFB_ENC_RAW)},
+    {MP_ROM_QSTR(MP_QSTR_TRLE), MP_ROM_INT(RFB_ENC_TRLE)},
+    {MP_ROM_QSTR(MP_QSTR_ZRLE), MP_ROM_INT(RFB_ENC_ZRLE)},
+};
+static MP_DEFINE_CONST_DICT(rfb_module_globals, rfb_module_globals_table);
+
+const mp_obj_module_t rfb_user_cmodule = {
+    .base = {&mp_type_module},
+    .globals = (mp_obj_dict_t *)&rfb_module_globals,
+};
+
+MP_REGISTER_MODULE(MP_QSTR_rfb, rfb_user_cmodule);
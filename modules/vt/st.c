@@ -51,20 +51,28 @@ void tputc(Rune);
 static void treset(void);
 static void tscrollup(int, int, int);
 static void tscrolldown(int, int, int);
+static int tscrolldirt(int, int);
 static void tsetattr(const int *, int);
+static int tattrapply(Glyph *, const int *, int);
 static void tsetchar(Rune, const Glyph *, int, int);
 static void tsetdirt(int, int);
 static void tsetscroll(int, int);
 static void tswapscreen(void);
 static void tsetmode(int, int, const int *, int);
 int twrite(const char *, int, int);
-static void tfulldirt(void);
+static void tsetdirtspan(int, int, int);
+static void tshadowscroll(int);
 static void tcontrolcode(uchar);
 static void tdectest(char);
 static void tdefutf8(char);
 static int32_t tdefcolor(const int *, int *, int);
 static void tdeftran(char);
 static void tstrsequence(uchar);
+#if VT_PACKED_GLYPH
+static void tcolorforget(void);
+#else
+#define tcolorforget()
+#endif
 
 static void drawregion(int, int, int, int);
 
@@ -72,12 +80,7 @@ static void selnormalize(void);
 static void selscroll(int, int);
 static void selsnap(int *, int *, int);
 
-// Not static -- draw_bar_ansi() (fb.c) needs this too, see st.h. Was
-// internal-linkage-only, which happened to never matter until the status
-// bar's own text started containing real multi-byte UTF-8 (icons):
-// draw_bar_ansi() was feeding tputc() one raw byte at a time instead of
-// decoding first, silently "working" only because every byte of plain
-// ASCII text is already its own valid codepoint.
+// Not static -- declared in st.h for decoding UTF-8 outside st.c.
 size_t utf8decode(const char *, Rune *, size_t);
 static Rune utf8decodebyte(char, size_t *);
 static char utf8encodebyte(Rune, size_t);
@@ -93,10 +96,14 @@ unsigned int defaultfg = 7; /* Usually white/light gray */
 unsigned int defaultbg = 0; /* Usually black */
 
 /* Globals */
-Term term;
-static Selection sel;
-CSIEscape csiescseq;
-STREscape strescseq;
+static Term term0;
+Term *tcur = &term0;   /* see st.h */
+Term *tfront = &term0; /* the console on screen */
+
+/* per-terminal state that st keeps as globals, see Term */
+#define sel (term.sel)
+#define csiescseq (term.csiescseq)
+#define strescseq (term.strescseq)
 static int iofd = 1;
 static int cmdfd;
 
@@ -474,8 +481,18 @@ void selclear(void) {
   tsetdirt(sel.nb.y, sel.ne.y);
 }
 
+/*
+ * Where die() unwinds to instead of raising, while non-NULL. For callers
+ * with no MicroPython context to raise into -- vt_module.c's drain task
+ * runs twrite() on a plain FreeRTOS task -- and set only under the lock
+ * that serializes every caller of the t*() functions.
+ */
+jmp_buf *tdiejmp;
+
 void die(const char *errstr, ...) {
   va_list ap;
+  if (tdiejmp)
+    longjmp(*tdiejmp, 1);
   va_start(ap, errstr);
   mp_raise_msg_varg(&mp_type_RuntimeError, MP_ERROR_TEXT(errstr), ap);
   va_end(ap);
@@ -505,13 +522,16 @@ size_t ttyread(void) {
   }
 }
 
-/* Defined in modules/tdeck_kvm/tdeck_kvm.c - pushes bytes into the KVM input
- * ring buffer that kvm_read() drains before the hardware keyboard. */
-extern void internal_inject_n(const char *data, size_t len);
-
 void ttywrite(const char *s, size_t n, int may_echo) {
   Arg arg = (Arg){.i = term.scr};
 
+  /*
+   * The keyboard belongs to the console on screen: a reply from one in
+   * the background would land in the foreground app's input.
+   */
+  if (tcur != tfront)
+    return;
+
   kscrolldown(&arg);
 
   if (may_echo && IS_SET(MODE_ECHO))
@@ -520,16 +540,17 @@ void ttywrite(const char *s, size_t n, int may_echo) {
   /*
    * This embedded port has no pty: cmdfd is never opened (no ttynew/forkpty).
    * Terminal replies (Device Attributes, DSR/CPR cursor reports, OSC color
-   * queries) must reach whatever drives the terminal, so route them into the
-   * KVM input queue - vi and telnet both read their input from KVM and so
-   * receive the reply exactly as they would from a real tty.
+   * queries) must reach whatever drives the terminal, so xreply()
+   * (vt_module.c) routes them into the KVM input queue - vi and telnet both
+   * read their input from KVM and so receive the reply exactly as they
+   * would from a real tty.
    *
    * The original ttywriteraw()/pselect()/ttyread() path is intentionally not
    * used: writing to the unopened cmdfd made ttywriteraw() spin forever in
    * pselect(), starving the MicroPython task and triggering the task watchdog
    * (WDT_RESET) whenever an app queried the terminal.
    */
-  internal_inject_n(s, n);
+  xreply(s, n);
 }
 
 void ttywriteraw(const char *s, size_t n) {
@@ -614,7 +635,38 @@ void tsetdirt(int top, int bot) {
   LIMIT(bot, 0, term.row - 1);
 
   for (i = top; i <= bot; i++)
-    term.dirty[i] = 1;
+    tsetdirtspan(i, 0, term.col - 1);
+}
+
+/*
+ * Marks columns x1..x2 (inclusive) of line y as damaged, widening
+ * whatever span the line already had. drawregion() only repaints
+ * term.dirtyx1[y]..term.dirtyx2[y] of a dirty line, so a keystroke or a
+ * cursor move costs a cell or two on the wire instead of a whole row.
+ * Anything that changes a line without going through here must call
+ * tsetdirt() for it instead.
+ */
+void tsetdirtspan(int y, int x1, int x2) {
+  if (!BETWEEN(y, 0, term.row - 1) || term.col <= 0)
+    return;
+
+  LIMIT(x1, 0, term.col - 1);
+  LIMIT(x2, 0, term.col - 1);
+
+  term.rowgen[y] = ++term.gen;
+  /* the first damage since draw() on the console on screen wakes it */
+  if (!term.damaged && tcur == tfront) {
+    term.damaged = 1;
+    xdamage();
+  }
+  if (!term.dirty[y]) {
+    term.dirty[y] = 1;
+    term.dirtyx1[y] = x1;
+    term.dirtyx2[y] = x2;
+  } else {
+    term.dirtyx1[y] = SMIN(term.dirtyx1[y], x1);
+    term.dirtyx2[y] = SMAX(term.dirtyx2[y], x2);
+  }
 }
 
 void tsetdirtattr(int attr) {
@@ -632,8 +684,29 @@ void tsetdirtattr(int attr) {
 
 void tfulldirt(void) { tsetdirt(0, term.row - 1); }
 
+/*
+ * Stamps lines top..bot with a new change generation without making them
+ * dirty. term.dirty[] only tracks what the LCD still has to repaint;
+ * term.rowgen[] tracks what changed on screen, for consumers that keep
+ * their own copy of it (VT.changed_since()). The two differ after a
+ * hardware scroll: the panel moved every row itself, but everyone else
+ * has to resend them all.
+ */
+void tgenbump(int top, int bot) {
+  int i;
+
+  if (term.row <= 0)
+    return;
+
+  LIMIT(top, 0, term.row - 1);
+  LIMIT(bot, 0, term.row - 1);
+
+  for (i = top; i <= bot; i++)
+    term.rowgen[i] = ++term.gen;
+}
+
 void tcursor(int mode) {
-  static TCursor c[2];
+  TCursor *c = term.savedc;
   int alt = IS_SET(MODE_ALTSCREEN);
 
   if (mode == CURSOR_SAVE) {
@@ -667,15 +740,49 @@ void treset(void) {
     tclearregion(0, 0, term.col - 1, term.row - 1);
     tswapscreen();
   }
+  tcolorforget();
 }
 
 void tnew(int col, int row) {
+  /* keep counting: a consumer's token must never look newer than now */
+  uint32_t gen = term.gen;
+
   term = (Term){.c = {.attr = {.fg = defaultfg, .bg = defaultbg}}};
+  term.gen = gen;
   term.top_offset = 0;
+  term.wmode = MODE_VISIBLE;
+  selinit(); /* sel.ob.x = -1, or tputrun() never takes its fast path */
   tresize(col, row);
   treset();
 }
 
+/*
+ * Releases everything tnew()/tresize() and the parser allocated for
+ * `term`, scrollback included, leaving it as tnew() expects to find it.
+ */
+void tfree(void) {
+  uint32_t gen = term.gen;
+  int i;
+
+  thistsetup(0);
+  for (i = 0; i < term.row; i++) {
+    free(term.line[i]);
+    free(term.alt[i]);
+    free(term.shadow[i]);
+  }
+  free(term.line);
+  free(term.alt);
+  free(term.shadow);
+  free(term.dirty);
+  free(term.dirtyx1);
+  free(term.dirtyx2);
+  free(term.rowgen);
+  free(term.tabs);
+  free(strescseq.buf);
+  memset(&term, 0, sizeof(term));
+  term.gen = gen;
+}
+
 void tswapscreen(void) {
   Line *tmp = term.line;
 
@@ -703,15 +810,11 @@ void kscrolldown(const Arg *a) {
 
 void kscrollup(const Arg *a) {
   int n = a->i;
-  static int history_is_full = 0;
 
   if (n < 0)
     n = term.row + n;
 
-  if (term.histi == HISTSIZE - 1)
-    history_is_full = 1;
-
-  int max_scroll = history_is_full ? HISTSIZE : term.histi;
+  int max_scroll = term.hist.count;
 
   if (term.scr < max_scroll) {
     if (term.scr + n > max_scroll) {
@@ -724,21 +827,99 @@ void kscrollup(const Arg *a) {
   }
 }
 
+/*
+ * Full-screen scrolls can be handed to the frontend (xscroll(), e.g. the
+ * panel's own vertical scroll) instead of repainting every row. If it
+ * takes it, rows that were already clean on screen stay clean -- their
+ * pixels moved with them -- so the dirty flags just shift along with
+ * the lines, and only the rows the scroll exposes are repainted. n is in
+ * the tscrolldown() direction: positive moves content down. Returns 0 if
+ * the caller should dirty the whole region as usual.
+ */
+int tscrolldirt(int orig, int n) {
+  int i;
+
+  if (n == 0 || orig != 0 || term.bot != term.row - 1 || term.scr != 0)
+    return 0;
+  if (!xscroll(-n))
+    return 0;
+
+  /* the cursor last drawn at ocx/ocy moved with its line; erase it there */
+  term.ocy += n;
+  tsetdirtspan(term.ocy, term.ocx, term.ocx);
+  tshadowscroll(n);
+  tgenbump(0, term.row - 1);
+
+  if (n > 0) {
+    for (i = term.row - 1; i >= n; i--) {
+      term.dirty[i] = term.dirty[i - n];
+      term.dirtyx1[i] = term.dirtyx1[i - n];
+      term.dirtyx2[i] = term.dirtyx2[i - n];
+    }
+    memset(term.dirty, 0, n * sizeof(*term.dirty));
+    tsetdirt(0, n - 1);
+  } else {
+    n = -n;
+    for (i = 0; i < term.row - n; i++) {
+      term.dirty[i] = term.dirty[i + n];
+      term.dirtyx1[i] = term.dirtyx1[i + n];
+      term.dirtyx2[i] = term.dirtyx2[i + n];
+    }
+    memset(term.dirty + term.row - n, 0, n * sizeof(*term.dirty));
+    tsetdirt(term.row - n, term.row - 1);
+  }
+
+  return 1;
+}
+
+/*
+ * The panel moved its rows, so the record of what each one shows has to
+ * move too. The rows a scroll exposes wrap around from the other edge --
+ * in GRAM as well as here -- so they still describe exactly what's there.
+ */
+void tshadowscroll(int n) {
+  Line temp;
+
+  for (; n > 0; n--) {
+    temp = term.shadow[term.row - 1];
+    memmove(term.shadow + 1, term.shadow, (term.row - 1) * sizeof(Line));
+    term.shadow[0] = temp;
+  }
+  for (; n < 0; n++) {
+    temp = term.shadow[0];
+    memmove(term.shadow, term.shadow + 1, (term.row - 1) * sizeof(Line));
+    term.shadow[term.row - 1] = temp;
+  }
+}
+
+/*
+ * Forgets what the display shows, so the next draw() repaints every
+ * cell. For anything that changes pixels without changing glyphs: a new
+ * font, a moved text area, or the panel having been drawn over.
+ */
+void tfullredraw(void) {
+  int i;
+
+  /* no real Glyph has an all-ones u, so nothing compares equal */
+  for (i = 0; i < term.row; i++)
+    memset(term.shadow[i], 0xff, term.col * sizeof(Glyph));
+  tfulldirt();
+}
+
+/*
+ * copyhist is accepted for symmetry with tscrollup() but, as in xterm,
+ * reverse scrolling never pulls lines back out of the scrollback -- the
+ * application repaints whatever it reveals at the top itself.
+ */
 void tscrolldown(int orig, int n, int copyhist) {
   int i;
   Line temp;
 
   LIMIT(n, 0, term.bot - orig + 1);
 
-  if (copyhist) {
-    term.histi = (term.histi - 1 + HISTSIZE) % HISTSIZE;
-    temp = term.hist[term.histi];
-    term.hist[term.histi] = term.line[term.bot];
-    term.line[term.bot] = temp;
-  }
-
-  tsetdirt(orig, term.bot - n);
   tclearregion(0, term.bot - n + 1, term.col - 1, term.bot);
+  if (!tscrolldirt(orig, n))
+    tsetdirt(orig, term.bot - n);
 
   for (i = term.bot; i >= orig + n; i--) {
     temp = term.line[i];
@@ -757,17 +938,17 @@ void tscrollup(int orig, int n, int copyhist) {
   LIMIT(n, 0, term.bot - orig + 1);
 
   if (copyhist) {
-    term.histi = (term.histi + 1) % HISTSIZE;
-    temp = term.hist[term.histi];
-    term.hist[term.histi] = term.line[orig];
-    term.line[orig] = temp;
+    for (i = orig; i < orig + n; i++)
+      thistpush(term.line[i], term.col);
   }
 
-  if (term.scr > 0 && term.scr < HISTSIZE)
-    term.scr = SMIN(term.scr + n, HISTSIZE - 1);
+  /* keep a scrolled-back view on the same lines; thistpush() clamps */
+  if (term.scr > 0 && copyhist)
+    term.scr = SMIN(term.scr + n, term.hist.count);
 
   tclearregion(0, orig, term.col - 1, orig + n - 1);
-  tsetdirt(orig + n, term.bot);
+  if (!tscrolldirt(orig, -n))
+    tsetdirt(orig + n, term.bot);
 
   for (i = orig; i <= term.bot - n; i++) {
     temp = term.line[i];
@@ -845,7 +1026,7 @@ void tmoveato(int x, int y) {
 }
 
 void tmoveto(int x, int y) {
-  term.dirty[term.c.y] = 1;
+  tsetdirtspan(term.c.y, term.c.x, term.c.x);
 
   int miny, maxy;
 
@@ -860,7 +1041,7 @@ void tmoveto(int x, int y) {
   term.c.x = LIMIT(x, 0, term.col - 1);
   term.c.y = LIMIT(y, miny, maxy);
 
-  term.dirty[term.c.y] = 1;
+  tsetdirtspan(term.c.y, term.c.x, term.c.x);
 }
 
 void tsetchar(Rune u, const Glyph *attr, int x, int y) {
@@ -887,13 +1068,15 @@ void tsetchar(Rune u, const Glyph *attr, int x, int y) {
     if (x + 1 < term.col) {
       term.line[y][x + 1].u = ' ';
       term.line[y][x + 1].mode &= ~ATTR_WDUMMY;
+      tsetdirtspan(y, x + 1, x + 1);
     }
   } else if (term.line[y][x].mode & ATTR_WDUMMY) {
     term.line[y][x - 1].u = ' ';
     term.line[y][x - 1].mode &= ~ATTR_WIDE;
+    tsetdirtspan(y, x - 1, x - 1);
   }
 
-  term.dirty[y] = 1;
+  tsetdirtspan(y, x, x);
   term.line[y][x] = *attr;
   term.line[y][x].u = u;
 }
@@ -913,7 +1096,7 @@ void tclearregion(int x1, int y1, int x2, int y2) {
   LIMIT(y2, 0, term.row - 1);
 
   for (y = y1; y <= y2; y++) {
-    term.dirty[y] = 1;
+    tsetdirtspan(y, x1, x2);
     for (x = x1; x <= x2; x++) {
       gp = &term.line[y][x];
       if (selected(x, y))
@@ -939,6 +1122,7 @@ void tdeletechar(int n) {
   line = term.line[term.c.y];
 
   memmove(&line[dst], &line[src], size * sizeof(Glyph));
+  tsetdirtspan(term.c.y, term.c.x, term.col - 1);
   tclearregion(term.col - n, term.c.y, term.col - 1, term.c.y);
 }
 
@@ -954,6 +1138,7 @@ void tinsertblank(int n) {
   line = term.line[term.c.y];
 
   memmove(&line[dst], &line[src], size * sizeof(Glyph));
+  tsetdirtspan(term.c.y, term.c.x, term.col - 1);
   tclearregion(src, term.c.y, dst - 1, term.c.y);
 }
 
@@ -967,6 +1152,132 @@ void tdeleteline(int n) {
     tscrollup(term.c.y, n, 0);
 }
 
+#if VT_PACKED_GLYPH
+/*
+ * Out-of-line storage for truecolors in packed Glyphs: slot i is stored
+ * in fg/bg as TCOLOR_BASE + i, clear of the 256 palette indices and
+ * defaultfg/defaultbg. The table is shared by every console and the
+ * status bars, and found through a small open-addressed hash.
+ *
+ * A slot can only be reused once no cell points at it any more, so when
+ * the table fills up (or on RIS) tcolorreclaim() sweeps it at the next
+ * twrite()/tbarwrite() -- the points where every live Glyph is in a
+ * grid, shadow, cursor or bar, see tcolormarkterm() and xcolormark().
+ * Scrollback holds truecolors unpacked (hist.c), so it never pins one.
+ * Until the sweep, colors that don't fit fall back to the nearest 6x6x6
+ * cube entry.
+ */
+#define TCOLOR_BASE 512
+#define TCOLOR_SLOTS 256
+#define TCOLOR_HASH 512 /* power of two, kept at most half full */
+
+static uint32_t tcolors[TCOLOR_SLOTS];
+static uint32_t tcolorused[TCOLOR_SLOTS / 32];
+static uint32_t tcolormarks[TCOLOR_SLOTS / 32];
+static uint16_t tcolorhash[TCOLOR_HASH]; /* slot + 1, 0 = empty */
+static int ntcolors;
+static int tcolorsweep; /* reclaim at the next safe point */
+
+static int tcolorcube(int v) { return v < 48 ? 0 : v < 115 ? 1 : (v - 35) / 40; }
+
+static uint32_t tcolorhashof(uint32_t c) {
+  return (c * 2654435761u) >> (32 - 9); /* 9 bits: TCOLOR_HASH */
+}
+
+uint32_t tcolorpack(uint32_t c) {
+  uint32_t h;
+  int i, w;
+
+  if (!IS_TRUECOL(c))
+    return c;
+
+  for (h = tcolorhashof(c); tcolorhash[h]; h = (h + 1) & (TCOLOR_HASH - 1)) {
+    if (tcolors[tcolorhash[h] - 1] == c)
+      return TCOLOR_BASE + tcolorhash[h] - 1;
+  }
+  if (ntcolors < TCOLOR_SLOTS) {
+    for (w = 0; tcolorused[w] == UINT32_MAX; w++)
+      ;
+    i = w * 32 + __builtin_ctz(~tcolorused[w]);
+    tcolorused[w] |= 1u << (i & 31);
+    tcolors[i] = c;
+    tcolorhash[h] = i + 1;
+    ntcolors++;
+    return TCOLOR_BASE + i;
+  }
+
+  tcolorsweep = 1;
+  return 16 + 36 * tcolorcube((c >> 16) & 0xff) +
+         6 * tcolorcube((c >> 8) & 0xff) + tcolorcube(c & 0xff);
+}
+
+uint32_t tcolorunpack(uint32_t c) {
+  if (c >= TCOLOR_BASE && c < TCOLOR_BASE + TCOLOR_SLOTS)
+    return tcolors[c - TCOLOR_BASE];
+  return c;
+}
+
+static void tcolormarkone(uint32_t c) {
+  if (c >= TCOLOR_BASE && c < TCOLOR_BASE + TCOLOR_SLOTS)
+    tcolormarks[(c - TCOLOR_BASE) / 32] |= 1u << ((c - TCOLOR_BASE) & 31);
+}
+
+void tcolormark(const Glyph *g, int n) {
+  int i;
+
+  for (i = 0; i < n; i++) {
+    tcolormarkone(g[i].fg);
+    tcolormarkone(g[i].bg);
+  }
+}
+
+/*
+ * Marks the slots `term` still uses. The scrollback cache is dropped
+ * rather than marked: its lines are decoded again on demand.
+ */
+void tcolormarkterm(void) {
+  int i;
+
+  for (i = 0; i < term.row; i++) {
+    tcolormark(term.line[i], term.col);
+    tcolormark(term.alt[i], term.col);
+    tcolormark(term.shadow[i], term.col);
+  }
+  tcolormark(&term.c.attr, 1);
+  tcolormark(&term.savedc[0].attr, 1);
+  tcolormark(&term.savedc[1].attr, 1);
+  thistcachedrop();
+}
+
+/* the screens were just cleared: whatever they held can go */
+static void tcolorforget(void) { tcolorsweep = 1; }
+
+void tcolorreclaim(void) {
+  int i;
+  uint32_t h;
+
+  if (!tcolorsweep)
+    return;
+  tcolorsweep = 0;
+
+  memset(tcolormarks, 0, sizeof(tcolormarks));
+  xcolormark();
+  memcpy(tcolorused, tcolormarks, sizeof(tcolorused));
+
+  memset(tcolorhash, 0, sizeof(tcolorhash));
+  ntcolors = 0;
+  for (i = 0; i < TCOLOR_SLOTS; i++) {
+    if (!(tcolorused[i / 32] & (1u << (i & 31))))
+      continue;
+    for (h = tcolorhashof(tcolors[i]); tcolorhash[h];
+         h = (h + 1) & (TCOLOR_HASH - 1))
+      ;
+    tcolorhash[h] = i + 1;
+    ntcolors++;
+  }
+}
+#endif
+
 int32_t tdefcolor(const int *attr, int *npar, int l) {
   int32_t idx = -1;
   uint r, g, b;
@@ -1012,78 +1323,87 @@ int32_t tdefcolor(const int *attr, int *npar, int l) {
 }
 
 void tsetattr(const int *attr, int l) {
-  int i;
+  if (!tattrapply(&term.c.attr, attr, l))
+    csidump();
+}
+
+/*
+ * Applies SGR parameters to *g. Returns 0 if any of them was unknown.
+ * Shared by the terminal (tsetattr()) and the status bars (tbarcsi()).
+ */
+int tattrapply(Glyph *g, const int *attr, int l) {
+  int i, known = 1;
   int32_t idx;
 
   for (i = 0; i < l; i++) {
     switch (attr[i]) {
     case 0:
-      term.c.attr.mode &=
+      g->mode &=
           ~(ATTR_BOLD | ATTR_FAINT | ATTR_ITALIC | ATTR_UNDERLINE | ATTR_BLINK |
             ATTR_REVERSE | ATTR_INVISIBLE | ATTR_STRUCK);
-      term.c.attr.fg = defaultfg;
-      term.c.attr.bg = defaultbg;
+      g->fg = defaultfg;
+      g->bg = defaultbg;
       break;
     case 1:
-      term.c.attr.mode |= ATTR_BOLD;
+      g->mode |= ATTR_BOLD;
       break;
     case 2:
-      term.c.attr.mode |= ATTR_FAINT;
+      g->mode |= ATTR_FAINT;
       break;
     case 3:
-      term.c.attr.mode |= ATTR_ITALIC;
+      g->mode |= ATTR_ITALIC;
       break;
     case 4:
-      term.c.attr.mode |= ATTR_UNDERLINE;
+      g->mode |= ATTR_UNDERLINE;
       break;
     case 5: /* slow blink */
             /* FALLTHROUGH */
     case 6: /* rapid blink */
-      term.c.attr.mode |= ATTR_BLINK;
+      g->mode |= ATTR_BLINK;
       break;
     case 7:
-      term.c.attr.mode |= ATTR_REVERSE;
+      g->mode |= ATTR_REVERSE;
       break;
     case 8:
-      term.c.attr.mode |= ATTR_INVISIBLE;
+      g->mode |= ATTR_INVISIBLE;
       break;
     case 9:
-      term.c.attr.mode |= ATTR_STRUCK;
+      g->mode |= ATTR_STRUCK;
       break;
     case 22:
-      term.c.attr.mode &= ~(ATTR_BOLD | ATTR_FAINT);
+      g->mode &= ~(ATTR_BOLD | ATTR_FAINT);
       break;
     case 23:
-      term.c.attr.mode &= ~ATTR_ITALIC;
+      g->mode &= ~ATTR_ITALIC;
       break;
     case 24:
-      term.c.attr.mode &= ~ATTR_UNDERLINE;
+      g->mode &= ~ATTR_UNDERLINE;
       break;
     case 25:
-      term.c.attr.mode &= ~ATTR_BLINK;
+      g->mode &= ~ATTR_BLINK;
       break;
     case 27:
-      term.c.attr.mode &= ~ATTR_REVERSE;
+      g->mode &= ~ATTR_REVERSE;
       break;
     case 28:
-      term.c.attr.mode &= ~ATTR_INVISIBLE;
+      g->mode &= ~ATTR_INVISIBLE;
       break;
     case 29:
-      term.c.attr.mode &= ~ATTR_STRUCK;
+      g->mode &= ~ATTR_STRUCK;
       break;
     case 38:
       if ((idx = tdefcolor(attr, &i, l)) >= 0)
-        term.c.attr.fg = idx;
+        g->fg = tcolorpack(idx);
       break;
     case 39: /* set foreground color to default */
-      term.c.attr.fg = defaultfg;
+      g->fg = defaultfg;
       break;
     case 48:
       if ((idx = tdefcolor(attr, &i, l)) >= 0)
-        term.c.attr.bg = idx;
+        g->bg = tcolorpack(idx);
       break;
     case 49: /* set background color to default */
-      term.c.attr.bg = defaultbg;
+      g->bg = defaultbg;
       break;
     case 58:
       /* This starts a sequence to change the color of
@@ -1093,20 +1413,21 @@ void tsetattr(const int *attr, int l) {
       break;
     default:
       if (BETWEEN(attr[i], 30, 37)) {
-        term.c.attr.fg = attr[i] - 30;
+        g->fg = attr[i] - 30;
       } else if (BETWEEN(attr[i], 40, 47)) {
-        term.c.attr.bg = attr[i] - 40;
+        g->bg = attr[i] - 40;
       } else if (BETWEEN(attr[i], 90, 97)) {
-        term.c.attr.fg = attr[i] - 90 + 8;
+        g->fg = attr[i] - 90 + 8;
       } else if (BETWEEN(attr[i], 100, 107)) {
-        term.c.attr.bg = attr[i] - 100 + 8;
+        g->bg = attr[i] - 100 + 8;
       } else {
         fprintf(stderr, "erresc(default): gfx attr %d unknown\n", attr[i]);
-        csidump();
+        known = 0;
       }
       break;
     }
   }
+  return known;
 }
 
 void tsetscroll(int t, int b) {
@@ -1155,6 +1476,7 @@ void tsetmode(int priv, int set, const int *args, int narg) {
         break;
       case 25: /* DECTCEM -- Text Cursor Enable Mode */
         xsetmode(!set, MODE_HIDE);
+        tsetdirtspan(term.c.y, term.c.x, term.c.x);
         break;
       case 9: /* X10 mouse compatibility mode */
         xsetpointermotion(0);
@@ -1486,7 +1808,7 @@ void csihandle(void) {
         term.cursor_style = 6; // Default to Beam
         break;
       }
-      term.dirty[term.c.y] = 1; // Force redraw of the cursor line
+      tsetdirtspan(term.c.y, term.c.x, term.c.x); // Force redraw of the cursor
       break;
 
     default:
@@ -1763,7 +2085,9 @@ void tputtab(int n) {
       for (--x; x > 0 && !term.tabs[x]; --x)
         /* nothing */;
   }
+  tsetdirtspan(term.c.y, term.c.x, term.c.x);
   term.c.x = LIMIT(x, 0, term.col - 1);
+  tsetdirtspan(term.c.y, term.c.x, term.c.x);
 }
 
 void tdefutf8(char ascii) {
@@ -2010,15 +2334,37 @@ int eschandle(uchar ascii) {
   return 1;
 }
 
-// Not a full East Asian Width table -- just the ranges this project
-// actually ships wide glyphs for (see WIDE_FONT/WIDE_CHARS/WIDE_FIRST in
-// fb.c): Chess Symbols (U+2654-265F, bundled into Unifont's own
-// WIDE_FONT block) and Siji's icon range (U+E000-E195, loaded as a
-// separate iconic font via VT.set_icon_font() -- see fb.h/vt_module.c).
-// Both are actual glyph widths in their respective fonts, not a font-
-// specific preference, so this stays a static table rather than reading
-// whatever's currently loaded. Extend this if/when more wide-glyph
-// ranges get added.
+// East Asian Wide/Fullwidth blocks (the usual wcwidth() ranges -- not
+// the full per-codepoint table, which isn't worth the flash here). A
+// remote program lays its text out by these widths whether or not the
+// current font has the glyphs, so they're wide regardless: with a large
+// paged font (fontconvert.py --wide-ranges) they draw from its WIDE_FONT,
+// without one they're a blank double cell rather than a misaligned line.
+static const uint32_t st_wide_ranges[][2] = {
+    {0x1100, 0x115f},   // Hangul Jamo initials
+    {0x2e80, 0x303e},   // CJK radicals .. CJK symbols and punctuation
+    {0x3041, 0x33ff},   // Hiragana .. CJK compatibility
+    {0x3400, 0x4dbf},   // CJK extension A
+    {0x4e00, 0x9fff},   // CJK unified ideographs
+    {0xa000, 0xa4cf},   // Yi
+    {0xac00, 0xd7a3},   // Hangul syllables
+    {0xf900, 0xfaff},   // CJK compatibility ideographs
+    {0xfe30, 0xfe4f},   // CJK compatibility forms
+    {0xff00, 0xff60},   // Fullwidth forms
+    {0xffe0, 0xffe6},   // Fullwidth signs
+    {0x1f300, 0x1f64f}, // Pictographs, emoticons
+    {0x1f900, 0x1f9ff}, // Supplemental symbols and pictographs
+    {0x20000, 0x2fffd}, // CJK extensions B..
+    {0x30000, 0x3fffd},
+};
+
+// On top of those, the ranges this project ships its own wide glyphs for
+// (see WIDE_FONT/WIDE_CHARS/WIDE_FIRST in fb.c): Chess Symbols
+// (U+2654-265F, bundled into Unifont's own WIDE_FONT block) and Siji's
+// icon range (U+E000-E195, loaded as a separate iconic font via
+// VT.set_icon_font() -- see fb.h/vt_module.c). All of these are actual
+// glyph widths, not a font-specific preference, so this stays a static
+// table rather than reading whatever's currently loaded.
 int st_wcwidth(uint32_t u) {
   if (u == 0)
     return 0;
@@ -2028,7 +2374,19 @@ int st_wcwidth(uint32_t u) {
     return 2; // Chess Symbols
   if (u >= 0xe000 && u <= 0xe195)
     return 2; // Siji icons (UNICODE_ICONS in fontconvert.py)
-  return 1;    // Everything else is 1 cell wide
+  if (u >= 0x1100) {
+    size_t lo = 0, hi = LEN(st_wide_ranges);
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (u < st_wide_ranges[mid][0])
+        hi = mid;
+      else if (u > st_wide_ranges[mid][1])
+        lo = mid + 1;
+      else
+        return 2;
+    }
+  }
+  return 1; // Everything else is 1 cell wide
 }
 
 void tputc(Rune u) {
@@ -2086,8 +2444,9 @@ void tputc(Rune u) {
        */
       if (strescseq.siz > (SIZE_MAX - UTF_SIZ) / 2)
         return;
+      /* siz only once the buffer really is that big: die() may unwind */
+      strescseq.buf = xrealloc(strescseq.buf, strescseq.siz * 2);
       strescseq.siz *= 2;
-      strescseq.buf = xrealloc(strescseq.buf, strescseq.siz);
     }
 
     memmove(&strescseq.buf[strescseq.len], c, len);
@@ -2152,6 +2511,7 @@ check_control_code:
 
   if (IS_SET(MODE_INSERT) && term.c.x + width < term.col) {
     memmove(gp + width, gp, (term.col - term.c.x - width) * sizeof(Glyph));
+    tsetdirtspan(term.c.y, term.c.x, term.col - 1);
     gp->mode &= ~ATTR_WIDE;
   }
 
@@ -2167,6 +2527,7 @@ check_control_code:
   term.lastc = u;
 
   if (width == 2) {
+    tsetdirtspan(term.c.y, term.c.x, term.c.x + 2);
     gp->mode |= ATTR_WIDE;
     if (term.c.x + 1 < term.col) {
       if (gp[1].mode == ATTR_WIDE && term.c.x + 2 < term.col) {
@@ -2184,12 +2545,69 @@ check_control_code:
   }
 }
 
+/*
+ * twrite()'s fast path: stores the run of printable ASCII at the start of
+ * s straight into the cursor line -- one dirty span and one cursor move
+ * for the lot -- instead of sending each byte through tputc()'s escape,
+ * charset, width and wrap checks. Stops at the first other byte or the
+ * end of the line and returns how many it took; 0 means this state
+ * needs tputc() (pending escape, wrap, insert/print mode, the DEC
+ * graphics charset, or a selection that may need clearing).
+ */
+static int tputrun(const char *s, int len) {
+  int i, n, x = term.c.x, y = term.c.y;
+  Line line;
+  Glyph g;
+
+  if (term.esc || (term.c.state & CURSOR_WRAPNEXT) ||
+      IS_SET(MODE_INSERT | MODE_PRINT) ||
+      term.trantbl[term.charset] == CS_GRAPHIC0 || sel.ob.x != -1)
+    return 0;
+
+  n = SMIN(len, term.col - x);
+  for (i = 0; i < n && BETWEEN(s[i], 0x20, 0x7e); i++)
+    /* nothing */;
+  if ((n = i) == 0)
+    return 0;
+
+  /* only the ends of the run can cut a wide pair in half, as tsetchar() */
+  line = term.line[y];
+  if (line[x].mode & ATTR_WDUMMY) {
+    line[x - 1].u = ' ';
+    line[x - 1].mode &= ~ATTR_WIDE;
+    tsetdirtspan(y, x - 1, x - 1);
+  }
+  if ((line[x + n - 1].mode & ATTR_WIDE) && x + n < term.col) {
+    line[x + n].u = ' ';
+    line[x + n].mode &= ~ATTR_WDUMMY;
+    tsetdirtspan(y, x + n, x + n);
+  }
+
+  g = term.c.attr;
+  for (i = 0; i < n; i++) {
+    g.u = (uchar)s[i];
+    line[x + i] = g;
+  }
+  tsetdirtspan(y, x, x + n - 1);
+  term.lastc = (uchar)s[n - 1];
+
+  if (x + n < term.col)
+    tmoveto(x + n, y);
+  else
+    term.c.state |= CURSOR_WRAPNEXT;
+  return n;
+}
+
 int twrite(const char *buf, int buflen, int show_ctrl) {
   int charsize;
   Rune u;
   int n;
 
+  tcolorreclaim();
   for (n = 0; n < buflen; n += charsize) {
+    if ((charsize = tputrun(buf + n, buflen - n)) > 0)
+      continue;
+
     if (IS_SET(MODE_UTF8)) {
       /* process a complete utf8 char */
       charsize = utf8decode(buf + n, &u, buflen - n);
@@ -2214,8 +2632,328 @@ int twrite(const char *buf, int buflen, int show_ctrl) {
   return n;
 }
 
+/*
+ * Direct grid access, for in-process widgets (vttui) that would otherwise
+ * format CSI sequences only for csiparse() to take them apart again. Each
+ * call does to term exactly what the equivalent escape sequence or text
+ * would -- same cursor clamping, same pen, same wide-cell bookkeeping and
+ * dirty spans -- so it can be freely mixed with twrite() on the same
+ * screen. The caller holds whatever lock guards term (see
+ * vt_direct_begin() in vt_module.c).
+ */
+
+/* CUP */
+void tgridcursor(int x, int y) { tmoveato(x, y); }
+
+/* SGR, with the parameters already split out */
+void tgridsgr(const int *attr, int l) { tattrapply(&term.c.attr, attr, l); }
+
+/* whether the cells at the cursor can be stored without tputc() */
+static int tgridready(void) {
+  return !term.esc && !(term.c.state & CURSOR_WRAPNEXT) &&
+         !IS_SET(MODE_INSERT | MODE_PRINT) && IS_SET(MODE_UTF8) &&
+         term.trantbl[term.charset] != CS_GRAPHIC0;
+}
+
+/* stores u in the pen's attributes at x, taking two cells if it's wide */
+static void tgridcell(Rune u, int w, int x, int y) {
+  Line line = term.line[y];
+
+  if (selected(x, y))
+    selclear();
+  tsetchar(u, &term.c.attr, x, y);
+  if (w == 2) {
+    if (line[x + 1].mode == ATTR_WIDE && x + 2 < term.col) {
+      line[x + 2].u = ' ';
+      line[x + 2].mode &= ~ATTR_WDUMMY;
+    }
+    line[x].mode |= ATTR_WIDE;
+    line[x + 1].u = '\0';
+    line[x + 1].mode = ATTR_WDUMMY;
+    tsetdirtspan(y, x, x + 2);
+  }
+  term.lastc = u;
+}
+
+/* leaves the cursor after a run that ended at x, the last rune at last */
+static void tgridadvance(int x, int last) {
+  if (x < term.col) {
+    tmoveto(x, term.c.y);
+  } else {
+    tmoveto(last, term.c.y);
+    term.c.state |= CURSOR_WRAPNEXT;
+  }
+}
+
+/*
+ * Stores the printable UTF-8 at the start of s at the cursor, in the
+ * current pen, and moves the cursor past it. Stops at the first control
+ * character, incomplete sequence or rune that would need to wrap, and
+ * returns the number of bytes it took; 0 means the next rune needs
+ * twrite() (that, or an escape is pending or a mode is set that tputc()
+ * has to handle).
+ */
+int tgridput(const char *s, int len) {
+  int n = 0, k, w, x = term.c.x, last = x;
+  Rune u;
+
+  if (!tgridready())
+    return 0;
+
+  while (n < len) {
+    if ((uchar)s[n] < 0x80) {
+      if (!BETWEEN(s[n], 0x20, 0x7e))
+        break;
+      u = (uchar)s[n];
+      k = 1;
+    } else if (!(k = utf8decode(s + n, &u, len - n)) || ISCONTROL(u)) {
+      break;
+    }
+    w = (st_wcwidth(u) == 2) ? 2 : 1;
+    if (x + w > term.col)
+      break;
+    tgridcell(u, w, x, term.c.y);
+    last = x;
+    x += w;
+    n += k;
+  }
+
+  if (n > 0)
+    tgridadvance(x, last);
+  return n;
+}
+
+/*
+ * tgridput() for n copies of one rune -- padding and box rules. Returns
+ * how many it stored, which is short of n only where the rest would wrap.
+ */
+int tgridputn(Rune u, int n) {
+  int i, w, x = term.c.x, last = x;
+
+  if (!tgridready() || ISCONTROL(u))
+    return 0;
+
+  w = (st_wcwidth(u) == 2) ? 2 : 1;
+  for (i = 0; i < n && x + w <= term.col; i++) {
+    tgridcell(u, w, x, term.c.y);
+    last = x;
+    x += w;
+  }
+
+  if (i > 0)
+    tgridadvance(x, last);
+  return i;
+}
+
+/*
+ * Fills the w x h cells at x, y with u in the current pen. The cursor
+ * doesn't move; u should be single-width.
+ */
+void tgridfill(int x, int y, int w, int h, Rune u) {
+  int x1, x2, i, j;
+  Glyph g = term.c.attr;
+
+  x1 = SMAX(x, 0);
+  x2 = SMIN(x + w, term.col) - 1;
+  if (x1 > x2)
+    return;
+  g.u = u;
+  g.mode &= ~(ATTR_WIDE | ATTR_WDUMMY | ATTR_WRAP);
+
+  for (j = SMAX(y, 0); j < SMIN(y + h, term.row); j++) {
+    Line line = term.line[j];
+
+    /* don't leave half of a wide pair behind at either edge */
+    if (line[x1].mode & ATTR_WDUMMY) {
+      line[x1 - 1].u = ' ';
+      line[x1 - 1].mode &= ~ATTR_WIDE;
+    }
+    if ((line[x2].mode & ATTR_WIDE) && x2 + 1 < term.col) {
+      line[x2 + 1].u = ' ';
+      line[x2 + 1].mode &= ~ATTR_WDUMMY;
+    }
+    for (i = x1; i <= x2; i++) {
+      if (selected(i, j))
+        selclear();
+      line[i] = g;
+    }
+    tsetdirtspan(j, x1 - (x1 > 0), x2 + 1);
+  }
+}
+
+/*
+ * The status bars' parser. draw_bar_ansi() used to borrow the terminal's
+ * own, swapping term.line, the cursor, term.esc, csiescseq and
+ * strescseq out and back around a run of tputc()s on every refresh --
+ * ~1 KB of copying per update, and a bar refresh landing between two
+ * halves of a sequence was one missed field away from corrupting it. A
+ * bar is a single line of colored text, so it gets a parser of its own
+ * with all its state in the TBar: nothing of the terminal's is read or
+ * written apart from the default colors and tabspaces.
+ *
+ * Printable runes are stored at bar->x in the current SGR attributes,
+ * wide ones taking two cells as in tputc(); text past the end of the bar
+ * is dropped rather than wrapped. CR, BS and TAB move; of the CSI
+ * sequences SGR (m), CHA (G), CUF (C), CUB (D) and EL (K) are understood.
+ * Any other escape, and OSC/DCS-style strings, are consumed and ignored.
+ */
+void tbarinit(TBar *bar, Line line, int col) {
+  memset(bar, 0, sizeof(*bar));
+  bar->line = line;
+  bar->col = col;
+  bar->attr.fg = defaultfg;
+  bar->attr.bg = defaultbg;
+}
+
+static void tbarput(TBar *bar, Rune u) {
+  int width = st_wcwidth(u) == 2 ? 2 : 1;
+  Glyph *gp;
+
+  if (bar->x + width > bar->col) {
+    bar->x = bar->col;
+    return;
+  }
+
+  /* don't leave half of a wide pair behind, as tsetchar() */
+  gp = &bar->line[bar->x];
+  if ((gp->mode & ATTR_WDUMMY) && bar->x > 0) {
+    gp[-1].u = ' ';
+    gp[-1].mode &= ~ATTR_WIDE;
+  }
+  if ((gp[width - 1].mode & ATTR_WIDE) && bar->x + width < bar->col) {
+    gp[width].u = ' ';
+    gp[width].mode &= ~ATTR_WDUMMY;
+  }
+
+  *gp = bar->attr;
+  gp->u = u;
+  if (width == 2) {
+    gp->mode |= ATTR_WIDE;
+    gp[1] = bar->attr;
+    gp[1].u = '\0';
+    gp[1].mode = ATTR_WDUMMY;
+  }
+  bar->x += width;
+}
+
+static void tbarclear(TBar *bar, int x1, int x2) {
+  Glyph g = {.u = ' ', .fg = bar->attr.fg, .bg = bar->attr.bg};
+
+  for (; x1 <= x2; x1++)
+    bar->line[x1] = g;
+}
+
+static void tbarcsi(TBar *bar, Rune mode) {
+  int n = bar->arg[0];
+
+  if (bar->priv)
+    return;
+
+  switch (mode) {
+  case 'm':
+    tattrapply(&bar->attr, bar->arg, bar->narg);
+    break;
+  case 'G': /* CHA -- 1-based column */
+    DEFAULT(n, 1);
+    bar->x = SMIN(n - 1, bar->col);
+    break;
+  case 'C': /* CUF */
+    DEFAULT(n, 1);
+    bar->x = SMIN(bar->x + n, bar->col);
+    break;
+  case 'D': /* CUB */
+    DEFAULT(n, 1);
+    bar->x = SMAX(bar->x - n, 0);
+    break;
+  case 'K': /* EL */
+    if (n == 0)
+      tbarclear(bar, bar->x, bar->col - 1);
+    else if (n == 1)
+      tbarclear(bar, 0, SMIN(bar->x, bar->col - 1));
+    else if (n == 2)
+      tbarclear(bar, 0, bar->col - 1);
+    break;
+  }
+}
+
+static void tbarputc(TBar *bar, Rune u) {
+  switch (bar->state) {
+  case BAR_STR:
+    /* terminated like tputc()'s ESC_STR; ESC \ ends in BAR_ESC */
+    if (u == 033)
+      bar->state = BAR_ESC;
+    else if (u == '\a' || u == 030 || u == 032 || ISCONTROLC1(u))
+      bar->state = BAR_GROUND;
+    return;
+  case BAR_ESC:
+    if (u == '[') {
+      memset(bar->arg, 0, sizeof(bar->arg));
+      bar->narg = 0;
+      bar->priv = 0;
+      bar->state = BAR_CSI;
+    } else if (u == ']' || u == 'P' || u == '_' || u == '^' || u == 'X') {
+      bar->state = BAR_STR;
+    } else if (!BETWEEN(u, 0x20, 0x2f)) {
+      /* anything but an intermediate byte ends the sequence */
+      bar->state = BAR_GROUND;
+    }
+    return;
+  case BAR_CSI:
+    if (BETWEEN(u, '0', '9')) {
+      if (bar->narg < ESC_ARG_SIZ)
+        bar->arg[bar->narg] = SMIN(bar->arg[bar->narg] * 10 + (u - '0'),
+                                   65535);
+    } else if (u == ';' || u == ':') {
+      if (bar->narg < ESC_ARG_SIZ)
+        bar->narg++;
+    } else if (BETWEEN(u, 0x3c, 0x3f)) {
+      bar->priv = u;
+    } else if (BETWEEN(u, 0x40, 0x7e)) {
+      if (bar->narg < ESC_ARG_SIZ)
+        bar->narg++;
+      bar->state = BAR_GROUND;
+      tbarcsi(bar, u);
+    } else if (u == 033) {
+      bar->state = BAR_ESC;
+    } else if (u == 030 || u == 032) {
+      bar->state = BAR_GROUND;
+    }
+    return;
+  }
+
+  switch (u) {
+  case 033:
+    bar->state = BAR_ESC;
+    return;
+  case '\r':
+    bar->x = 0;
+    return;
+  case '\b':
+    if (bar->x > 0)
+      bar->x--;
+    return;
+  case '\t':
+    bar->x = SMIN((bar->x / tabspaces + 1) * tabspaces, bar->col);
+    return;
+  }
+  if (!ISCONTROL(u))
+    tbarput(bar, u);
+}
+
+void tbarwrite(TBar *bar, const char *s, size_t len) {
+  size_t i, n;
+  Rune u;
+
+  tcolorreclaim();
+  for (i = 0; i < len; i += n) {
+    if ((n = utf8decode(s + i, &u, len - i)) == 0)
+      break;
+    tbarputc(bar, u);
+  }
+}
+
 void tresize(int col, int row) {
-  int i, j;
+  int i;
   int minrow = SMIN(row, term.row);
   int mincol = SMIN(col, term.col);
   int *bp;
@@ -2249,15 +2987,12 @@ void tresize(int col, int row) {
   term.line = xrealloc(term.line, row * sizeof(Line));
   term.alt = xrealloc(term.alt, row * sizeof(Line));
   term.dirty = xrealloc(term.dirty, row * sizeof(*term.dirty));
+  term.dirtyx1 = xrealloc(term.dirtyx1, row * sizeof(*term.dirtyx1));
+  term.dirtyx2 = xrealloc(term.dirtyx2, row * sizeof(*term.dirtyx2));
+  term.rowgen = xrealloc(term.rowgen, row * sizeof(*term.rowgen));
   term.tabs = xrealloc(term.tabs, col * sizeof(*term.tabs));
 
-  for (i = 0; i < HISTSIZE; i++) {
-    term.hist[i] = xrealloc(term.hist[i], col * sizeof(Glyph));
-    for (j = mincol; j < col; j++) {
-      term.hist[i][j] = term.c.attr;
-      term.hist[i][j].u = ' ';
-    }
-  }
+  /* history is stored width-independent, see thistline() */
 
   /* resize each row to new width, zero-pad if needed */
   for (i = 0; i < minrow; i++) {
@@ -2279,9 +3014,20 @@ void tresize(int col, int row) {
     for (bp += tabspaces; bp < term.tabs + col; bp += tabspaces)
       *bp = 1;
   }
+  /* the shadow is recreated rather than resized: a new size is a new font */
+  for (i = row; i < term.row; i++)
+    free(term.shadow[i]);
+  term.shadow = xrealloc(term.shadow, row * sizeof(Line));
+  for (i = 0; i < row; i++) {
+    term.shadow[i] = xrealloc((i < term.row) ? term.shadow[i] : NULL,
+                              col * sizeof(Glyph));
+    memset(term.shadow[i], 0xff, col * sizeof(Glyph));
+  }
+
   /* update terminal size */
   term.col = col;
   term.row = row;
+  tgenbump(0, row - 1);
   /* reset scrolling region */
   tsetscroll(0, row - 1);
   /* make use of the LIMIT in tmoveto */
@@ -2303,8 +3049,14 @@ void tresize(int col, int row) {
 
 void resettitle(void) { xsettitle(NULL); }
 
+/* a cell the cursor is on now or was drawn on last time is never skipped */
+static int tcursorcell(int x, int y) {
+  return (y == term.c.y && x == term.c.x) || (y == term.ocy && x == term.ocx);
+}
+
 void drawregion(int x1, int y1, int x2, int y2) {
-  int y;
+  int y, sx1, sx2;
+  Line line, shadow;
 
   mp_uint_t t0 = mp_hal_ticks_ms();
   for (y = y1; y < y2; y++) {
@@ -2312,7 +3064,35 @@ void drawregion(int x1, int y1, int x2, int y2) {
       continue;
 
     term.dirty[y] = 0;
-    xdrawline(TLINE(y), x1, y, x2);
+
+    /* only the damaged span; x2 is exclusive, dirtyx2 isn't */
+    sx1 = SMAX(x1, term.dirtyx1[y]);
+    sx2 = SMIN(x2, term.dirtyx2[y] + 1);
+    line = TLINE(y);
+
+    /*
+     * Apps routinely rewrite a screenful of identical cells; trim the
+     * span down to the cells that actually differ from what the display
+     * shows. Fields, not memcmp(): Glyph has padding.
+     */
+    shadow = term.shadow[y];
+    while (sx1 < sx2 && !tcursorcell(sx1, y) &&
+           !GLYPHCMP(line[sx1], shadow[sx1]))
+      sx1++;
+    while (sx2 > sx1 && !tcursorcell(sx2 - 1, y) &&
+           !GLYPHCMP(line[sx2 - 1], shadow[sx2 - 1]))
+      sx2--;
+
+    /* a wide glyph can only be sent whole */
+    if (sx1 > 0 && sx1 < term.col && (line[sx1].mode & ATTR_WDUMMY))
+      sx1--;
+    if (sx2 > 0 && sx2 < term.col && (line[sx2 - 1].mode & ATTR_WIDE))
+      sx2++;
+    if (sx1 >= sx2)
+      continue;
+
+    xdrawline(line, sx1, y, sx2);
+    memcpy(shadow + sx1, line + sx1, (sx2 - sx1) * sizeof(Glyph));
 
     mp_uint_t now = mp_hal_ticks_ms();
     if (now - t0 >= 30) {
@@ -2327,6 +3107,7 @@ void draw(void) {
 
   if (!xstartdraw())
     return;
+  term.damaged = 0;
 
   /* adjust cursor position */
   LIMIT(term.ocx, 0, term.col - 1);
@@ -2350,6 +3131,6 @@ void draw(void) {
 }
 
 void redraw(void) {
-  tfulldirt();
+  tfullredraw();
   draw();
 }
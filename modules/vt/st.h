@@ -3,10 +3,22 @@
 #ifndef ST_TERM_H
 #define ST_TERM_H
 
+#include <setjmp.h>
 #include <stddef.h>
 #include <stdint.h>
 
-#define HISTSIZE 100
+/*
+ * VT_PACKED_GLYPH packs a Glyph into 8 bytes instead of 16 (see below),
+ * which buys twice the scrollback for the same RAM. Build with
+ * -DVT_PACKED_GLYPH=0 for the plain struct, e.g. to rule it out when
+ * chasing a rendering bug.
+ */
+#ifndef VT_PACKED_GLYPH
+#define VT_PACKED_GLYPH 1
+#endif
+
+/* default scrollback lines, see VT(scrollback=) and hist.c */
+#define HISTSIZE 1000
 
 /* macros */
 #define SMIN(a, b) ((a) < (b) ? (a) : (b))
@@ -18,6 +30,7 @@
 #define LIMIT(x, a, b) (x) = (long)(x) < (a) ? (a) : (long)(x) > (b) ? (b) : (x)
 #define ATTRCMP(a, b)                                                          \
   ((a).mode != (b).mode || (a).fg != (b).fg || (a).bg != (b).bg)
+#define GLYPHCMP(a, b) ((a).u != (b).u || ATTRCMP(a, b))
 #define TIMEDIFF(t1, t2)                                                       \
   ((t1.tv_sec - t2.tv_sec) * 1000 + (t1.tv_nsec - t2.tv_nsec) / 1E6)
 #define MODBIT(x, set, bit) ((set) ? ((x) |= (bit)) : ((x) &= ~(bit)))
@@ -25,9 +38,7 @@
 #define TRUECOLOR(r, g, b) (1 << 24 | (r) << 16 | (g) << 8 | (b))
 #define IS_TRUECOL(x) (1 << 24 & (x))
 #define TLINE(y)                                                               \
-  ((y) < term.scr                                                              \
-       ? term.hist[((y) + term.histi - term.scr + HISTSIZE + 1) % HISTSIZE]    \
-       : term.line[(y) - term.scr])
+  ((y) < term.scr ? thistline(term.scr - (y)) : term.line[(y) - term.scr])
 
 enum glyph_attribute {
   ATTR_NULL = 0,
@@ -61,6 +72,28 @@ typedef unsigned short ushort;
 typedef uint_least32_t Rune;
 
 #define Glyph Glyph_
+#if VT_PACKED_GLYPH
+/*
+ * 21 bits cover all of Unicode and every glyph_attribute fits in 11.
+ * Colors are palette indices as usual; a truecolor doesn't fit, so
+ * tcolorpack() parks it in an out-of-line table and stores the slot
+ * instead. Anything reading fg/bg for display goes through
+ * tcolorunpack() (map_st_color() does).
+ */
+typedef struct {
+  uint32_t u : 21;    /* character code */
+  uint32_t mode : 11; /* attribute flags */
+  uint16_t fg;        /* foreground  */
+  uint16_t bg;        /* background  */
+} Glyph;
+
+uint32_t tcolorpack(uint32_t);
+uint32_t tcolorunpack(uint32_t);
+void tcolorreclaim(void);
+void tcolormark(const Glyph *, int);
+void tcolormarkterm(void);
+void xcolormark(void);
+#else
 typedef struct {
   Rune u;      /* character code */
   ushort mode; /* attribute flags */
@@ -68,6 +101,11 @@ typedef struct {
   uint32_t bg; /* background  */
 } Glyph;
 
+#define tcolorpack(c) (c)
+#define tcolorunpack(c) (c)
+#define tcolorreclaim()
+#endif
+
 typedef Glyph *Line;
 
 typedef union {
@@ -79,6 +117,7 @@ typedef union {
 } Arg;
 
 void die(const char *, ...);
+extern jmp_buf *tdiejmp;
 void redraw(void);
 void draw(void);
 
@@ -91,6 +130,9 @@ int tattrset(int);
 void tnew(int, int);
 void tresize(int, int);
 void tsetdirtattr(int);
+void tfulldirt(void);
+void tfullredraw(void);
+void tgenbump(int, int);
 void ttyhangup(void);
 int ttynew(const char *, char *, const char *, char **);
 size_t ttyread(void);
@@ -212,16 +254,70 @@ typedef struct {
   int alt;
 } Selection;
 
+/* Compressed scrollback, see hist.c */
+typedef struct {
+  uint16_t page; /* index into THist.pages */
+  uint16_t off;  /* byte offset of the line's record in it */
+  uint16_t len;  /* record length */
+} THistLine;
+
+typedef struct {
+  int size;           /* capacity in lines, 0 = no scrollback */
+  int count;          /* lines currently held */
+  uint32_t seq;       /* lines ever pushed; newest is seq - 1 */
+  THistLine *lines;   /* ring of size, indexed by seq % size */
+  uint8_t **pages;    /* ring of npages compressed pages */
+  int npages;
+  int headpage;       /* page being appended to, -1 = none yet */
+  int headoff;        /* append offset in it */
+  Line *cache;        /* decoded lines, see thistline() */
+  uint32_t *cachetag; /* seq + 1 held by each cache slot, 0 = none */
+  int cacherows;
+  int cachecols;
+} THist;
+
+int thistsetup(int);
+void thistpush(const Glyph *, int);
+Line thistline(int);
+void thistcachedrop(void);
+
+/* CSI Escape sequence structs */
+/* ESC '[' [[ [<priv>] <arg> [;]] <mode> [<mode>]] */
+typedef struct {
+  char buf[ESC_BUF_SIZ]; /* raw string */
+  size_t len;            /* raw string length */
+  char priv;
+  int arg[ESC_ARG_SIZ];
+  int narg; /* nb of args */
+  char mode[2];
+} CSIEscape;
+
+/* STR Escape sequence structs */
+/* ESC type [[ [<priv>] <arg> [;]] <mode>] ESC '\' */
+typedef struct {
+  char type;  /* ESC type ... */
+  char *buf;  /* allocated raw string */
+  size_t siz; /* allocation size */
+  size_t len; /* raw string length */
+  char *args[STR_ARG_SIZ];
+  int narg; /* nb of args */
+} STREscape;
+
 /* Internal representation of the screen */
 typedef struct {
   int row;             /* nb row */
   int col;             /* nb col */
   Line *line;          /* screen */
   Line *alt;           /* alternate screen */
-  Line hist[HISTSIZE]; /* history buffer */
-  int histi;           /* history index */
+  THist hist;          /* history buffer */
   int scr;             /* scroll back */
   int *dirty;          /* dirtyness of lines */
+  int *dirtyx1;        /* first damaged col of a dirty line */
+  int *dirtyx2;        /* last damaged col of a dirty line */
+  Line *shadow;        /* glyphs each line last drew, see drawregion() */
+  uint32_t gen;        /* last change generation handed out */
+  uint32_t *rowgen;    /* generation of each line's last change */
+  uint32_t bargen[2];  /* same for the top (0) and bottom (1) bars */
   TCursor c;           /* cursor */
   int ocx;             /* old cursor col */
   int ocy;             /* old cursor row */
@@ -236,41 +332,49 @@ typedef struct {
   Rune lastc; /* last printed char outside of sequence, 0 if control */
   int cursor_style;
   int top_offset;
+  TCursor savedc[2];     /* DECSC/DECRC slots, main and alt screen */
+  Selection sel;         /* see selinit() */
+  CSIEscape csiescseq;   /* parser state for the sequence being read */
+  STREscape strescseq;
+  unsigned int wmode;    /* win.h modes, see xsetmode() (fb.c) */
+  int damaged;           /* dirty since the last draw(), see xdamage() */
 } Term;
 
-/* CSI Escape sequence structs */
-/* ESC '[' [[ [<priv>] <arg> [;]] <mode> [<mode>]] */
+
+/*
+ * Everything a terminal is -- grid, scrollback, cursor, parser state --
+ * lives in a Term, so there can be more than one (VT(consoles=)). `term`
+ * is whichever the t*() functions act on: the console on screen, tfront,
+ * except while vt_module.c feeds output to one in the background.
+ */
+extern Term *tcur;
+extern Term *tfront;
+#define term (*tcur)
+
+void tfree(void);
+
+/* Status bar parser, see tbarwrite() */
+enum bar_state { BAR_GROUND, BAR_ESC, BAR_CSI, BAR_STR };
+
 typedef struct {
-  char buf[ESC_BUF_SIZ]; /* raw string */
-  size_t len;            /* raw string length */
-  char priv;
+  Line line;  /* the bar's cells */
+  int col;    /* and how many there are */
+  int x;      /* where the next rune goes */
+  Glyph attr; /* current SGR attributes */
+  int state;  /* enum bar_state */
   int arg[ESC_ARG_SIZ];
-  int narg; /* nb of args */
-  char mode[2];
-} CSIEscape;
+  int narg;
+  char priv;
+} TBar;
 
-/* STR Escape sequence structs */
-/* ESC type [[ [<priv>] <arg> [;]] <mode>] ESC '\' */
-typedef struct {
-  char type;  /* ESC type ... */
-  char *buf;  /* allocated raw string */
-  size_t siz; /* allocation size */
-  size_t len; /* raw string length */
-  char *args[STR_ARG_SIZ];
-  int narg; /* nb of args */
-} STREscape;
+void tbarinit(TBar *, Line, int);
+void tbarwrite(TBar *, const char *, size_t);
 
-extern Term term;
-
-// Not static -- draw_bar_ansi() (fb.c) needs to save/restore these around
-// its temporary takeover of the shared parser state, same reason
-// utf8decode() above lost its static. Both are accumulation buffers for
-// an in-progress escape sequence (CSIEscape for CSI, STREscape for OSC/
-// DCS/etc.); processing the status bar's own text through tputc() while
-// the main terminal is mid-sequence -- e.g. mid-way through one of
-// vttui's own SGR color codes -- silently clobbers whatever had been
-// accumulated so far, since both paths share the same buffer.
-extern CSIEscape csiescseq;
-extern STREscape strescseq;
+/* Direct grid access for in-process widgets, see tgridput() */
+void tgridcursor(int, int);
+void tgridsgr(const int *, int);
+int tgridput(const char *, int);
+int tgridputn(Rune, int);
+void tgridfill(int, int, int, int, Rune);
 
 #endif
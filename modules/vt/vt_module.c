@@ -6,16 +6,27 @@
  * License: MIT
  */
 
+#include <stdio.h>
+
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
+// xTaskCreatePinnedToCore moved here in ESP-IDF 5.3+, see modssh.c
+#include "freertos/idf_additions.h"
+#include "esp_heap_caps.h"
+#include "py/mperrno.h"
 #include "py/mphal.h"
 #include "py/objstr.h"
 #include "py/runtime.h"
 #include "py/stream.h"
+#include "esp_partition.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "extmod/vfs.h"
 
 #include "fb.h"
 #include "mpfile.h"
+#include "png/miniz.h"
 #include "st.h"
 #include "st7789.h"
 
@@ -29,12 +40,438 @@ vt_VT_obj_t *current_vt_obj = NULL;
 // Forward declaration
 const mp_obj_type_t vt_VT_type;
 
+// Async write path -- VT(..., async_write=True).
+//
+// VT.write() (and the stream write dupterm uses) normally runs twrite()
+// inline on mp_task, so a big burst of output (an `ls` of a full SD card,
+// a pasted file) holds the REPL for as long as the parser takes. In async
+// mode write() only copies into vt_async.buf and returns; a task pinned to
+// the core mp_task isn't on runs the bytes through twrite() there, and
+// mp_task's next draw() picks up whatever is dirty by then.
+//
+// Only parsing moves off mp_task -- draw() stays where it is. On the
+// T-Deck the TFT shares its SPI bus with the SD card and the LoRa radio,
+// all three with GPIO-driven CS lines, so nothing but mp_task may touch
+// the bus. The parser never does: fb.c's xscroll() only records the
+// scroll, it is sent on the next draw().
+//
+// The ring is single-producer (mp_task) / single-consumer (the drain
+// task), so it needs no lock: head and tail run free and wrap on their
+// own, only head is written by the producer and only tail by the
+// consumer. `term` itself is shared, though, and every entry point below
+// that reads or writes it takes vt_async.lock around the work (vt_lock()
+// is a no-op until the task exists).
+//
+// The drain task is no MicroPython thread: it has nothing to raise into.
+// An allocation failure in the parser (die(), st.c) unwinds back to it
+// through tdiejmp instead, and the chunk is dropped. Terminal replies
+// (ttywrite() -> xreply()) don't go into tdeck_kvm.c's input ring from
+// there either -- that ring is mp_task's -- but through vt_async.reply,
+// which mp_task empties into it, see vt_reply_pump().
+#define VT_RING_SIZE 8192 /* must be a power of two */
+#define VT_DRAIN_CHUNK 512
+// In bytes -- ESP-IDF's xTaskCreate*() takes the depth in bytes, not
+// StackType_t words. The parser keeps its big buffers static (the drain
+// chunk, hist.c's encode buffer); what's left is twrite()'s call chain
+// plus newlib's snprintf() for the status reports; 6KB keeps a margin
+// over that for the panic handler and the stack canary.
+#define VT_TASK_STACK_BYTES 6144
+#define VT_TASK_PRIORITY 5
+#define VT_REPLY_SIZE 256 /* must be a power of two */
+
+// ports/esp32 runs mp_task on core 1 of a dual-core chip; the drain task
+// takes the other one.
+#ifndef MP_TASK_COREID
+#define MP_TASK_COREID 1
+#endif
+
+static struct {
+  uint8_t *buf;
+  volatile uint32_t head; // bytes ever written, producer only
+  volatile uint32_t tail; // bytes ever parsed, consumer only
+  volatile bool stalled;  // what's left is an incomplete UTF-8 sequence
+  volatile uint32_t stalled_head; // ... and head was this when it stopped
+  bool enabled;
+  TaskHandle_t task;
+  SemaphoreHandle_t lock;
+  // Terminal replies, drain task -> mp_task; same free-running scheme.
+  char reply[VT_REPLY_SIZE];
+  volatile uint32_t reply_head; // drain task only
+  volatile uint32_t reply_tail; // mp_task only
+} vt_async;
+
+static inline void vt_lock(void) {
+  if (vt_async.task)
+    xSemaphoreTake(vt_async.lock, portMAX_DELAY);
+}
+
+static inline void vt_unlock(void) {
+  if (vt_async.task)
+    xSemaphoreGive(vt_async.lock);
+}
+
+// Virtual consoles -- VT(..., consoles=n).
+//
+// Each console is a whole Term of its own (grid, scrollback, parser), so
+// an SSH session and an IRC client can both keep running with only one
+// of them on the panel. st.c's `term` is whichever tcur points at: always
+// the front console, tfront, except for the span of a twrite() into
+// another one, which vt_lock() covers. A console in the background only
+// ever updates its own cells and dirty flags -- xscroll() declines, and
+// draw() only ever sees tfront -- so it costs no SPI traffic at all until
+// vt_console_switch() brings it forward and every row is repainted.
+//
+// Console 0 is the VT itself: write(), dupterm, async_write and
+// record() all go there. vt.console(n) hands out a stream for the others.
+#define VT_MAX_CONSOLES 8
+
+static Term *vt_cons[VT_MAX_CONSOLES];
+static int vt_ncons = 1;
+static int vt_front = 0;
+
+static uint32_t vt_ring_used(void) {
+  return __atomic_load_n(&vt_async.head, __ATOMIC_ACQUIRE) -
+         __atomic_load_n(&vt_async.tail, __ATOMIC_ACQUIRE);
+}
+
+static void vt_drain_task(void *arg) {
+  static char chunk[VT_DRAIN_CHUNK];
+  jmp_buf fail;
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    uint32_t used;
+    while ((used = vt_ring_used()) > 0) {
+      uint32_t tail = vt_async.tail;
+      uint32_t head = tail + used;
+      uint32_t n = used < sizeof(chunk) ? used : sizeof(chunk);
+      uint32_t off = tail & (VT_RING_SIZE - 1);
+      uint32_t first = VT_RING_SIZE - off;
+      if (first > n)
+        first = n;
+      memcpy(chunk, vt_async.buf + off, first);
+      memcpy(chunk + first, vt_async.buf, n - first);
+
+      xSemaphoreTake(vt_async.lock, portMAX_DELAY);
+      tcur = vt_cons[0];
+      int done;
+      if (setjmp(fail) == 0) {
+        tdiejmp = &fail;
+        done = twrite(chunk, n, 0);
+      } else {
+        done = n; // out of memory somewhere in the parser: drop the chunk
+      }
+      tdiejmp = NULL;
+      tcur = tfront;
+      xSemaphoreGive(vt_async.lock);
+
+      // twrite() leaves a trailing partial UTF-8 sequence unconsumed --
+      // keep it in the ring until the rest of it arrives.
+      if (done == 0) {
+        vt_async.stalled_head = head;
+        vt_async.stalled = true;
+        break;
+      }
+      vt_async.stalled = false;
+      __atomic_store_n(&vt_async.tail, tail + done, __ATOMIC_RELEASE);
+    }
+  }
+}
+
+// Blocks until the drain task has parsed everything queued so far. Layout
+// changes call this first, so output written before them is parsed at
+// the old geometry, same as with the synchronous path. A stall only
+// counts if nothing was queued since: bytes that complete the sequence
+// may already be waiting for the task.
+static void vt_async_flush(void) {
+  if (!vt_async.task)
+    return;
+  while (vt_ring_used() > 0 &&
+         !(vt_async.stalled &&
+           vt_async.stalled_head ==
+               __atomic_load_n(&vt_async.head, __ATOMIC_ACQUIRE))) {
+    xTaskNotifyGive(vt_async.task);
+    vTaskDelay(1);
+  }
+}
+
+// Defined in modules/tdeck_kvm/tdeck_kvm.c - pushes bytes into the KVM input
+// ring buffer that kvm_read() drains before the hardware keyboard.
+extern void internal_inject_n(const char *data, size_t len);
+
+// Called from st.c's ttywrite() with a terminal reply. On mp_task it goes
+// straight into the KVM's input; on the drain task it waits in
+// vt_async.reply (dropped if that's full, as the KVM ring would) until
+// mp_task next reads its input.
+void xreply(const char *s, size_t n) {
+  if (!vt_async.task || xTaskGetCurrentTaskHandle() != vt_async.task) {
+    internal_inject_n(s, n);
+    return;
+  }
+  uint32_t head = vt_async.reply_head;
+  uint32_t space = VT_REPLY_SIZE - (head - __atomic_load_n(&vt_async.reply_tail,
+                                                           __ATOMIC_ACQUIRE));
+  if (n > space)
+    return;
+  for (size_t i = 0; i < n; i++)
+    vt_async.reply[(head + i) & (VT_REPLY_SIZE - 1)] = s[i];
+  __atomic_store_n(&vt_async.reply_head, head + n, __ATOMIC_RELEASE);
+}
+
+// Moves replies the drain task produced into the KVM's input. Not static:
+// tdeck_kvm.c calls it on mp_task before serving or polling that input.
+void vt_reply_pump(void) {
+  uint32_t tail = vt_async.reply_tail;
+  uint32_t head = __atomic_load_n(&vt_async.reply_head, __ATOMIC_ACQUIRE);
+  while (tail != head) {
+    uint32_t off = tail & (VT_REPLY_SIZE - 1);
+    uint32_t n = head - tail;
+    if (n > VT_REPLY_SIZE - off)
+      n = VT_REPLY_SIZE - off;
+    internal_inject_n(vt_async.reply + off, n);
+    tail += n;
+  }
+  __atomic_store_n(&vt_async.reply_tail, tail, __ATOMIC_RELEASE);
+}
+
+static void vt_async_start(void) {
+  if (!vt_async.buf) {
+    vt_async.buf = heap_caps_malloc(VT_RING_SIZE, MALLOC_CAP_INTERNAL |
+                                                      MALLOC_CAP_8BIT);
+    if (!vt_async.buf)
+      mp_raise_msg(&mp_type_MemoryError,
+                   MP_ERROR_TEXT("vt: no memory for write ring"));
+  }
+  if (!vt_async.lock) {
+    vt_async.lock = xSemaphoreCreateMutex();
+    if (!vt_async.lock)
+      mp_raise_msg(&mp_type_RuntimeError,
+                   MP_ERROR_TEXT("vt: failed to create lock"));
+  }
+  if (!vt_async.task) {
+    BaseType_t ok = xTaskCreatePinnedToCore(
+        vt_drain_task, "vtwrite", VT_TASK_STACK_BYTES, NULL, VT_TASK_PRIORITY,
+        &vt_async.task, !MP_TASK_COREID /* off MicroPython's core */);
+    if (ok != pdPASS) {
+      vt_async.task = NULL;
+      mp_raise_msg(&mp_type_RuntimeError,
+                   MP_ERROR_TEXT("failed to start vt write task"));
+    }
+  }
+  vt_async.enabled = true;
+}
+
+// Queues as much of buf as fits, returns the number of bytes taken.
+static size_t vt_ring_put(const char *buf, size_t size) {
+  uint32_t head = vt_async.head;
+  uint32_t space = VT_RING_SIZE - vt_ring_used();
+  uint32_t n = size < space ? size : space;
+  uint32_t off = head & (VT_RING_SIZE - 1);
+  uint32_t first = VT_RING_SIZE - off;
+  if (first > n)
+    first = n;
+  memcpy(vt_async.buf + off, buf, first);
+  memcpy(vt_async.buf, buf + first, n - first);
+  __atomic_store_n(&vt_async.head, head + n, __ATOMIC_RELEASE);
+  if (n)
+    xTaskNotifyGive(vt_async.task);
+  return n;
+}
+
+static void vt_record_bytes(const char *buf, size_t size);
+
 static void vt_internal_write(const char *buf, size_t size) {
+  // No VT (a VT() that failed tears its consoles down): nowhere to put it.
+  if (!current_vt_obj)
+    return;
+  if (current_vt_obj->rec_file != MP_OBJ_NULL)
+    vt_record_bytes(buf, size);
+
+  if (vt_async.enabled) {
+    // A full ring means the parser is behind: wait for it rather than
+    // drop output. Callers that must not block check MP_STREAM_POLL
+    // (select/poll on the VT) first. Only yield while waiting -- this is
+    // also dupterm's write path, where running pending callbacks or
+    // raising a KeyboardInterrupt would land in the middle of a print()
+    // (or of printing the traceback of one); the drain task needs no
+    // help from mp_task to empty the ring.
+    for (;;) {
+      size_t n = vt_ring_put(buf, size);
+      buf += n;
+      size -= n;
+      if (size == 0)
+        break;
+      vTaskDelay(1);
+    }
+    return;
+  }
+
+  vt_lock();
+  tcur = vt_cons[0];
   twrite(buf, size, 0);
+  tcur = tfront;
+  vt_unlock();
   if (size > 64)
     vTaskDelay(1);
 }
 
+// Brings console n to the front. Returns the one that was there, or -1
+// if there's no console n. Not static: tdeck_kvm.c's console key calls
+// it, the same way xreply() reaches into tdeck_kvm.c for internal_inject_n().
+int vt_console_switch(int n) {
+  if (n < 0 || n >= vt_ncons)
+    return -1;
+
+  vt_lock();
+  int prev = vt_front;
+  if (n != prev) {
+    // Change generations are per Term; carry the newest forward so no
+    // consumer's changed_since() token looks newer than the new console.
+    uint32_t gen = term.gen, bargen[2] = {term.bargen[0], term.bargen[1]};
+    vt_front = n;
+    tfront = tcur = vt_cons[n];
+    term.damaged = 0; // whatever it was, the repaint below re-marks it
+    if ((int32_t)(gen - term.gen) > 0)
+      term.gen = gen;
+    memcpy(term.bargen, bargen, sizeof(bargen));
+
+    // The panel still shows the old console, possibly scrolled in GRAM.
+    vscroll_reset();
+    tfullredraw();
+    tgenbump(0, term.row - 1);
+  }
+  vt_unlock();
+  return prev;
+}
+
+// Releases every console, for a VT() that failed part way: nothing is
+// left to draw them, and vt_internal_write() drops output until the next
+// VT() succeeds. Under vt_lock().
+static void vt_cons_teardown(void) {
+  for (int i = 0; i < VT_MAX_CONSOLES; i++) {
+    if (vt_cons[i]) {
+      tcur = vt_cons[i];
+      tfree();
+    }
+  }
+  vt_ncons = 1;
+  vt_front = 0;
+  tfront = tcur = vt_cons[0];
+}
+
+static void vt_console_write(int n, const char *buf, size_t size) {
+  if (n == 0) {
+    vt_internal_write(buf, size);
+    return;
+  }
+  vt_lock();
+  tcur = vt_cons[n];
+  twrite(buf, size, 0);
+  tcur = tfront;
+  vt_unlock();
+}
+
+// Direct grid access -- see tgridput() in st.c.
+//
+// vttui's widgets are drawn on this same device, so rather than format
+// CSI sequences into mp_hal_stdout_tx_strn() -- dupterm, kvm_write(),
+// twrite() and csiparse() -- they call the tgrid*() functions on console
+// 0 between vt_direct_begin() and vt_direct_end(). That only works while
+// the terminal is the sole consumer of the output: with a KVM mirror
+// (sshd) attached, or a recording running, the byte stream itself is
+// what's wanted, and begin returns false so the caller sends ANSI as
+// before. Not static, for vttui.c.
+extern bool internal_mirror_attached(void);
+
+bool vt_direct_begin(void) {
+  if (!current_vt_obj || current_vt_obj->rec_file != MP_OBJ_NULL ||
+      internal_mirror_attached())
+    return false;
+  // Anything still queued for the drain task was written before this.
+  vt_async_flush();
+  vt_lock();
+  tcur = vt_cons[0];
+  return true;
+}
+
+void vt_direct_end(void) {
+  tcur = tfront;
+  vt_unlock();
+}
+
+// vt.console(n) -> a writable stream for console n, for an app that
+// should keep running off-screen: print(..., file=con) or con.write().
+typedef struct {
+  mp_obj_base_t base;
+  int index;
+} vt_Console_obj_t;
+
+static mp_uint_t vt_Console_write(mp_obj_t self_in, const void *buf,
+                                  mp_uint_t size, int *errcode) {
+  vt_Console_obj_t *self = MP_OBJ_TO_PTR(self_in);
+  if (self->index >= vt_ncons) {
+    *errcode = MP_EIO; // the VT was recreated with fewer consoles
+    return MP_STREAM_ERROR;
+  }
+  vt_console_write(self->index, (const char *)buf, size);
+  return size;
+}
+
+static mp_uint_t vt_Console_ioctl(mp_obj_t self_in, mp_uint_t request,
+                                  uintptr_t arg, int *errcode) {
+  vt_Console_obj_t *self = MP_OBJ_TO_PTR(self_in);
+  if (request == MP_STREAM_POLL) {
+    // Writes to console 0 share the VT's async ring; the rest are
+    // parsed inline and never block.
+    if (self->index == 0 && vt_async.enabled &&
+        vt_ring_used() >= VT_RING_SIZE)
+      return 0;
+    return arg & MP_STREAM_POLL_WR;
+  } else if (request == MP_STREAM_CLOSE) {
+    return 0;
+  }
+  *errcode = MP_EINVAL;
+  return MP_STREAM_ERROR;
+}
+
+static const mp_stream_p_t vt_Console_stream_p = {
+    .write = vt_Console_write,
+    .ioctl = vt_Console_ioctl,
+    .is_text = true,
+};
+
+static const mp_rom_map_elem_t vt_Console_locals_dict_table[] = {
+    {MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&mp_stream_write_obj)},
+    {MP_ROM_QSTR(MP_QSTR_ioctl), MP_ROM_PTR(&mp_stream_ioctl_obj)},
+};
+static MP_DEFINE_CONST_DICT(vt_Console_locals_dict,
+                            vt_Console_locals_dict_table);
+
+static MP_DEFINE_CONST_OBJ_TYPE(vt_Console_type, MP_QSTR_Console,
+                                MP_TYPE_FLAG_NONE, protocol,
+                                &vt_Console_stream_p, locals_dict,
+                                &vt_Console_locals_dict);
+
+static mp_obj_t vt_VT_console(mp_obj_t self_in, mp_obj_t n_obj) {
+  int n = mp_obj_get_int(n_obj);
+  if (n < 0 || n >= vt_ncons)
+    mp_raise_ValueError(MP_ERROR_TEXT("no such console"));
+  vt_Console_obj_t *con = mp_obj_malloc(vt_Console_obj_t, &vt_Console_type);
+  con->index = n;
+  return MP_OBJ_FROM_PTR(con);
+}
+MP_DEFINE_CONST_FUN_OBJ_2(vt_VT_console_obj, vt_VT_console);
+
+// vt.switch([n]) -> the console on screen, after bringing n forward if
+// given. draw() repaints it in full on the next tick.
+static mp_obj_t vt_VT_switch(size_t n_args, const mp_obj_t *args) {
+  if (n_args > 1 && vt_console_switch(mp_obj_get_int(args[1])) < 0)
+    mp_raise_ValueError(MP_ERROR_TEXT("no such console"));
+  return MP_OBJ_NEW_SMALL_INT(vt_front);
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(vt_VT_switch_obj, 1, 2, vt_VT_switch);
+
 static mp_uint_t vt_read(mp_obj_t self_in, void *buf, mp_uint_t size,
                          int *errcode) {
   *errcode = MP_EAGAIN;
@@ -50,8 +487,11 @@ static mp_uint_t vt_write(mp_obj_t self_in, const void *buf, mp_uint_t size,
 static mp_uint_t vt_ioctl(mp_obj_t self_in, mp_uint_t request, uintptr_t arg,
                           int *errcode) {
   if (request == MP_STREAM_POLL) {
-    // We are always writable, but never readable (for now)
-    return MP_STREAM_POLL_WR;
+    // Never readable (for now). Writable unless async_write's ring is
+    // full, in which case a write would block until the parser catches up.
+    if (vt_async.enabled && vt_ring_used() >= VT_RING_SIZE)
+      return 0;
+    return arg & MP_STREAM_POLL_WR;
   } else if (request == MP_STREAM_CLOSE) {
     return 0;
   }
@@ -78,20 +518,122 @@ static mp_obj_t vt_VT_write(mp_obj_t self_in, mp_obj_t arg) {
 MP_DEFINE_CONST_FUN_OBJ_2(vt_VT_write_obj, vt_VT_write);
 
 static mp_obj_t vt_VT_draw(mp_obj_t self_in) {
+  vt_lock();
   draw();
+  vt_unlock();
   vTaskDelay(1);
   return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(vt_VT_draw_obj, vt_VT_draw);
 
+// Event-driven drawing -- vt.autodraw(latency_ms).
+//
+// Instead of the app calling draw() on a fixed timer, whether or not
+// anything changed, the first damage after a draw() (st.c's
+// tsetdirtspan() -> xdamage()) arms a one-shot esp_timer latency_ms out,
+// and its expiry schedules one draw() on mp_task -- the only task that
+// may touch the SPI bus, see vt_async above. Output landing within the
+// window is coalesced into that one frame; a burst longer than the
+// window gets a frame every latency_ms; an idle terminal arms nothing
+// and never wakes up.
+static struct {
+  esp_timer_handle_t timer;
+  uint32_t latency_us; // 0 = off: draw() is up to the app
+  volatile bool armed; // timer running or draw scheduled
+} vt_sched;
+
+static mp_obj_t vt_sched_draw(mp_obj_t arg) {
+  // Cleared before draw(): damage from here on needs a frame of its own.
+  vt_sched.armed = false;
+  vt_lock();
+  draw();
+  vt_unlock();
+  return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(vt_sched_draw_obj, vt_sched_draw);
+
+static void vt_sched_fire(void *arg) {
+  // The schedule queue is shared with every other micropython.schedule()
+  // user; if it's full, try again a window later rather than lose the
+  // frame.
+  if (!mp_sched_schedule(MP_OBJ_FROM_PTR(&vt_sched_draw_obj), mp_const_none))
+    esp_timer_start_once(vt_sched.timer, vt_sched.latency_us);
+}
+
+// Called from st.c (on mp_task or the async drain task, always under
+// vt_lock()) on the first damage since draw().
+void xdamage(void) {
+  if (!vt_sched.latency_us || vt_sched.armed)
+    return;
+  vt_sched.armed = true;
+  esp_timer_start_once(vt_sched.timer, vt_sched.latency_us);
+}
+
+#if VT_PACKED_GLYPH
+// Called from st.c's tcolorreclaim(), under vt_lock(): marks every
+// truecolor slot still in use, by any console or either status bar.
+void xcolormark(void) {
+  Term *t = tcur;
+  int i;
+
+  for (i = 0; i < VT_MAX_CONSOLES; i++) {
+    if (vt_cons[i]) {
+      tcur = vt_cons[i];
+      tcolormarkterm();
+    }
+  }
+  tcur = t;
+  tcolormark(top_line_now, 256);
+  tcolormark(top_line_last, 256);
+  tcolormark(bot_line_now, 256);
+  tcolormark(bot_line_last, 256);
+}
+#endif
+
+// vt.autodraw(latency_ms) -- 0 turns it off again. 8-16 ms keeps a
+// keystroke under a frame's worth of delay while still batching the
+// many small writes a TUI redraw is made of.
+static mp_obj_t vt_VT_autodraw(mp_obj_t self_in, mp_obj_t latency_obj) {
+  mp_int_t ms = mp_obj_get_int(latency_obj);
+  if (ms < 0 || ms > 1000)
+    mp_raise_ValueError(MP_ERROR_TEXT("latency out of range"));
+
+  if (!vt_sched.timer) {
+    const esp_timer_create_args_t args = {
+        .callback = vt_sched_fire,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "vtdraw",
+    };
+    if (esp_timer_create(&args, &vt_sched.timer) != ESP_OK)
+      mp_raise_msg(&mp_type_RuntimeError,
+                   MP_ERROR_TEXT("vt: failed to create draw timer"));
+  }
+
+  vt_lock();
+  esp_timer_stop(vt_sched.timer);
+  vt_sched.armed = false;
+  vt_sched.latency_us = ms * 1000;
+  // Anything already waiting would otherwise sit there until the next
+  // write.
+  if (term.damaged)
+    xdamage();
+  vt_unlock();
+  return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_2(vt_VT_autodraw_obj, vt_VT_autodraw);
+
 static mp_obj_t vt_VT_scrollup(mp_obj_t self_in) {
+  vt_lock();
   kscrollup(&(const Arg){.i = -1});
+  vt_unlock();
   return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(vt_VT_scrollup_obj, vt_VT_scrollup);
 
 static mp_obj_t vt_VT_scrolldown(mp_obj_t self_in) {
+  vt_lock();
   kscrolldown(&(const Arg){.i = -1});
+  vt_unlock();
   return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(vt_VT_scrolldown_obj, vt_VT_scrolldown);
@@ -99,54 +641,62 @@ MP_DEFINE_CONST_FUN_OBJ_1(vt_VT_scrolldown_obj, vt_VT_scrolldown);
 static mp_obj_t vt_vt_top_offset(mp_obj_t self_in, mp_obj_t offset_obj) {
   int offset = mp_obj_get_int(offset_obj);
 
-  // Update the offset in the terminal engine
-  term.top_offset = offset;
+  vt_async_flush();
+  vt_lock();
 
-  // Mark lines dirty so they move to the new position on next draw()
-  for (int i = 0; i < term.row; i++) {
-    term.dirty[i] = 1;
-  }
+  // Update the offset in the terminal engine. Any hardware scroll was
+  // defined around the old offset, so drop it -- every row is repainted
+  // below anyway.
+  vscroll_reset();
+  for (int i = 0; i < vt_ncons; i++)
+    vt_cons[i]->top_offset = offset;
+
+  // Every line is repainted at its new position on next draw() -- the
+  // glyphs didn't change, so this has to bypass drawregion()'s diff.
+  tfullredraw();
 
   // Called after update_layout()/tresize() on both initial boot and
   // every runtime font change (see main.py's update_font()), so
   // term.row is already current here -- this is the one place term.row
   // and term.top_offset are both guaranteed fresh together.
   fill_bottom_margin();
+  vt_unlock();
 
   return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_2(vt_vt_top_offset_obj, vt_vt_top_offset);
 
-// Top Bar Bridge
-// Optimized Top Bar Bridge - Accepts String, Bytes, or Bytearray
-static mp_obj_t vt_vt_top_bar(mp_obj_t self_in, mp_obj_t str_obj) {
+// The text a bar is given: str, bytes or bytearray. Converted before
+// vt_lock() -- anything else raises TypeError, which mustn't happen with
+// the lock held.
+static const char *bar_text(mp_obj_t str_obj, size_t *len) {
   mp_buffer_info_t bufinfo;
   if (mp_get_buffer(str_obj, &bufinfo, MP_BUFFER_READ)) {
-    draw_bar_ansi((const char *)bufinfo.buf, bufinfo.len, -1);
-  } else {
-    size_t len;
-    const char *txt = mp_obj_str_get_data(str_obj, &len);
-    draw_bar_ansi(txt, len, -1);
+    *len = bufinfo.len;
+    return (const char *)bufinfo.buf;
   }
+  return mp_obj_str_get_data(str_obj, len);
+}
+
+// Top Bar Bridge
+// Optimized Top Bar Bridge - Accepts String, Bytes, or Bytearray
+static mp_obj_t vt_vt_top_bar(mp_obj_t self_in, mp_obj_t str_obj) {
+  size_t len;
+  const char *txt = bar_text(str_obj, &len);
+  vt_lock();
+  draw_bar_ansi(txt, len, -1);
+  vt_unlock();
   return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_2(vt_vt_top_bar_obj, vt_vt_top_bar);
 
 // Bottom Bar Bridge
 static mp_obj_t vt_vt_bottom_bar(mp_obj_t self_in, mp_obj_t str_obj) {
-  mp_buffer_info_t bufinfo;
-
-  // Check if the object supports the buffer protocol (bytes, bytearray, etc.)
-  if (mp_get_buffer(str_obj, &bufinfo, MP_BUFFER_READ)) {
-    // Use raw bytes directly from the bytearray/bytes object
-    draw_bar_ansi((const char *)bufinfo.buf, bufinfo.len, -2);
-  } else {
-    // Fallback for strings
-    size_t len;
-    const char *txt = mp_obj_str_get_data(str_obj, &len);
-    draw_bar_ansi(txt, len, -2);
-  }
-
+  size_t len;
+  const char *txt = bar_text(str_obj, &len);
+  vt_lock();
+  draw_bar_ansi(txt, len, -2);
+  vt_unlock();
   return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_2(vt_vt_bottom_bar_obj, vt_vt_bottom_bar);
@@ -169,7 +719,9 @@ MP_DEFINE_CONST_FUN_OBJ_1(vt_vt_bottom_bar_invalidate_obj,
 
 // Force repaint of bars to LCD regardless of dirty state
 static mp_obj_t vt_vt_repaint_bars(mp_obj_t self_in) {
+  vt_lock();
   repaint_bars();
+  vt_unlock();
   return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(vt_vt_repaint_bars_obj, vt_vt_repaint_bars);
@@ -184,12 +736,33 @@ static const mp_stream_p_t vt_stream_p = {
 //  Class Definition ---
 
 // Constructor: vt.VT()
-// Constructor: vt.VT(tft, env)
+// Constructor: vt.VT(tft, env, scrollback=HISTSIZE, async_write=False)
+//
+// scrollback is in lines, kept compressed in PSRAM (see hist.c); 0
+// disables it. async_write=True moves parsing onto its own task, see
+// vt_async above.
 static mp_obj_t vt_VT_make_new(const mp_obj_type_t *type, size_t n_args,
-                               size_t n_kw, const mp_obj_t *args) {
-  // Expect exactly 2 positional arguments: display driver and environment
-  // object
-  mp_arg_check_num(n_args, n_kw, 2, 2, false);
+                               size_t n_kw, const mp_obj_t *all_args) {
+  enum { ARG_tft, ARG_env, ARG_scrollback, ARG_async_write, ARG_consoles };
+  static const mp_arg_t allowed_args[] = {
+      {MP_QSTR_tft, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL}},
+      {MP_QSTR_env, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL}},
+      {MP_QSTR_scrollback, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = HISTSIZE}},
+      {MP_QSTR_async_write, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false}},
+      {MP_QSTR_consoles, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 1}},
+  };
+  mp_arg_val_t parsed[MP_ARRAY_SIZE(allowed_args)];
+  mp_arg_parse_all_kw_array(n_args, n_kw, all_args,
+                            MP_ARRAY_SIZE(allowed_args), allowed_args, parsed);
+  mp_obj_t args[2] = {parsed[ARG_tft].u_obj, parsed[ARG_env].u_obj};
+  mp_int_t scrollback = parsed[ARG_scrollback].u_int;
+  if (scrollback < 0 || scrollback > 0xFFFFFF) {
+    mp_raise_ValueError(MP_ERROR_TEXT("scrollback out of range"));
+  }
+  mp_int_t nconsoles = parsed[ARG_consoles].u_int;
+  if (nconsoles < 1 || nconsoles > VT_MAX_CONSOLES) {
+    mp_raise_ValueError(MP_ERROR_TEXT("consoles out of range"));
+  }
 
   vt_VT_obj_t *self = m_new_obj(vt_VT_obj_t);
   self->base.type = &vt_VT_type;
@@ -208,15 +781,87 @@ static mp_obj_t vt_VT_make_new(const mp_obj_type_t *type, size_t n_args,
   mp_obj_t rows_obj = mp_load_attr(env_obj, MP_QSTR_rows);
   int rows = mp_obj_get_int(rows_obj);
 
-  mp_obj_t font_obj = mp_load_attr(env_obj, MP_QSTR_font);
-  self->font = (mp_obj_module_t *)MP_OBJ_TO_PTR(font_obj);
-  self->icon_font = NULL; // no iconic font paired in by default
+  self->font = mp_load_attr(env_obj, MP_QSTR_font);
+  self->icon_font = MP_OBJ_NULL; // no iconic font paired in by default
+  memset(&self->font_desc, 0, sizeof(self->font_desc));
+  memset(&self->icon_font_desc, 0, sizeof(self->icon_font_desc));
+  vt_font_compile(&self->font_desc, self->font, true);
+  memset(&self->glyph_cache, 0, sizeof(self->glyph_cache));
+  memset(&self->hot_glyphs, 0, sizeof(self->hot_glyphs));
+  self->rec_file = MP_OBJ_NULL;
+  vt_glyph_cache_reset(&self->glyph_cache, self->font_desc.width,
+                       self->font_desc.height);
 
-  // Initialize the terminal grid engine with the extracted dimensions
-  tnew(cols, rows);
+  // A previous async VT may still be parsing into `term` -- let it
+  // finish, and stop routing writes through the ring unless this one
+  // asks for it too.
+  vt_async_flush();
+  vt_async.enabled = false;
 
-  current_vt_obj = self;
+  // Initialize the terminal grid engine with the extracted dimensions,
+  // once per console. tnew() wipes `term`, so release whatever a previous
+  // VT left in each one first. Consoles it had beyond nconsoles are
+  // freed too; the Terms themselves are kept for the next VT.
+  //
+  // The previous VT loses its grid here, so it stops being current_vt_obj
+  // right away; this one only becomes it once nothing below can fail --
+  // an object that raises out of its constructor is never returned, and
+  // draw(), the autodraw timer and vttui would be left holding it.
+  vt_lock();
+  current_vt_obj = NULL;
+  if (!vt_cons[0])
+    vt_cons[0] = tcur;
+  bool cons_ok = true, hist_ok = true;
+  nlr_buf_t nlr;
+  if (nlr_push(&nlr) == 0) {
+    for (int i = 0; i < VT_MAX_CONSOLES; i++) {
+      if (!vt_cons[i] && i < nconsoles &&
+          !(vt_cons[i] = calloc(1, sizeof(Term))))
+        cons_ok = false;
+      if (!vt_cons[i])
+        continue;
+      tcur = vt_cons[i];
+      tfree();
+      if (i < nconsoles) {
+        tnew(cols, rows); // raises (die()) if tresize() runs out
+        hist_ok &= thistsetup(scrollback);
+      }
+    }
+    nlr_pop();
+  } else {
+    vt_cons_teardown();
+    vt_unlock();
+    nlr_jump(nlr.ret_val);
+  }
+  if (!cons_ok || !hist_ok) {
+    vt_cons_teardown();
+    vt_unlock();
+    if (!cons_ok) {
+      mp_raise_msg(&mp_type_MemoryError,
+                   MP_ERROR_TEXT("vt: no memory for consoles"));
+    }
+    mp_raise_msg(&mp_type_MemoryError,
+                 MP_ERROR_TEXT("vt: no memory for scrollback"));
+  }
+  vt_ncons = nconsoles;
+  vt_front = 0;
+  tfront = tcur = vt_cons[0];
+  vscroll_reset();
+  vt_unlock();
+
+  if (parsed[ARG_async_write].u_bool) {
+    if (nlr_push(&nlr) == 0) {
+      vt_async_start();
+      nlr_pop();
+    } else {
+      vt_lock();
+      vt_cons_teardown();
+      vt_unlock();
+      nlr_jump(nlr.ret_val);
+    }
+  }
 
+  current_vt_obj = self;
   return MP_OBJ_FROM_PTR(self);
 }
 
@@ -225,12 +870,42 @@ static mp_obj_t vt_VT_update_layout(size_t n_args, const mp_obj_t *args) {
   vt_VT_obj_t *self = MP_OBJ_TO_PTR(args[0]);
 
   mp_obj_t font_obj = args[1];
-  self->font = (mp_obj_module_t *)MP_OBJ_TO_PTR(font_obj);
-
   int cols = mp_obj_get_int(args[2]);
   int rows = mp_obj_get_int(args[3]);
 
-  tresize(cols, rows);
+  // vt_async.lock is a plain mutex: nothing may raise while it's held, or
+  // it stays taken and the next vt_lock() hangs mp_task and the drain
+  // task both. So the font is compiled (which raises on a bad module)
+  // before taking it, and only swapped in under it.
+  vt_font_t desc;
+  memset(&desc, 0, sizeof(desc));
+  vt_font_compile(&desc, font_obj, true);
+
+  vt_async_flush();
+  vt_lock();
+  vt_font_release(&self->font_desc);
+  self->font = font_obj;
+  self->font_desc = desc;
+  vt_glyph_cache_reset(&self->glyph_cache, self->font_desc.width,
+                       self->font_desc.height);
+  vt_hot_glyphs_reset(&self->hot_glyphs);
+
+  vscroll_reset();
+  // tresize() allocates, and raises (die()) when it can't.
+  nlr_buf_t nlr;
+  if (nlr_push(&nlr) == 0) {
+    for (int i = 0; i < vt_ncons; i++) {
+      tcur = vt_cons[i];
+      tresize(cols, rows);
+    }
+    nlr_pop();
+  } else {
+    tcur = tfront;
+    vt_unlock();
+    nlr_jump(nlr.ret_val);
+  }
+  tcur = tfront;
+  vt_unlock();
 
   return mp_const_none;
 }
@@ -239,15 +914,27 @@ static mp_obj_t vt_VT_update_layout(size_t n_args, const mp_obj_t *args) {
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(vt_VT_update_layout_obj, 4, 4,
                                     vt_VT_update_layout);
 
-// VT.set_icon_font(font_module_or_none) -- independent of the main font/
-// layout (see update_layout()). Pass None to clear it. Doesn't touch
-// cols/rows: an iconic font only ever supplies WIDE_FONT glyph data for
-// ATTR_WIDE codepoints (see fb.c's xdrawline()), never the main grid.
+// VT.set_icon_font(font_or_none) -- a font module or vt.Font, independent
+// of the main font/layout (see update_layout()). Pass None to clear it.
+// Doesn't touch cols/rows: an iconic font only ever supplies WIDE_FONT
+// glyph data for ATTR_WIDE codepoints (see fb.c's xdrawline()), never the
+// main grid.
 static mp_obj_t vt_VT_set_icon_font(mp_obj_t self_in, mp_obj_t font_obj) {
   vt_VT_obj_t *self = MP_OBJ_TO_PTR(self_in);
-  self->icon_font = (font_obj == mp_const_none)
-                        ? NULL
-                        : (mp_obj_module_t *)MP_OBJ_TO_PTR(font_obj);
+  font_obj = (font_obj == mp_const_none) ? MP_OBJ_NULL : font_obj;
+
+  // Compiled outside the lock, as in update_layout().
+  vt_font_t desc;
+  memset(&desc, 0, sizeof(desc));
+  vt_font_compile(&desc, font_obj, false);
+
+  vt_lock();
+  vt_font_release(&self->icon_font_desc);
+  self->icon_font = font_obj;
+  self->icon_font_desc = desc;
+  vt_hot_glyphs_reset(&self->hot_glyphs);
+  tfullredraw();
+  vt_unlock();
   return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_2(vt_VT_set_icon_font_obj, vt_VT_set_icon_font);
@@ -263,11 +950,14 @@ MP_DEFINE_CONST_FUN_OBJ_2(vt_VT_set_icon_font_obj, vt_VT_set_icon_font);
 // This is render_row_rgb565() (fb.c) exposed to Python with no SPI/
 // display side effects at all -- for pulling the exact same pixels a
 // screen redraw would produce, without touching the physical screen.
-// e.g. a VNC server walking term.dirty[] for changed rows.
+// e.g. a VNC server re-sending the rows changed_since() reports.
 static mp_obj_t vt_VT_render_row(mp_obj_t self_in, mp_obj_t y_obj,
                                  mp_obj_t buf_obj) {
   int y = mp_obj_get_int(y_obj);
+  mp_buffer_info_t bufinfo;
+  mp_get_buffer_raise(buf_obj, &bufinfo, MP_BUFFER_WRITE);
 
+  vt_lock();
   Line ln;
   if (y == -1) {
     ln = top_line_now;
@@ -276,25 +966,504 @@ static mp_obj_t vt_VT_render_row(mp_obj_t self_in, mp_obj_t y_obj,
   } else if (y >= 0 && y < term.row) {
     ln = TLINE(y);
   } else {
+    vt_unlock();
     return mp_obj_new_int(0);
   }
 
-  mp_buffer_info_t bufinfo;
-  mp_get_buffer_raise(buf_obj, &bufinfo, MP_BUFFER_WRITE);
-
   row_render_t r = render_row_rgb565(ln, 0, y, term.col,
                                      (uint16_t *)bufinfo.buf,
                                      bufinfo.len / sizeof(uint16_t));
+  vt_unlock();
   return mp_obj_new_int((mp_int_t)(r.pixel_count * 2));
 }
 MP_DEFINE_CONST_FUN_OBJ_3(vt_VT_render_row_obj, vt_VT_render_row);
 
+// vt.changed_since(token) -> (token, [y, ...]). The rows whose content
+// changed since `token` was handed out, in render_row()'s numbering (-1
+// = top bar, 0..rows-1, -2 = bottom bar), plus the token to pass next
+// time. None reports every row -- what a new consumer needs for its
+// first full paint.
+//
+// Every change stamps its row with a new generation from a single
+// counter (st.c's term.rowgen[], see tgenbump()), so any number of
+// consumers -- a VNC client, the web viewer -- can track damage
+// independently, each with its own token, without re-rendering rows to
+// compare them or clearing the dirty bits the LCD's own draw() relies on.
+static mp_obj_t vt_VT_changed_since(mp_obj_t self_in, mp_obj_t token_obj) {
+  bool all = (token_obj == mp_const_none);
+  uint32_t token = all ? 0 : (uint32_t)mp_obj_get_int_truncated(token_obj);
+
+  // Wrap-safe "newer than token": the counter is 32 bits and never reset.
+#define CHANGED(g) (all || (int32_t)((g) - token) > 0)
+
+  // Small ints don't allocate; the list is only built after the lock is
+  // released -- allocating can raise, and must not with the lock held.
+  vt_lock();
+  mp_obj_t found[term.row + 2];
+  int n = 0;
+  uint32_t now = term.gen;
+  if (CHANGED(term.bargen[0]))
+    found[n++] = MP_OBJ_NEW_SMALL_INT(-1);
+  for (int y = 0; y < term.row; y++) {
+    if (CHANGED(term.rowgen[y]))
+      found[n++] = MP_OBJ_NEW_SMALL_INT(y);
+  }
+  if (CHANGED(term.bargen[1]))
+    found[n++] = MP_OBJ_NEW_SMALL_INT(-2);
+  vt_unlock();
+
+#undef CHANGED
+
+  mp_obj_t items[2] = {mp_obj_new_int_from_uint(now),
+                       mp_obj_new_list(n, found)};
+  return mp_obj_new_tuple(2, items);
+}
+MP_DEFINE_CONST_FUN_OBJ_2(vt_VT_changed_since_obj, vt_VT_changed_since);
+
+// Cell mode for remote viewers that draw the glyphs themselves (see
+// webvncd.py): the same rows changed_since() reports, as cells instead of
+// pixels.
+//
+// vt.cells(y, buffer) -> int bytes written. y as in render_row(); the
+// row's cells in encode_row_cells()'s format (fb.c). buffer must hold at
+// least 11 bytes per column plus 7 -- 0 is returned otherwise, or for a
+// row out of range.
+static mp_obj_t vt_VT_cells(mp_obj_t self_in, mp_obj_t y_obj,
+                            mp_obj_t buf_obj) {
+  int y = mp_obj_get_int(y_obj);
+  mp_buffer_info_t bufinfo;
+  mp_get_buffer_raise(buf_obj, &bufinfo, MP_BUFFER_WRITE);
+
+  size_t n = 0;
+  vt_lock();
+  if (y == -1) {
+    n = encode_row_cells(top_line_now, bufinfo.buf, bufinfo.len);
+  } else if (y == -2) {
+    n = encode_row_cells(bot_line_now, bufinfo.buf, bufinfo.len);
+  } else if (y >= 0 && y < term.row) {
+    n = encode_row_cells(TLINE(y), bufinfo.buf, bufinfo.len);
+  }
+  vt_unlock();
+  return mp_obj_new_int((mp_int_t)n);
+}
+MP_DEFINE_CONST_FUN_OBJ_3(vt_VT_cells_obj, vt_VT_cells);
+
+// vt.glyph(codepoint, flags, buffer) -> int bytes written. flags: 1 =
+// bold, 2 = wide. A 1bpp ink mask of the glyph the panel would draw, one
+// cell (two if wide) by one row; see render_glyph_mask().
+static mp_obj_t vt_VT_glyph(size_t n_args, const mp_obj_t *args) {
+  Rune u = mp_obj_get_int(args[1]);
+  int flags = mp_obj_get_int(args[2]);
+  mp_buffer_info_t bufinfo;
+  mp_get_buffer_raise(args[3], &bufinfo, MP_BUFFER_WRITE);
+
+  vt_lock();
+  size_t n = render_glyph_mask(u, flags & 1, flags & 2, bufinfo.buf,
+                               bufinfo.len);
+  vt_unlock();
+  return mp_obj_new_int((mp_int_t)n);
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(vt_VT_glyph_obj, 4, 4, vt_VT_glyph);
+
+// vt.cursor() -> (x, y, visible, style), style as in DECSCUSR.
+static mp_obj_t vt_VT_cursor(mp_obj_t self_in) {
+  vt_lock();
+  mp_obj_t items[4] = {
+      MP_OBJ_NEW_SMALL_INT(term.c.x),
+      MP_OBJ_NEW_SMALL_INT(term.c.y),
+      mp_obj_new_bool(cursor_visible()),
+      MP_OBJ_NEW_SMALL_INT(term.cursor_style),
+  };
+  vt_unlock();
+  return mp_obj_new_tuple(4, items);
+}
+MP_DEFINE_CONST_FUN_OBJ_1(vt_VT_cursor_obj, vt_VT_cursor);
+
+// Capture, for bug reports from field units and offline regression tests
+// of the renderer.
+//
+// vt.snapshot(path, format="png") writes what the screen shows -- top bar,
+// text rows (scrollback-aware, like the panel), bottom bar, and the
+// background showing through everywhere else -- to a file. "png" is 8-bit
+// RGB, "raw" is width * height big-endian RGB565 pixels, row-major, no
+// header. Pixels come from render_row_rgb565() one bar/text row at a
+// time into a single row-sized buffer, and go out one scanline at a time
+// -- nothing near a full frame is ever held, and the panel isn't read or
+// touched.
+//
+// Each row is rendered under the VT lock but written with it released
+// (file I/O can raise), so output arriving mid-snapshot can leave the
+// rows from slightly different moments -- never a half-rendered row.
+#define SNAP_NONE (-1000)
+
+static void snap_write(mp_obj_t file, const void *buf, size_t len) {
+  int err = 0;
+  if (mp_stream_write_exactly(file, buf, len, &err) != len)
+    mp_raise_OSError(err ? err : MP_EIO);
+}
+
+static void snap_put32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static void snap_png_chunk(mp_obj_t file, const char *type,
+                           const uint8_t *data, size_t len) {
+  uint8_t hdr[8], crc[4];
+  snap_put32(hdr, len);
+  memcpy(hdr + 4, type, 4);
+  mz_ulong c = mz_crc32(MZ_CRC32_INIT, hdr + 4, 4);
+  c = mz_crc32(c, data, len);
+  snap_put32(crc, c);
+  snap_write(file, hdr, 8);
+  if (len)
+    snap_write(file, data, len);
+  snap_write(file, crc, 4);
+}
+
+// tdefl output callback: each block of the zlib stream becomes an IDAT.
+static mz_bool snap_png_idat(const void *buf, int len, void *user) {
+  snap_png_chunk(*(mp_obj_t *)user, "IDAT", buf, len);
+  return MZ_TRUE;
+}
+
+static void snap_stream(mp_obj_t file, bool png, uint16_t *rowbuf,
+                        uint8_t *line, tdefl_compressor *zs) {
+  st7789_ST7789_obj_t *display = current_vt_obj->display_drv;
+  const int w = display->width, h = display->height;
+  const int fh = current_vt_obj->font_desc.height;
+
+  vt_lock();
+  const int top = term.top_offset, rows = term.row, cols = term.col;
+  bool top_bar = top >= fh;
+  bool bot_bar = false;
+  for (int x = 0; x < cols && !bot_bar; x++)
+    bot_bar = bot_line_now[x].u != 0;
+  vt_unlock();
+
+  if (png) {
+    static const uint8_t sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a,
+                                   '\n'};
+    uint8_t ihdr[13];
+    snap_put32(ihdr, w);
+    snap_put32(ihdr + 4, h);
+    ihdr[8] = 8;  // bits per channel
+    ihdr[9] = 2;  // RGB
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering (every row uses filter 0)
+    ihdr[12] = 0; // not interlaced
+    snap_write(file, sig, sizeof(sig));
+    snap_png_chunk(file, "IHDR", ihdr, sizeof(ihdr));
+  }
+
+  int band = SNAP_NONE - 1; // what rowbuf holds
+  for (int y = 0; y < h; y++) {
+    int want = SNAP_NONE, sub = 0;
+    if (bot_bar && y >= h - fh) {
+      want = -2;
+      sub = y - (h - fh);
+    } else if (top_bar && y < fh) {
+      want = -1;
+      sub = y;
+    } else if (y >= top && y < top + rows * fh) {
+      want = (y - top) / fh;
+      sub = (y - top) % fh;
+    }
+
+    if (want != band) {
+      row_render_t r = {0};
+      vt_lock();
+      if (want != SNAP_NONE && term.col == cols && term.row == rows) {
+        Line ln = want == -1   ? top_line_now
+                  : want == -2 ? bot_line_now
+                               : TLINE(want);
+        r = render_row_rgb565(ln, 0, want, cols, rowbuf, (size_t)w * fh);
+      }
+      uint16_t bg = map_st_color(defaultbg);
+      vt_unlock();
+      // Not a row at all, or one that can't be rendered (a resize got
+      // in between): background.
+      if (r.pixel_count != (uint32_t)w * fh) {
+        for (int i = 0; i < w * fh; i++)
+          rowbuf[i] = bg;
+      }
+      band = want;
+    }
+
+    const uint8_t *px = (const uint8_t *)(rowbuf + sub * w);
+    if (!png) {
+      snap_write(file, px, w * 2);
+      continue;
+    }
+    line[0] = 0; // filter: none
+    for (int x = 0; x < w; x++) {
+      uint16_t v = (px[x * 2] << 8) | px[x * 2 + 1];
+      uint8_t r5 = v >> 11, g6 = (v >> 5) & 0x3f, b5 = v & 0x1f;
+      line[1 + x * 3] = (r5 << 3) | (r5 >> 2);
+      line[2 + x * 3] = (g6 << 2) | (g6 >> 4);
+      line[3 + x * 3] = (b5 << 3) | (b5 >> 2);
+    }
+    if (tdefl_compress_buffer(zs, line, 1 + w * 3, TDEFL_NO_FLUSH) !=
+        TDEFL_STATUS_OKAY)
+      mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("png: zlib failed"));
+  }
+
+  if (png) {
+    if (tdefl_compress_buffer(zs, NULL, 0, TDEFL_FINISH) !=
+        TDEFL_STATUS_DONE)
+      mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("png: zlib failed"));
+    snap_png_chunk(file, "IEND", NULL, 0);
+  }
+}
+
+static mp_obj_t vt_VT_snapshot(size_t n_args, const mp_obj_t *pos_args,
+                               mp_map_t *kw_args) {
+  enum { ARG_path, ARG_format };
+  static const mp_arg_t allowed_args[] = {
+      {MP_QSTR_path, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+      {MP_QSTR_format, MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+  };
+  mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+  mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args,
+                   MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+  qstr fmt = args[ARG_format].u_obj == MP_OBJ_NULL
+                 ? MP_QSTR_png
+                 : mp_obj_str_get_qstr(args[ARG_format].u_obj);
+  if (fmt != MP_QSTR_png && fmt != MP_QSTR_raw)
+    mp_raise_ValueError(MP_ERROR_TEXT("format must be 'png' or 'raw'"));
+  bool png = fmt == MP_QSTR_png;
+
+  vt_VT_obj_t *vt = current_vt_obj;
+  if (!vt || vt->font_desc.height == 0)
+    mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("no display"));
+  int w = vt->display_drv->width;
+
+  // Everything that can fail to allocate does so before the file exists.
+  uint16_t *rowbuf = m_new(uint16_t, (size_t)w * vt->font_desc.height);
+  uint8_t *line = png ? m_new(uint8_t, 1 + w * 3) : NULL;
+  mp_obj_t file = MP_OBJ_NULL;
+  tdefl_compressor *zs = NULL;
+  if (png) {
+    zs = m_new_obj(tdefl_compressor);
+    // DEFAULT_MAX_PROBES: a snapshot isn't on any hot path, so take the
+    // smaller file.
+    if (tdefl_init(zs, snap_png_idat, &file,
+                   TDEFL_WRITE_ZLIB_HEADER | TDEFL_DEFAULT_MAX_PROBES) !=
+        TDEFL_STATUS_OKAY)
+      mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("png: zlib failed"));
+  }
+
+  mp_obj_t open_args[2] = {args[ARG_path].u_obj, MP_OBJ_NEW_QSTR(MP_QSTR_wb)};
+  file = mp_vfs_open(2, open_args, (mp_map_t *)&mp_const_empty_map);
+
+  nlr_buf_t nlr;
+  if (nlr_push(&nlr) == 0) {
+    snap_stream(file, png, rowbuf, line, zs);
+    nlr_pop();
+  } else {
+    mp_stream_close(file);
+    nlr_jump(nlr.ret_val);
+  }
+  mp_stream_close(file);
+
+  m_del(uint16_t, rowbuf, (size_t)w * vt->font_desc.height);
+  if (png) {
+    m_del(uint8_t, line, 1 + w * 3);
+    m_del_obj(tdefl_compressor, zs);
+  }
+  return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(vt_VT_snapshot_obj, 2, vt_VT_snapshot);
+
+// vt.record(path) starts logging every byte written to the VT (write(),
+// print() through dupterm -- whatever goes into twrite()) to path as an
+// asciicast v2 file: a JSON header line, then one
+// `[seconds, "o", "text"]` line per write, plus an "r" event whenever
+// the terminal's size changes. `asciinema play` replays it, and feeding
+// the "o" strings back through VT.write() reproduces the screen.
+// vt.record(None) stops and closes the file.
+//
+// Events are escaped into vt_rec.buf and only written out when it
+// fills, or on stop, so recording costs a memcpy-ish pass per write
+// rather than a VFS call. A write error ends the recording quietly: it
+// happens inside print(), which mustn't start raising because of it.
+#define VT_REC_BUF 2048
+
+static struct {
+  char buf[VT_REC_BUF];
+  size_t len;
+  mp_uint_t t0;
+  int cols, rows;   // size last reported in the file
+  uint8_t carry[3]; // a UTF-8 sequence split across two writes
+  int ncarry;
+} vt_rec;
+
+static void vt_rec_close(void) {
+  mp_obj_t file = current_vt_obj->rec_file;
+  current_vt_obj->rec_file = MP_OBJ_NULL;
+  nlr_buf_t nlr;
+  if (nlr_push(&nlr) == 0) {
+    mp_stream_close(file);
+    nlr_pop();
+  }
+}
+
+static void vt_rec_flush(void) {
+  int err = 0;
+  if (vt_rec.len && current_vt_obj->rec_file != MP_OBJ_NULL &&
+      mp_stream_write_exactly(current_vt_obj->rec_file, vt_rec.buf,
+                              vt_rec.len, &err) != vt_rec.len)
+    vt_rec_close();
+  vt_rec.len = 0;
+}
+
+static void vt_rec_put(const char *s, size_t n) {
+  while (n) {
+    if (vt_rec.len == VT_REC_BUF)
+      vt_rec_flush();
+    size_t k = SMIN(n, VT_REC_BUF - vt_rec.len);
+    memcpy(vt_rec.buf + vt_rec.len, s, k);
+    vt_rec.len += k;
+    s += k;
+    n -= k;
+  }
+}
+
+static void vt_rec_byte(uint8_t c) {
+  char esc[7];
+  if (c == '"' || c == '\\') {
+    esc[0] = '\\';
+    esc[1] = c;
+    vt_rec_put(esc, 2);
+  } else if (c < 0x20 || c == 0x7f) {
+    snprintf(esc, sizeof(esc), "\\u%04x", c);
+    vt_rec_put(esc, 6);
+  } else {
+    vt_rec_put((const char *)&c, 1);
+  }
+}
+
+static void vt_rec_event_start(char kind) {
+  char head[32];
+  mp_uint_t ms = mp_hal_ticks_ms() - vt_rec.t0;
+  int n = snprintf(head, sizeof(head), "[%u.%03u, \"%c\", \"",
+                   (unsigned)(ms / 1000), (unsigned)(ms % 1000), kind);
+  vt_rec_put(head, n);
+}
+
+static void vt_record_bytes(const char *buf, size_t size) {
+  if (term.col != vt_rec.cols || term.row != vt_rec.rows) {
+    char dim[24];
+    vt_rec.cols = term.col;
+    vt_rec.rows = term.row;
+    vt_rec_event_start('r');
+    vt_rec_put(dim, snprintf(dim, sizeof(dim), "%dx%d", term.col, term.row));
+    vt_rec_put("\"]\n", 3);
+  }
+
+  // The event text must be whole UTF-8: hold back an incomplete sequence
+  // at the end and send it with the next write instead.
+  size_t total = vt_rec.ncarry + size;
+#define REC_AT(i)                                                           \
+  ((i) < (size_t)vt_rec.ncarry ? vt_rec.carry[i]                           \
+                               : (uint8_t)buf[(i) - vt_rec.ncarry])
+  size_t cut = total;
+  for (size_t back = 1; back <= 3 && back <= total; back++) {
+    uint8_t c = REC_AT(total - back);
+    if ((c & 0xc0) == 0x80)
+      continue; // continuation byte, keep looking for the lead
+    size_t need = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+    if (need > back)
+      cut = total - back;
+    break;
+  }
+
+  if (cut > 0) {
+    vt_rec_event_start('o');
+    for (size_t i = 0; i < cut; i++)
+      vt_rec_byte(REC_AT(i));
+    vt_rec_put("\"]\n", 3);
+  }
+
+  uint8_t tail[3];
+  int ntail = total - cut;
+  for (int i = 0; i < ntail; i++)
+    tail[i] = REC_AT(cut + i);
+#undef REC_AT
+  memcpy(vt_rec.carry, tail, ntail);
+  vt_rec.ncarry = ntail;
+}
+
+static mp_obj_t vt_VT_record(mp_obj_t self_in, mp_obj_t path_obj) {
+  vt_VT_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+  if (self->rec_file != MP_OBJ_NULL) {
+    vt_rec_flush();
+    if (self->rec_file != MP_OBJ_NULL)
+      vt_rec_close();
+  }
+  if (path_obj == mp_const_none)
+    return mp_const_none;
+
+  mp_obj_t open_args[2] = {path_obj, MP_OBJ_NEW_QSTR(MP_QSTR_w)};
+  mp_obj_t file = mp_vfs_open(2, open_args, (mp_map_t *)&mp_const_empty_map);
+
+  char head[96];
+  int n = snprintf(head, sizeof(head),
+                   "{\"version\": 2, \"width\": %d, \"height\": %d}\n",
+                   term.col, term.row);
+  int err = 0;
+  if (mp_stream_write_exactly(file, head, n, &err) != (mp_uint_t)n) {
+    mp_stream_close(file);
+    mp_raise_OSError(err ? err : MP_EIO);
+  }
+
+  vt_rec.len = 0;
+  vt_rec.ncarry = 0;
+  vt_rec.cols = term.col;
+  vt_rec.rows = term.row;
+  vt_rec.t0 = mp_hal_ticks_ms();
+  self->rec_file = file;
+  return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_2(vt_VT_record_obj, vt_VT_record);
+
+// VT.glyph_cache_stats([reset]) -> (hits, misses, capacity). capacity is
+// the number of tiles the cache can hold, 0 if it couldn't be allocated
+// (no PSRAM). Pass reset=True to zero the counters after reading them --
+// handy for measuring one workload at a time when sizing the cache.
+static mp_obj_t vt_VT_glyph_cache_stats(size_t n_args, const mp_obj_t *args) {
+  vt_VT_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+  vt_glyph_cache_t *cache = &self->glyph_cache;
+
+  mp_obj_t items[3] = {
+      mp_obj_new_int_from_uint(cache->hits),
+      mp_obj_new_int_from_uint(cache->misses),
+      MP_OBJ_NEW_SMALL_INT(cache->tile_pixels
+                               ? VT_GLYPH_CACHE_SETS * VT_GLYPH_CACHE_WAYS
+                               : 0),
+  };
+
+  if (n_args > 1 && mp_obj_is_true(args[1])) {
+    cache->hits = 0;
+    cache->misses = 0;
+  }
+
+  return mp_obj_new_tuple(3, items);
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(vt_VT_glyph_cache_stats_obj, 1, 2,
+                                    vt_VT_glyph_cache_stats);
+
 // Locals Dict (Methods attached to the object)
 // Even if empty, it's good practice to define it to avoid segfaults on dir(obj)
 static const mp_rom_map_elem_t vtinal_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_update_layout), MP_ROM_PTR(&vt_VT_update_layout_obj)},
     {MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&vt_VT_write_obj)},
     {MP_ROM_QSTR(MP_QSTR_draw), MP_ROM_PTR(&vt_VT_draw_obj)},
+    {MP_ROM_QSTR(MP_QSTR_autodraw), MP_ROM_PTR(&vt_VT_autodraw_obj)},
     {MP_ROM_QSTR(MP_QSTR_scrollup), MP_ROM_PTR(&vt_VT_scrollup_obj)},
     {MP_ROM_QSTR(MP_QSTR_scrolldown), MP_ROM_PTR(&vt_VT_scrolldown_obj)},
     {MP_ROM_QSTR(MP_QSTR_top_offset), MP_ROM_PTR(&vt_vt_top_offset_obj)},
@@ -307,6 +1476,17 @@ static const mp_rom_map_elem_t vtinal_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_repaint_bars), MP_ROM_PTR(&vt_vt_repaint_bars_obj)},
     {MP_ROM_QSTR(MP_QSTR_set_icon_font), MP_ROM_PTR(&vt_VT_set_icon_font_obj)},
     {MP_ROM_QSTR(MP_QSTR_render_row), MP_ROM_PTR(&vt_VT_render_row_obj)},
+    {MP_ROM_QSTR(MP_QSTR_changed_since),
+     MP_ROM_PTR(&vt_VT_changed_since_obj)},
+    {MP_ROM_QSTR(MP_QSTR_cells), MP_ROM_PTR(&vt_VT_cells_obj)},
+    {MP_ROM_QSTR(MP_QSTR_glyph), MP_ROM_PTR(&vt_VT_glyph_obj)},
+    {MP_ROM_QSTR(MP_QSTR_cursor), MP_ROM_PTR(&vt_VT_cursor_obj)},
+    {MP_ROM_QSTR(MP_QSTR_glyph_cache_stats),
+     MP_ROM_PTR(&vt_VT_glyph_cache_stats_obj)},
+    {MP_ROM_QSTR(MP_QSTR_snapshot), MP_ROM_PTR(&vt_VT_snapshot_obj)},
+    {MP_ROM_QSTR(MP_QSTR_record), MP_ROM_PTR(&vt_VT_record_obj)},
+    {MP_ROM_QSTR(MP_QSTR_console), MP_ROM_PTR(&vt_VT_console_obj)},
+    {MP_ROM_QSTR(MP_QSTR_switch), MP_ROM_PTR(&vt_VT_switch_obj)},
 };
 
 static MP_DEFINE_CONST_DICT(vt_VT_locals_dict, vtinal_locals_dict_table);
@@ -322,6 +1502,11 @@ static void vt_VT_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
     dest[0] = MP_OBJ_NEW_SMALL_INT(term.row);
     return;
   }
+  // True while the console on screen has changes draw() hasn't sent.
+  if (attr == MP_QSTR_damaged) {
+    dest[0] = mp_obj_new_bool(term.damaged);
+    return;
+  }
   mp_map_elem_t *elem = mp_map_lookup((mp_map_t *)&vt_VT_locals_dict.map,
                                       MP_OBJ_NEW_QSTR(attr), MP_MAP_LOOKUP);
   if (elem) {
@@ -335,6 +1520,114 @@ MP_DEFINE_CONST_OBJ_TYPE(vt_VT_type, MP_QSTR_VT, MP_TYPE_FLAG_NONE, make_new,
                          vt_VT_make_new, protocol, &vt_stream_p, attr,
                          vt_VT_attr, locals_dict, &vt_VT_locals_dict);
 
+// vt.Font(buffer) -- a packed font (the VTF container in fb.h, from
+// utils/fontconvert.py --format vtf) to pass wherever a font module goes:
+// VT()'s env.font, update_layout(), set_icon_font(). Nothing is copied --
+// the glyphs are drawn straight out of `buffer`, which the Font keeps
+// alive (so don't resize a bytearray under it). WIDTH/HEIGHT/FIRST/LAST
+// read like a font module's, so code sizing the grid from env.font works
+// with either.
+
+static mp_obj_t vt_font_new(mp_obj_t owner, const uint8_t *p, size_t len) {
+  size_t size = vt_vtf_check(p, len);
+  if (size == 0)
+    mp_raise_ValueError(MP_ERROR_TEXT("not a VTF font"));
+  vt_font_obj_t *self = mp_obj_malloc(vt_font_obj_t, &vt_Font_type);
+  self->owner = owner;
+  self->data = p;
+  memcpy(&self->hdr, p, sizeof(self->hdr));
+  return MP_OBJ_FROM_PTR(self);
+}
+
+static mp_obj_t vt_Font_make_new(const mp_obj_type_t *type, size_t n_args,
+                                 size_t n_kw, const mp_obj_t *args) {
+  mp_arg_check_num(n_args, n_kw, 1, 1, false);
+  mp_buffer_info_t buf;
+  mp_get_buffer_raise(args[0], &buf, MP_BUFFER_READ);
+  return vt_font_new(args[0], buf.buf, buf.len);
+}
+
+static void vt_Font_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
+  vt_font_obj_t *self = MP_OBJ_TO_PTR(self_in);
+  if (dest[0] != MP_OBJ_NULL)
+    return; // read-only
+  if (attr == MP_QSTR_WIDTH) {
+    dest[0] = MP_OBJ_NEW_SMALL_INT(self->hdr.width);
+  } else if (attr == MP_QSTR_HEIGHT) {
+    dest[0] = MP_OBJ_NEW_SMALL_INT(self->hdr.height);
+  } else if (attr == MP_QSTR_FIRST) {
+    dest[0] = mp_obj_new_int_from_uint(self->hdr.first);
+  } else if (attr == MP_QSTR_LAST) {
+    dest[0] = mp_obj_new_int_from_uint(self->hdr.last);
+  } else if (attr == MP_QSTR_name) {
+    dest[0] = mp_obj_new_str(self->hdr.name,
+                             strnlen(self->hdr.name, VTF_NAME_MAX));
+  }
+}
+
+MP_DEFINE_CONST_OBJ_TYPE(vt_Font_type, MP_QSTR_Font, MP_TYPE_FLAG_NONE,
+                         make_new, vt_Font_make_new, attr, vt_Font_attr);
+
+// Data partitions vt.flash_font() has mapped. A mapping is never undone:
+// any Font handed out may still point into it.
+#define VT_FLASH_MAPS 2
+
+static struct {
+  const esp_partition_t *part;
+  const uint8_t *base;
+} vt_flash_maps[VT_FLASH_MAPS];
+
+static const uint8_t *vt_flash_map(const esp_partition_t *part) {
+  int i;
+
+  for (i = 0; i < VT_FLASH_MAPS && vt_flash_maps[i].part; i++) {
+    if (vt_flash_maps[i].part == part)
+      return vt_flash_maps[i].base;
+  }
+  if (i == VT_FLASH_MAPS)
+    return NULL;
+
+  const void *base;
+  esp_partition_mmap_handle_t handle;
+  if (esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &base,
+                         &handle) != ESP_OK)
+    return NULL;
+  vt_flash_maps[i].part = part;
+  vt_flash_maps[i].base = base;
+  return base;
+}
+
+// vt.flash_font(name, label="fonts") -> Font or None. Looks `name` up
+// among the VTF containers written back to back into data partition
+// `label` (utils/fontconvert.py --format vtf, concatenated at 4-byte
+// boundaries) and returns it as a Font drawn straight from flash -- no
+// heap beyond the Font object itself. None when there is no such
+// partition or font, so callers can fall back to a font module.
+static mp_obj_t vt_flash_font(size_t n_args, const mp_obj_t *args) {
+  const char *name = mp_obj_str_get_str(args[0]);
+  const char *label = n_args > 1 ? mp_obj_str_get_str(args[1]) : "fonts";
+
+  const esp_partition_t *part = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (!part)
+    return mp_const_none;
+  const uint8_t *base = vt_flash_map(part);
+  if (!base)
+    return mp_const_none;
+
+  size_t off = 0, size;
+  while (off < part->size &&
+         (size = vt_vtf_check(base + off, part->size - off)) != 0) {
+    const vt_vtf_header_t *hdr = (const vt_vtf_header_t *)(base + off);
+    if (strncmp(hdr->name, name, VTF_NAME_MAX) == 0)
+      return vt_font_new(MP_OBJ_NULL, base + off, size);
+    off += (size + 3) & ~(size_t)3;
+  }
+  return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(vt_flash_font_obj, 1, 2,
+                                           vt_flash_font);
+
 //  Module Definition
 
 // machine.reset_cause() buckets ESP-IDF's ESP_RST_INT_WDT/ESP_RST_TASK_WDT/
@@ -350,6 +1643,8 @@ static MP_DEFINE_CONST_FUN_OBJ_0(vt_reset_reason_obj, vt_reset_reason);
 static const mp_rom_map_elem_t vt_module_globals_table[] = {
     {MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_vt)},
     {MP_ROM_QSTR(MP_QSTR_VT), MP_ROM_PTR(&vt_VT_type)},
+    {MP_ROM_QSTR(MP_QSTR_Font), MP_ROM_PTR(&vt_Font_type)},
+    {MP_ROM_QSTR(MP_QSTR_flash_font), MP_ROM_PTR(&vt_flash_font_obj)},
     {MP_ROM_QSTR(MP_QSTR_reset_reason), MP_ROM_PTR(&vt_reset_reason_obj)},
 };
 
@@ -40,7 +40,10 @@ int xsetcursor(int);
 void xsetmode(int, unsigned int);
 void xsetpointermotion(int);
 void xsetsel(char *);
+int xscroll(int);
 int xstartdraw(void);
 void xximspot(int, int);
+void xdamage(void);
+void xreply(const char *, size_t);
 
 #endif
@@ -14,13 +14,63 @@
 // ───────────────────────────────────────────────────────────
 
 // stream_obj is kept only for draw() and repaint_bars() calls.
-// All ANSI output goes through mp_hal_stdout_tx_strn so it reaches both
-// the USB serial REPL and the LCD (via dupterm → KVM → term).
+// Output normally goes straight into the terminal's grid -- see
+// vttui_direct() below. Otherwise it is ANSI through mp_hal_stdout_tx_strn,
+// so it reaches both the USB serial REPL and the LCD (via dupterm → KVM →
+// term).
 static mp_obj_t vttui_stream_obj = MP_OBJ_NULL;
 
+// Defined in modules/vt (vt_module.c and st.c).
+extern bool vt_direct_begin(void);
+extern void vt_direct_end(void);
+extern void tgridcursor(int x, int y);
+extern void tgridsgr(const int *attr, int l);
+extern int tgridput(const char *s, int len);
+extern int tgridputn(uint32_t u, int n);
+extern void tgridfill(int x, int y, int w, int h, uint32_t u);
+extern int twrite(const char *buf, int buflen, int show_ctrl);
+extern size_t utf8decode(const char *c, uint32_t *u, size_t clen);
+
+// Every helper below has two ways out. With the direct path -- the usual
+// case, whenever no KVM mirror or VT.record() needs the byte stream --
+// the helper does to the grid what its escape sequence would have, with
+// vt_direct_begin() having taken the terminal's lock; a widget repaint is
+// then a few cell stores per run instead of hundreds of bytes through
+// dupterm, kvm_write() and the st parser. Otherwise (or when it returns
+// false) the helper writes ANSI as it always has.
+static bool vttui_direct(void) {
+  return vttui_stream_obj != MP_OBJ_NULL && vt_direct_begin();
+}
+
+// Length of the UTF-8 sequence that starts with c (1 for a stray byte).
+static int utf8_seq_len(unsigned char c) {
+  return c < 0xc0 ? 1 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+}
+
+// Text that tgridput() can't store by itself -- embedded escapes, control
+// characters, a wrap -- goes through twrite() one rune at a time until it
+// can again.
+static void vttui_direct_text(const char *buf, size_t len) {
+  while (len > 0) {
+    int n = tgridput(buf, (int)len);
+    if (n == 0) {
+      n = utf8_seq_len((unsigned char)*buf);
+      if ((size_t)n > len || twrite(buf, n, 0) == 0)
+        break; // incomplete sequence at the end: dropped, as twrite() would
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+}
+
 static void vttui_write(const char *buf, size_t len) {
   if (vttui_stream_obj == MP_OBJ_NULL || len == 0)
     return;
+  if (vttui_direct()) {
+    vttui_direct_text(buf, len);
+    vt_direct_end();
+    return;
+  }
   mp_hal_stdout_tx_strn(buf, len);
 }
 
@@ -45,8 +95,36 @@ static int write_uint(char *buf, unsigned int n) {
   return len;
 }
 
+// The direct path's SGR 0;{1;}38;5;fg;48;5;bg. Colors past 255 -- the
+// 256/257 "terminal default" values widgets use -- are left out instead
+// of handed to st for tdefcolor() to reject: the 0 already set the
+// defaults, which is where the ANSI path ends up too.
+static void vttui_direct_pen(uint32_t fg, uint32_t bg, bool bold) {
+  int attr[8], n = 0;
+  attr[n++] = 0;
+  if (bold)
+    attr[n++] = 1;
+  if (fg < 256) {
+    attr[n++] = 38;
+    attr[n++] = 5;
+    attr[n++] = (int)fg;
+  }
+  if (bg < 256) {
+    attr[n++] = 48;
+    attr[n++] = 5;
+    attr[n++] = (int)bg;
+  }
+  tgridsgr(attr, n);
+}
+
 // ESC[row+1;col+1H  ESC[0;{1;}38;5;fg;48;5;bgm
 static void vttui_begin(int col, int row, uint32_t fg, uint32_t bg, bool bold) {
+  if (vttui_direct()) {
+    tgridcursor(col, row);
+    vttui_direct_pen(fg, bg, bold);
+    vt_direct_end();
+    return;
+  }
   // fg/bg/row/col are meant to be small (ANSI-256 index, screen
   // coordinate) but nothing clamps them before they get here -- write_uint()
   // emits up to 10 digits for a full uint32_t, and the worst case (two
@@ -87,6 +165,11 @@ static void vttui_begin(int col, int row, uint32_t fg, uint32_t bg, bool bold) {
 
 // ESC[0;{1;}38;5;fg;48;5;bgm  (color only, no cursor move)
 static void vttui_sgr(uint32_t fg, uint32_t bg, bool bold) {
+  if (vttui_direct()) {
+    vttui_direct_pen(fg, bg, bold);
+    vt_direct_end();
+    return;
+  }
   // See the same-sized-concern comment in vttui_begin() above -- worst
   // case (two 10-digit colors) is 38 bytes, not the ~24 the expected
   // 3-digit-color case needs.
@@ -119,6 +202,11 @@ static void vttui_sgr(uint32_t fg, uint32_t bg, bool bold) {
 
 // ESC[row+1;col+1H  (position only, no attribute change)
 static void vttui_move(int col, int row) {
+  if (vttui_direct()) {
+    tgridcursor(col, row);
+    vt_direct_end();
+    return;
+  }
   // Same headroom concern as vttui_begin()/vttui_sgr(): a negative row/col
   // (e.g. from a miscalculated scroll position) becomes a huge value once
   // cast to unsigned, and write_uint() can emit up to 10 digits for each
@@ -135,8 +223,34 @@ static void vttui_move(int col, int row) {
   vttui_write(buf, i);
 }
 
+// ESC[0m / ESC[1m
+static void vttui_reset(void) {
+  static const int reset = 0;
+  if (vttui_direct()) {
+    tgridsgr(&reset, 1);
+    vt_direct_end();
+    return;
+  }
+  vttui_write_str("\033[0m");
+}
+
+static void vttui_bold(void) {
+  static const int bold = 1;
+  if (vttui_direct()) {
+    tgridsgr(&bold, 1);
+    vt_direct_end();
+    return;
+  }
+  vttui_write_str("\033[1m");
+}
+
 static void write_spaces(int n) {
   static const char sp32[] = "                                ";
+  // Whatever the direct path can't place (a wrap) falls through below.
+  if (n > 0 && vttui_direct()) {
+    n -= tgridputn(' ', n);
+    vt_direct_end();
+  }
   while (n >= 32) {
     vttui_write(sp32, 32);
     n -= 32;
@@ -145,7 +259,29 @@ static void write_spaces(int n) {
     vttui_write(sp32, n);
 }
 
+// Paints w x h cells at col, row blank in fg/bg without the per-row
+// cursor moves and padding -- the direct path's fill-rect. Leaves the pen
+// reset, like render_label_raw(). Returns false when the caller has to
+// draw the rows the ANSI way instead.
+static bool vttui_fill(int col, int row, int w, int h, uint32_t fg,
+                       uint32_t bg) {
+  static const int reset = 0;
+  if (w <= 0 || h <= 0 || !vttui_direct())
+    return false;
+  vttui_direct_pen(fg, bg, false);
+  tgridfill(col, row, w, h, ' ');
+  tgridsgr(&reset, 1);
+  vt_direct_end();
+  return true;
+}
+
 static void write_repeat_str(const char *s, size_t slen, int n) {
+  if (n > 0 && vttui_direct()) {
+    uint32_t u;
+    if (utf8decode(s, &u, slen) == slen)
+      n -= tgridputn(u, n);
+    vt_direct_end();
+  }
   for (int i = 0; i < n; i++)
     vttui_write(s, slen);
 }
@@ -195,7 +331,7 @@ static void render_label_raw(int start_x, int y, const char *text,
     vttui_write(text, (size_t)chars);
   write_spaces(suffix);
 
-  vttui_write_str("\033[0m");
+  vttui_reset();
 }
 
 // Arrow is stored as raw UTF-8 bytes (up to 4) so multi-byte chars work.
@@ -227,7 +363,7 @@ static void render_list_item(int x, int y, const char *text, size_t text_len,
   remaining -= chars;
 
   write_spaces(remaining);
-  vttui_write_str("\033[0m");
+  vttui_reset();
 }
 
 // Renders a (possibly multi-line, '\n'-separated, and/or word/char-wrapped)
@@ -313,10 +449,15 @@ typedef struct _vttui_label_obj_t {
   bool dirty;
 } vttui_label_obj_t;
 
+#define VTTUI_SEARCH_MAX 32
+#define VTTUI_SEARCH_MS 1000 // type-ahead starts over after this long idle
+
 typedef struct _vttui_list_obj_t {
   mp_obj_base_t base;
-  mp_obj_t items;
+  mp_obj_t items; // a sequence, or a callable items(i) -> str (count=)
+  bool items_fn;
   int item_count;
+  uint8_t *item_rows; // list_item_rows() cache, 0 = not counted yet
   int x, y;
   int width, height;
   uint32_t fg, bg;
@@ -331,6 +472,9 @@ typedef struct _vttui_list_obj_t {
   bool decorations;
   bool multiline; // items may contain '\n' and span multiple rows
   bool wrap;      // auto-wrap item text to the list's item width
+  char search[VTTUI_SEARCH_MAX]; // type-ahead typed so far, see search()
+  int search_len;
+  mp_uint_t search_ms;
 } vttui_list_obj_t;
 
 typedef struct _vttui_window_obj_t {
@@ -358,6 +502,15 @@ typedef struct _vttui_input_obj_t {
   bool decorations;
 } vttui_input_obj_t;
 
+// One line of a VTBlock's text, without its '\n'. buf is kept when the
+// slot is reused, so a scrolling block stops allocating once its lines
+// have grown to the longest it has seen.
+typedef struct {
+  char *buf;
+  int len, cap;
+  int rows; // display rows at the block's width, -1 until counted
+} vttui_line_t;
+
 typedef struct _vttui_block_obj_t {
   mp_obj_base_t base;
   int abs_x, abs_y;
@@ -366,7 +519,12 @@ typedef struct _vttui_block_obj_t {
   bool scroll;
   bool wrap;
   uint32_t fg, bg; // baseline color; inherited from parent or explicitly set
-  mp_obj_t text_obj;
+  // The text, one record per '\n'-separated line -- see block_new_line().
+  vttui_line_t *lines;
+  int line_cap;   // slots in lines[]
+  int line_first; // slot holding the oldest line
+  int nlines;     // lines held
+  bool line_open; // the newest line hasn't seen its '\n' yet
   bool dirty;
 } vttui_block_obj_t;
 
@@ -488,6 +646,16 @@ static vttui_label_obj_t *create_label(mp_obj_t text_obj, int rel_x, int rel_y,
 static bool list_is_multirow(vttui_list_obj_t *self);
 static int list_text_width(vttui_list_obj_t *self);
 
+// Item idx. A list made from a callable only ever asks it for the items
+// it is about to draw or measure, so a directory of thousands of entries
+// costs nothing up front, and scrolling costs the rows on screen.
+static mp_obj_t list_item(vttui_list_obj_t *self, int idx) {
+  mp_obj_t i = MP_OBJ_NEW_SMALL_INT(idx);
+  if (self->items_fn)
+    return mp_call_function_1(self->items, i);
+  return mp_obj_subscr(self->items, i, MP_OBJ_SENTINEL);
+}
+
 static mp_obj_t vttui_list_draw(mp_obj_t self_in) {
   vttui_list_obj_t *self = MP_OBJ_TO_PTR(self_in);
   bool first_draw = (self->last_scroll == -1);
@@ -514,11 +682,11 @@ static mp_obj_t vttui_list_draw(mp_obj_t self_in) {
           int n1 = (inner - label_w) / 2;
           int n2 = inner - label_w - n1;
           write_repeat_str(BOX_H, 3, n1);
-          vttui_write_str("\033[1m");
+          vttui_bold();
           vttui_write(" ", 1);
           vttui_write(title, tlen);
           vttui_write(" ", 1);
-          vttui_write_str("\033[0m");
+          vttui_reset();
           vttui_begin(x + 1 + n1 + label_w, y, self->fg, self->bg, false);
           write_repeat_str(BOX_H, 3, n2);
         } else {
@@ -527,17 +695,21 @@ static mp_obj_t vttui_list_draw(mp_obj_t self_in) {
       } else {
         write_repeat_str(BOX_H, 3, w - 2);
       }
-      vttui_write_str(BOX_TR "\033[0m");
+      vttui_write_str(BOX_TR);
+      vttui_reset();
       for (int row = 1; row < h - 1; row++) {
         vttui_begin(x, y + row, self->fg, self->bg, false);
-        vttui_write_str(BOX_V "\033[0m");
+        vttui_write_str(BOX_V);
+        vttui_reset();
         vttui_begin(x + w - 1, y + row, self->fg, self->bg, false);
-        vttui_write_str(BOX_V "\033[0m");
+        vttui_write_str(BOX_V);
+        vttui_reset();
       }
       vttui_begin(x, y + h - 1, self->fg, self->bg, false);
       vttui_write_str(BOX_BL);
       write_repeat_str(BOX_H, 3, w - 2);
-      vttui_write_str(BOX_BR "\033[0m");
+      vttui_write_str(BOX_BR);
+      vttui_reset();
     }
   } else {
     item_x = self->x;
@@ -566,8 +738,7 @@ static mp_obj_t vttui_list_draw(mp_obj_t self_in) {
         uint32_t fg = is_sel ? self->sel_fg : self->fg;
         uint32_t bg = is_sel ? self->sel_bg : self->bg;
 
-        mp_obj_t item = mp_obj_subscr(
-            self->items, MP_OBJ_NEW_SMALL_INT(item_idx), MP_OBJ_SENTINEL);
+        mp_obj_t item = list_item(self, item_idx);
         size_t text_len;
         const char *text = mp_obj_str_get_data(item, &text_len);
         int used = render_list_item_multiline(
@@ -604,8 +775,7 @@ static mp_obj_t vttui_list_draw(mp_obj_t self_in) {
         continue;
       }
 
-      mp_obj_t item = mp_obj_subscr(self->items, MP_OBJ_NEW_SMALL_INT(item_idx),
-                                    MP_OBJ_SENTINEL);
+      mp_obj_t item = list_item(self, item_idx);
       size_t text_len;
       const char *text = mp_obj_str_get_data(item, &text_len);
       render_list_item(item_x, row, text, text_len, item_w, fg, bg, self->arrow,
@@ -642,11 +812,15 @@ static int list_text_width(vttui_list_obj_t *self) {
 // Number of screen rows item `idx` occupies: 1 unless multiline/wrap is
 // enabled, in which case it's the sum of wrapped-row counts across each
 // '\n'-delimited line (wrap-splitting only happens if self->wrap is set).
+// Counted once per item and cached in item_rows[].
 static int list_item_rows(vttui_list_obj_t *self, int idx) {
   if (!list_is_multirow(self))
     return 1;
-  mp_obj_t item =
-      mp_obj_subscr(self->items, MP_OBJ_NEW_SMALL_INT(idx), MP_OBJ_SENTINEL);
+  if (!self->item_rows)
+    self->item_rows = m_new0(uint8_t, self->item_count);
+  if (self->item_rows[idx])
+    return self->item_rows[idx];
+  mp_obj_t item = list_item(self, idx);
   size_t len;
   const char *text = mp_obj_str_get_data(item, &len);
   int text_width = self->wrap ? list_text_width(self) : 0;
@@ -664,7 +838,25 @@ static int list_item_rows(vttui_list_obj_t *self, int idx) {
       ls = p + 1;
     }
   }
-  return rows > 0 ? rows : 1;
+  if (rows < 1)
+    rows = 1;
+  self->item_rows[idx] = rows < 255 ? rows : 255;
+  return rows;
+}
+
+// Scrolls a multi-row list down from `scroll` just far enough that items
+// [scroll, sel] fit in vis_h rows, or sel is at the top if it alone
+// doesn't. Walks back from sel, so it measures no more items than fit.
+static int list_fit_scroll(vttui_list_obj_t *self, int scroll, int sel,
+                           int vis_h) {
+  int first = sel, rows = list_item_rows(self, sel);
+  while (first > scroll) {
+    rows += list_item_rows(self, first - 1);
+    if (rows > vis_h)
+      break;
+    first--;
+  }
+  return first;
 }
 
 static void list_set_selected(vttui_list_obj_t *self, int idx) {
@@ -681,25 +873,106 @@ static void list_set_selected(vttui_list_obj_t *self, int idx) {
     else if (self->selected >= self->scroll + vis_h)
       self->scroll = self->selected - vis_h + 1;
   } else {
-    // scroll is an item index (not a row count); walk it so that the run of
-    // items [scroll, selected] fits within vis_h screen rows.
-    if (self->selected < self->scroll) {
+    // scroll is an item index (not a row count); move it so that the run
+    // of items [scroll, selected] fits within vis_h screen rows.
+    if (self->selected < self->scroll)
       self->scroll = self->selected;
-    } else {
-      while (self->scroll < self->selected) {
-        int rows = 0;
-        for (int i = self->scroll; i <= self->selected; i++)
-          rows += list_item_rows(self, i);
-        if (rows <= vis_h)
-          break;
-        self->scroll++;
-      }
-    }
+    else if (self->selected >= 0)
+      self->scroll =
+          list_fit_scroll(self, self->scroll, self->selected, vis_h);
   }
   if (self->on_change != mp_const_none)
     mp_call_function_1(self->on_change, MP_OBJ_NEW_SMALL_INT(self->selected));
 }
 
+static void list_set_count(vttui_list_obj_t *self, int count) {
+  if (count < 0)
+    mp_raise_ValueError(MP_ERROR_TEXT("count must be >= 0"));
+  if (self->item_rows)
+    m_del(uint8_t, self->item_rows, self->item_count);
+  self->item_rows = NULL;
+  self->item_count = count;
+  if (self->scroll >= count)
+    self->scroll = count > 0 ? count - 1 : 0;
+  if (self->last_scroll != -1)
+    self->last_scroll = -2; // not -1: the frame stays, every item redraws
+  if (count > 0)
+    list_set_selected(self, self->selected);
+  else
+    self->selected = 0;
+}
+
+// Whether the visible text of s -- color escapes skipped -- starts with
+// prefix, ignoring ASCII case.
+static bool list_text_starts_with(const char *s, size_t len, const char *prefix,
+                                  int plen) {
+  size_t i = 0;
+  int j = 0;
+  while (j < plen && i < len) {
+    if (s[i] == '\033') {
+      i++;
+      if (i < len && s[i] == '[') {
+        i++;
+        while (i < len && ((unsigned char)s[i] < 0x40 ||
+                           (unsigned char)s[i] > 0x7e))
+          i++;
+      }
+      i++;
+      continue;
+    }
+    char a = s[i++], b = prefix[j++];
+    if (a >= 'A' && a <= 'Z')
+      a += 'a' - 'A';
+    if (b >= 'A' && b <= 'Z')
+      b += 'a' - 'A';
+    if (a != b)
+      return false;
+  }
+  return j == plen;
+}
+
+// search(text) -> bool: type-ahead. text is added to what was typed
+// before -- unless that was more than VTTUI_SEARCH_MS ago, or search(None)
+// cleared it -- and the selection moves to the first item whose text
+// starts with the lot, ignoring case and colors. A fresh search starts
+// after the selected item, so typing the same letter again steps through
+// the items starting with it; a longer prefix starts at the selected
+// item, which keeps it as long as it still matches. Returns False, with
+// the selection unchanged, if nothing matches.
+static mp_obj_t vttui_list_search(mp_obj_t self_in, mp_obj_t text_obj) {
+  vttui_list_obj_t *self = MP_OBJ_TO_PTR(self_in);
+  mp_uint_t now = mp_hal_ticks_ms();
+  if (text_obj == mp_const_none || now - self->search_ms > VTTUI_SEARCH_MS)
+    self->search_len = 0;
+  self->search_ms = now;
+  if (text_obj == mp_const_none)
+    return mp_const_false;
+
+  size_t len;
+  const char *text = mp_obj_str_get_data(text_obj, &len);
+  bool fresh = (self->search_len == 0);
+  if (len > (size_t)(VTTUI_SEARCH_MAX - self->search_len))
+    len = VTTUI_SEARCH_MAX - self->search_len;
+  memcpy(self->search + self->search_len, text, len);
+  self->search_len += (int)len;
+  if (self->search_len == 0 || self->item_count == 0)
+    return mp_const_false;
+
+  int start = self->selected + (fresh ? 1 : 0);
+  for (int k = 0; k < self->item_count; k++) {
+    int idx = (start + k) % self->item_count;
+    size_t ilen;
+    const char *item = mp_obj_str_get_data(list_item(self, idx), &ilen);
+    if (list_text_starts_with(item, ilen, self->search, self->search_len)) {
+      if (idx != self->selected)
+        list_set_selected(self, idx);
+      return mp_const_true;
+    }
+  }
+  return mp_const_false;
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(vttui_list_search_obj, vttui_list_search);
+
 static mp_obj_t vttui_list_up(mp_obj_t self_in) {
   vttui_list_obj_t *self = MP_OBJ_TO_PTR(self_in);
   if (self->selected > 0)
@@ -727,6 +1000,7 @@ static const mp_rom_map_elem_t vttui_list_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_up), MP_ROM_PTR(&vttui_list_up_obj)},
     {MP_ROM_QSTR(MP_QSTR_down), MP_ROM_PTR(&vttui_list_down_obj)},
     {MP_ROM_QSTR(MP_QSTR_select), MP_ROM_PTR(&vttui_list_select_obj)},
+    {MP_ROM_QSTR(MP_QSTR_search), MP_ROM_PTR(&vttui_list_search_obj)},
 };
 static MP_DEFINE_CONST_DICT(vttui_list_locals_dict,
                             vttui_list_locals_dict_table);
@@ -741,8 +1015,11 @@ static void vttui_list_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
       return;
     }
     if (attr == MP_QSTR_value) {
-      dest[0] = mp_obj_subscr(self->items, MP_OBJ_NEW_SMALL_INT(self->selected),
-                              MP_OBJ_SENTINEL);
+      dest[0] = list_item(self, self->selected);
+      return;
+    }
+    if (attr == MP_QSTR_count) {
+      dest[0] = MP_OBJ_NEW_SMALL_INT(self->item_count);
       return;
     }
     mp_map_elem_t *elem = mp_map_lookup((mp_map_t *)&vttui_list_locals_dict.map,
@@ -755,13 +1032,18 @@ static void vttui_list_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
   }
 
   if (dest[0] == MP_OBJ_SENTINEL) {
-    // Store. `index` is the only writable attribute: setting it moves the
-    // selection (and adjusts scroll, and fires on_change) exactly like
-    // calling select(idx).
+    // Store. Setting `index` moves the selection (and adjusts scroll, and
+    // fires on_change) exactly like calling select(idx).
     if (attr == MP_QSTR_index) {
       list_set_selected(self, mp_obj_get_int(dest[1]));
       dest[0] = MP_OBJ_NULL; // signal success
     }
+    // Setting `count` says the items changed: they are all measured and
+    // drawn afresh on the next draw().
+    if (attr == MP_QSTR_count) {
+      list_set_count(self, mp_obj_get_int(dest[1]));
+      dest[0] = MP_OBJ_NULL;
+    }
     return;
   }
 }
@@ -790,6 +1072,7 @@ static const mp_arg_t make_list_args[] = {
     {MP_QSTR_decorations, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false}},
     {MP_QSTR_multiline, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false}},
     {MP_QSTR_wrap, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false}},
+    {MP_QSTR_count, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1}},
 };
 
 static vttui_list_obj_t *create_list(mp_arg_val_t *args, int abs_x, int abs_y,
@@ -797,7 +1080,17 @@ static vttui_list_obj_t *create_list(mp_arg_val_t *args, int abs_x, int abs_y,
   vttui_list_obj_t *list = m_new_obj(vttui_list_obj_t);
   list->base.type = &vttui_list_type;
   list->items = args[0].u_obj;
-  list->item_count = mp_obj_get_int(mp_obj_len(list->items));
+  list->items_fn = mp_obj_is_callable(list->items);
+  if (list->items_fn) {
+    if (args[18].u_int < 0)
+      mp_raise_ValueError(MP_ERROR_TEXT("items callable needs count="));
+    list->item_count = args[18].u_int;
+  } else {
+    list->item_count = mp_obj_get_int(mp_obj_len(list->items));
+  }
+  list->item_rows = NULL;
+  list->search_len = 0;
+  list->search_ms = 0;
   list->x = abs_x;
   list->y = abs_y;
   list->width = width;
@@ -820,15 +1113,8 @@ static vttui_list_obj_t *create_list(mp_arg_val_t *args, int abs_x, int abs_y,
   if (!list_is_multirow(list)) {
     list->scroll = (sel >= vis_h) ? sel - vis_h + 1 : 0;
   } else {
-    list->scroll = 0;
-    while (list->scroll < sel) {
-      int rows = 0;
-      for (int i = list->scroll; i <= sel; i++)
-        rows += list_item_rows(list, i);
-      if (rows <= vis_h)
-        break;
-      list->scroll++;
-    }
+    list->scroll =
+        list->item_count > 0 ? list_fit_scroll(list, 0, sel, vis_h) : 0;
   }
 
   list->last_selected = -1;
@@ -891,7 +1177,7 @@ static mp_obj_t vttui_input_draw(mp_obj_t self_in) {
     vttui_write("\xe2\x94\x8c", 3);
     write_repeat_str("\xe2\x94\x80", 3, inner_w);
     vttui_write("\xe2\x94\x90", 3);
-    vttui_write_str("\033[0m");
+    vttui_reset();
   }
 
   // Content row
@@ -918,7 +1204,7 @@ static mp_obj_t vttui_input_draw(mp_obj_t self_in) {
     vttui_sgr(self->fg, self->bg, self->bold);
     vttui_write(" \xe2\x94\x82", 4);
   }
-  vttui_write_str("\033[0m");
+  vttui_reset();
 
   if (self->decorations) {
     // Row 2: └───┘
@@ -927,7 +1213,7 @@ static mp_obj_t vttui_input_draw(mp_obj_t self_in) {
     vttui_write("\xe2\x94\x94", 3);
     write_repeat_str("\xe2\x94\x80", 3, inner_w);
     vttui_write("\xe2\x94\x98", 3);
-    vttui_write_str("\033[0m");
+    vttui_reset();
   }
 
   // Park cursor at end of typed text
@@ -1165,29 +1451,112 @@ static int line_display_rows(const char *s, int len, bool wrap, int width) {
   return rows > 0 ? rows : 1;
 }
 
+// VTBlock's line ring. push() used to concatenate onto one Python string,
+// rescan the whole of it for newlines to trim it and slice off a new
+// copy, and draw() walked all of it twice more -- O(n) allocation and
+// scanning per message for a chat window. The text is kept as a ring of
+// line records instead: push() touches only the lines it adds, each
+// line's wrapped row count is counted once, and draw() starts from the
+// newest line and goes back only as far as the window needs.
+//
+// A scrolling block with a height holds `height` lines -- each takes at
+// least one row, so that always fills the window -- and reuses the
+// oldest slot for each new one. A fixed one holds the first `height`
+// lines and drops the rest, which would never be shown. With no height
+// the ring grows as needed.
+
+#define VTTUI_BLOCK_MIN_LINES 8
+
+static vttui_line_t *block_line(vttui_block_obj_t *self, int i) {
+  return &self->lines[(self->line_first + i) % self->line_cap];
+}
+
+// The slot for a new newest line, or NULL if it's to be dropped.
+static vttui_line_t *block_new_line(vttui_block_obj_t *self) {
+  if (self->nlines == self->line_cap) {
+    if (self->height > 0 && !self->scroll)
+      return NULL;
+    if (self->height > 0) {
+      self->line_first = (self->line_first + 1) % self->line_cap;
+      self->nlines--;
+    } else {
+      int cap = self->line_cap * 2;
+      vttui_line_t *lines = m_new0(vttui_line_t, cap);
+      for (int i = 0; i < self->nlines; i++)
+        lines[i] = *block_line(self, i);
+      m_del(vttui_line_t, self->lines, self->line_cap);
+      self->lines = lines;
+      self->line_cap = cap;
+      self->line_first = 0;
+    }
+  }
+  vttui_line_t *l = block_line(self, self->nlines++);
+  l->len = 0;
+  l->rows = -1;
+  return l;
+}
+
+static void block_line_append(vttui_line_t *l, const char *s, int n) {
+  l->rows = -1;
+  if (n == 0)
+    return;
+  if (l->len + n > l->cap) {
+    int cap = l->cap * 2;
+    if (cap < l->len + n)
+      cap = l->len + n;
+    if (cap < 32)
+      cap = 32;
+    l->buf = m_renew(char, l->buf, l->cap, cap);
+    l->cap = cap;
+  }
+  memcpy(l->buf + l->len, s, n);
+  l->len += n;
+}
+
+// Appends text to the block, continuing the newest line if it was left
+// open.
+static void block_append(vttui_block_obj_t *self, const char *s, size_t len) {
+  while (len > 0) {
+    const char *nl = memchr(s, '\n', len);
+    size_t n = nl ? (size_t)(nl - s) : len;
+    vttui_line_t *l = self->line_open ? block_line(self, self->nlines - 1)
+                                      : block_new_line(self);
+    if (l)
+      block_line_append(l, s, (int)n);
+    self->line_open = l && !nl;
+    if (!nl)
+      break;
+    s += n + 1;
+    len -= n + 1;
+  }
+}
+
+static void block_clear(vttui_block_obj_t *self) {
+  self->line_first = 0;
+  self->nlines = 0;
+  self->line_open = false;
+}
+
+static int block_line_rows(vttui_block_obj_t *self, vttui_line_t *l) {
+  if (l->rows < 0)
+    l->rows = line_display_rows(l->buf, l->len, self->wrap, self->width);
+  return l->rows;
+}
+
 static mp_obj_t vttui_block_draw(mp_obj_t self_in) {
   vttui_block_obj_t *self = MP_OBJ_TO_PTR(self_in);
   if (!self->dirty)
     return mp_const_none;
   self->dirty = false;
 
-  size_t text_len;
-  const char *text = mp_obj_str_get_data(self->text_obj, &text_len);
-  const char *end = text + text_len;
-
-  // Count total display rows for scroll offset
-  int skip_rows = 0;
+  // Walk back from the newest line until the window is full; the rows of
+  // the first line above it are skipped
+  int first = 0, skip_rows = 0;
   if (self->scroll && self->height > 0) {
     int total = 0;
-    const char *ls = text;
-    for (const char *p = text; p <= end; p++) {
-      if (p == end || *p == '\n') {
-        if (p == end && p == ls)
-          break; // skip trailing empty segment
-        total += line_display_rows(ls, (int)(p - ls), self->wrap, self->width);
-        ls = p + 1;
-      }
-    }
+    first = self->nlines;
+    while (first > 0 && total < self->height)
+      total += block_line_rows(self, block_line(self, --first));
     skip_rows = total - self->height;
     if (skip_rows < 0)
       skip_rows = 0;
@@ -1196,65 +1565,62 @@ static mp_obj_t vttui_block_draw(mp_obj_t self_in) {
   // Render, skipping the first `skip_rows` display rows
   int display_row = 0; // display rows consumed so far
   int screen_row = 0;  // rows rendered to screen
-  const char *ls = text;
 
-  for (const char *p = text; p <= end; p++) {
+  for (int i = first; i < self->nlines; i++) {
     if (self->height > 0 && screen_row >= self->height)
       break;
-    if (p == end || *p == '\n') {
-      int line_len = (int)(p - ls);
-      if (p == end && line_len == 0)
-        break; // skip trailing empty segment
-
-      if (self->wrap && self->width > 0) {
-        // Emit wrapped chunks
-        int remaining = line_len;
-        const char *pos = ls;
-        bool first_chunk = true;
-        while (first_chunk || remaining > 0) {
-          int cl =
-              remaining > 0 ? next_chunk_len(pos, remaining, self->width) : 0;
-          if (display_row >= skip_rows) {
-            if (self->height > 0 && screen_row >= self->height)
-              break;
-            vttui_move(self->abs_x, self->abs_y + screen_row);
-            vttui_sgr(self->fg, self->bg, false);
-            if (self->width > 0)
-              write_spaces(self->width);
-            vttui_move(self->abs_x, self->abs_y + screen_row);
-            vttui_sgr(self->fg, self->bg, false);
-            if (!first_chunk)
-              replay_ansi_state(ls, pos, self->fg, self->bg);
-            write_block_text(pos, cl, self->fg, self->bg);
-            screen_row++;
-          }
-          display_row++;
-          if (cl == 0)
-            break;
-          pos += cl;
-          remaining -= cl;
-          first_chunk = false;
-        }
-      } else {
+    vttui_line_t *l = block_line(self, i);
+    const char *ls = l->buf;
+    int line_len = l->len;
+
+    if (self->wrap && self->width > 0) {
+      // Emit wrapped chunks
+      int remaining = line_len;
+      const char *pos = ls;
+      bool first_chunk = true;
+      while (first_chunk || remaining > 0) {
+        int cl =
+            remaining > 0 ? next_chunk_len(pos, remaining, self->width) : 0;
         if (display_row >= skip_rows) {
+          if (self->height > 0 && screen_row >= self->height)
+            break;
           vttui_move(self->abs_x, self->abs_y + screen_row);
           vttui_sgr(self->fg, self->bg, false);
           if (self->width > 0)
             write_spaces(self->width);
           vttui_move(self->abs_x, self->abs_y + screen_row);
           vttui_sgr(self->fg, self->bg, false);
-          write_block_text(ls, line_len, self->fg, self->bg);
+          if (!first_chunk)
+            replay_ansi_state(ls, pos, self->fg, self->bg);
+          write_block_text(pos, cl, self->fg, self->bg);
           screen_row++;
         }
         display_row++;
+        if (cl == 0)
+          break;
+        pos += cl;
+        remaining -= cl;
+        first_chunk = false;
       }
-
-      ls = p + 1;
+    } else {
+      if (display_row >= skip_rows) {
+        vttui_move(self->abs_x, self->abs_y + screen_row);
+        vttui_sgr(self->fg, self->bg, false);
+        if (self->width > 0)
+          write_spaces(self->width);
+        vttui_move(self->abs_x, self->abs_y + screen_row);
+        vttui_sgr(self->fg, self->bg, false);
+        write_block_text(ls, line_len, self->fg, self->bg);
+        screen_row++;
+      }
+      display_row++;
     }
   }
 
   // Fill remaining rows with background color
-  if (self->height > 0 && self->width > 0) {
+  if (self->height > 0 && self->width > 0 &&
+      !vttui_fill(self->abs_x, self->abs_y + screen_row, self->width,
+                  self->height - screen_row, self->fg, self->bg)) {
     while (screen_row < self->height) {
       vttui_move(self->abs_x, self->abs_y + screen_row);
       vttui_sgr(self->fg, self->bg, false);
@@ -1269,44 +1635,22 @@ static MP_DEFINE_CONST_FUN_OBJ_1(vttui_block_draw_obj, vttui_block_draw);
 
 static mp_obj_t vttui_block_set(mp_obj_t self_in, mp_obj_t text_obj) {
   vttui_block_obj_t *self = MP_OBJ_TO_PTR(self_in);
-  self->text_obj = text_obj;
+  size_t len;
+  const char *text = mp_obj_str_get_data(text_obj, &len);
+  block_clear(self);
+  block_append(self, text, len);
   self->dirty = true;
   return mp_const_none;
 }
 static MP_DEFINE_CONST_FUN_OBJ_2(vttui_block_set_obj, vttui_block_set);
 
+// Appends text; with scroll=True and a height only the last `height`
+// lines are kept, so memory stays bounded.
 static mp_obj_t vttui_block_push(mp_obj_t self_in, mp_obj_t text_obj) {
   vttui_block_obj_t *self = MP_OBJ_TO_PTR(self_in);
-
-  // Append new text
-  self->text_obj = mp_binary_op(MP_BINARY_OP_ADD, self->text_obj, text_obj);
-
-  // Trim to last `height` lines so memory stays bounded
-  if (self->scroll && self->height > 0) {
-    size_t len;
-    const char *text = mp_obj_str_get_data(self->text_obj, &len);
-    int nl_count = 0;
-    for (size_t i = 0; i < len; i++) {
-      if (text[i] == '\n')
-        nl_count++;
-    }
-    // If text ends with \n the trailing empty segment isn't a visible line
-    int visible_lines =
-        (len > 0 && text[len - 1] == '\n') ? nl_count : nl_count + 1;
-    int skip = visible_lines - self->height;
-    if (skip > 0) {
-      int skipped = 0;
-      for (size_t i = 0; i < len; i++) {
-        if (text[i] == '\n') {
-          if (++skipped >= skip) {
-            self->text_obj = mp_obj_new_str(text + i + 1, len - i - 1);
-            break;
-          }
-        }
-      }
-    }
-  }
-
+  size_t len;
+  const char *text = mp_obj_str_get_data(text_obj, &len);
+  block_append(self, text, len);
   self->dirty = true;
   return mp_const_none;
 }
@@ -1356,7 +1700,11 @@ static vttui_block_obj_t *create_block(mp_arg_val_t *args, int abs_x, int abs_y,
   blk->height = height > 0 ? height : 0;
   blk->scroll = scroll;
   blk->wrap = wrap;
-  blk->text_obj = args[0].u_obj;
+  blk->line_cap = blk->height > 0 ? blk->height : VTTUI_BLOCK_MIN_LINES;
+  blk->lines = m_new0(vttui_line_t, blk->line_cap);
+  size_t len;
+  const char *text = mp_obj_str_get_data(args[0].u_obj, &len);
+  block_append(blk, text, len);
   blk->dirty = true;
   return blk;
 }
@@ -1384,7 +1732,7 @@ static void render_dialog_buttons(vttui_dialog_obj_t *self, int inner_x,
     vttui_write_str("[ ");
     vttui_write(b1, b1len);
     vttui_write_str(" ]");
-    vttui_write_str("\033[0m");
+    vttui_reset();
     return;
   }
 
@@ -1407,7 +1755,7 @@ static void render_dialog_buttons(vttui_dialog_obj_t *self, int inner_x,
   vttui_write_str("[ ");
   vttui_write(b1, b1len);
   vttui_write_str(" ]");
-  vttui_write_str("\033[0m");
+  vttui_reset();
 
   vttui_sgr(self->fg, self->bg, false);
   vttui_write_str("   ");
@@ -1416,7 +1764,7 @@ static void render_dialog_buttons(vttui_dialog_obj_t *self, int inner_x,
   vttui_write_str("[ ");
   vttui_write(b2, b2len);
   vttui_write_str(" ]");
-  vttui_write_str("\033[0m");
+  vttui_reset();
 }
 
 static mp_obj_t vttui_dialog_draw(mp_obj_t self_in) {
@@ -1442,9 +1790,10 @@ static mp_obj_t vttui_dialog_draw(mp_obj_t self_in) {
 
   if (first_draw) {
     // Clear inner area
-    for (int row = 0; row < inner_h; row++)
-      render_label_raw(inner_x, inner_y + row, "", 0, inner_w, self->fg,
-                       self->bg, false, 0);
+    if (!vttui_fill(inner_x, inner_y, inner_w, inner_h, self->fg, self->bg))
+      for (int row = 0; row < inner_h; row++)
+        render_label_raw(inner_x, inner_y + row, "", 0, inner_w, self->fg,
+                         self->bg, false, 0);
 
     // Border with title
     if (self->decorations) {
@@ -1459,11 +1808,11 @@ static mp_obj_t vttui_dialog_draw(mp_obj_t self_in) {
           int n1 = (inner - label_w) / 2;
           int n2 = inner - label_w - n1;
           write_repeat_str(BOX_H, 3, n1);
-          vttui_write_str("\033[1m");
+          vttui_bold();
           vttui_write(" ", 1);
           vttui_write(title, tlen);
           vttui_write(" ", 1);
-          vttui_write_str("\033[0m");
+          vttui_reset();
           vttui_begin(x + 1 + n1 + label_w, y, self->fg, self->bg, false);
           write_repeat_str(BOX_H, 3, n2);
         } else {
@@ -1472,17 +1821,21 @@ static mp_obj_t vttui_dialog_draw(mp_obj_t self_in) {
       } else {
         write_repeat_str(BOX_H, 3, w - 2);
       }
-      vttui_write_str(BOX_TR "\033[0m");
+      vttui_write_str(BOX_TR);
+      vttui_reset();
       for (int row = 1; row < h - 1; row++) {
         vttui_begin(x, y + row, self->fg, self->bg, false);
-        vttui_write_str(BOX_V "\033[0m");
+        vttui_write_str(BOX_V);
+        vttui_reset();
         vttui_begin(x + w - 1, y + row, self->fg, self->bg, false);
-        vttui_write_str(BOX_V "\033[0m");
+        vttui_write_str(BOX_V);
+        vttui_reset();
       }
       vttui_begin(x, y + h - 1, self->fg, self->bg, false);
       vttui_write_str(BOX_BL);
       write_repeat_str(BOX_H, 3, w - 2);
-      vttui_write_str(BOX_BR "\033[0m");
+      vttui_write_str(BOX_BR);
+      vttui_reset();
     }
 
     // Question text — split on \n, center each line, skip last row (buttons)
@@ -1615,6 +1968,9 @@ static vttui_dialog_obj_t *create_dialog(mp_arg_val_t *args, int abs_x,
 // ─────────────────────────────────────────────────────────────────
 
 static void render_window_bg(vttui_window_obj_t *win) {
+  if (vttui_fill(win->inner_x, win->inner_y, win->inner_w, win->inner_h,
+                 win->fg, win->bg))
+    return;
   for (int row = 0; row < win->inner_h; row++) {
     render_label_raw(win->inner_x, win->inner_y + row, "", 0, win->inner_w,
                      win->fg, win->bg, false, 0);
@@ -1635,11 +1991,11 @@ static void render_window_border(vttui_window_obj_t *win) {
       int n1 = (inner - label_w) / 2;
       int n2 = inner - label_w - n1;
       write_repeat_str(BOX_H, 3, n1);
-      vttui_write_str("\033[1m"); // bold title
+      vttui_bold(); // bold title
       vttui_write(" ", 1);
       vttui_write(title, tlen);
       vttui_write(" ", 1);
-      vttui_write_str("\033[0m");
+      vttui_reset();
       vttui_begin(x + 1 + n1 + label_w, y, win->fg, win->bg, false);
       write_repeat_str(BOX_H, 3, n2);
     } else {
@@ -1648,21 +2004,25 @@ static void render_window_border(vttui_window_obj_t *win) {
   } else {
     write_repeat_str(BOX_H, 3, w - 2);
   }
-  vttui_write_str(BOX_TR "\033[0m");
+  vttui_write_str(BOX_TR);
+  vttui_reset();
 
   // Side borders
   for (int row = 1; row < h - 1; row++) {
     vttui_begin(x, y + row, win->fg, win->bg, false);
-    vttui_write_str(BOX_V "\033[0m");
+    vttui_write_str(BOX_V);
+    vttui_reset();
     vttui_begin(x + w - 1, y + row, win->fg, win->bg, false);
-    vttui_write_str(BOX_V "\033[0m");
+    vttui_write_str(BOX_V);
+    vttui_reset();
   }
 
   // Bottom border: └──────┘
   vttui_begin(x, y + h - 1, win->fg, win->bg, false);
   vttui_write_str(BOX_BL);
   write_repeat_str(BOX_H, 3, w - 2);
-  vttui_write_str(BOX_BR "\033[0m");
+  vttui_write_str(BOX_BR);
+  vttui_reset();
 }
 
 static mp_obj_t vttui_clear_screen(mp_obj_t self_in) {
@@ -13,6 +13,9 @@
 # `fonttools`), then point this script at the resulting .bdf file.
 
 import sys
+import io
+import struct
+import contextlib
 from PIL import Image, ImageFont, ImageDraw
 import argparse
 
@@ -37,6 +40,35 @@ STATUSBAR_ICONS = ''.join(chr(c) for c in (0xE015, 0xE152, 0xE048, 0xE033, 0xE00
 # matching st.c's st_wcwidth() marking these codepoints ATTR_WIDE.
 WIDE_SYM = ''.join(chr(c) for c in range(0x2654, 0x2660))
 
+def parse_ranges(spec):
+    """'0x370-0x3ff,0x2800-0x28ff,0x2122' -> those codepoints, as a str."""
+    chars = []
+    for part in spec.split(','):
+        part = part.strip()
+        if not part:
+            continue
+        lo, _, hi = part.partition('-')
+        lo = int(lo, 0)
+        hi = int(hi, 0) if hi else lo
+        chars.extend(chr(c) for c in range(lo, hi + 1))
+    return ''.join(chars)
+
+
+def glyph_set(base, spec, glyphs=None):
+    """`base` plus the --ranges/--wide-ranges codepoints in `spec`, without
+    duplicates or anything REGULAR already covers. With a BDF's `glyphs`,
+    range codepoints the font has no glyph for are left out rather than
+    stored blank -- a range like all of CJK is mostly holes in most fonts."""
+    seen = set(base) | set(CHARACTERS)
+    out = [base]
+    for c in parse_ranges(spec or ''):
+        if c in seen or (glyphs is not None and ord(c) not in glyphs):
+            continue
+        seen.add(c)
+        out.append(c)
+    return ''.join(out)
+
+
 def font_kind(path):
     lower = path.lower()
     if lower.endswith('.bdf'):
@@ -195,6 +227,92 @@ def emit_block(varname, bitstring):
     print(f'\n{varname} = memoryview(_{varname})')
 
 
+# Packed font container, --format vtf: the same blocks as a font module,
+# laid out so vt.Font()/vt.flash_font() can draw from them in place. The
+# layout (and the block ids) is documented with vt_vtf_header_t in
+# modules/vt/fb.h; keep the two in step.
+VTF_MAGIC = b'VTF1'
+VTF_NAME_MAX = 24
+VTF_REGULAR, VTF_BOLD, VTF_UNICODE, VTF_ICONS, VTF_WIDE = range(1, 6)
+VTF_PAGED = 0x100
+VTF_NONE = 0xffff
+VTF_HEADER = struct.Struct('<4sI24sBBBBIIHH')
+VTF_BLOCK = struct.Struct('<7I')
+VTF_INDEX = struct.Struct('<IHH')
+
+
+def vtf_index(chars):
+    """An index for glyph slots 0..len(chars)-1: (index bytes, count,
+    paged). Paged -- a BMP page directory, then 256-slot pages -- whenever
+    every codepoint is in the BMP and it comes out no bigger than the
+    sorted list; past a few hundred glyphs it nearly always does."""
+    pages = {}
+    for slot, cp in enumerate(chars):
+        pages.setdefault(cp >> 8, [VTF_NONE] * 256)[cp & 0xff] = slot
+    paged_size = 2 * 256 * (1 + len(pages))
+    if (chars and max(chars) <= 0xffff and len(chars) < VTF_NONE
+            and paged_size <= VTF_INDEX.size * len(chars)):
+        order = sorted(pages)
+        directory = [VTF_NONE] * 256
+        for n, hi in enumerate(order):
+            directory[hi] = n
+        words = directory + [w for hi in order for w in pages[hi]]
+        return struct.pack(f'<{len(words)}H', *words), len(order), True
+    index = b''.join(VTF_INDEX.pack(cp, slot, 0)
+                     for slot, cp in sorted(enumerate(chars), key=lambda e: e[1]))
+    return index, len(chars), False
+
+
+def vtf_pack(ns, name):
+    """Packs a font module's globals (as emitted by emit_module(), or read
+    back from a generated fonts/*.py) into one VTF container."""
+    blocks = []
+
+    def add(block_id, key, first=0, count=0, chars=()):
+        if ns.get(key) is not None:
+            blocks.append((block_id, bytes(ns[key]), first, count, tuple(chars)))
+
+    add(VTF_REGULAR, 'REGULAR')
+    # BOLD = REGULAR aliases cost nothing in a module; don't store them
+    # twice here -- fb.c falls back to REGULAR when there is no BOLD.
+    if ns.get('BOLD') is not ns.get('REGULAR'):
+        add(VTF_BOLD, 'BOLD')
+    add(VTF_UNICODE, 'UNICODE_FONT', chars=ns.get('UNICODE_CHARS') or ())
+    add(VTF_ICONS, 'ICONS', ns.get('ICON_FIRST', 0), ns.get('ICON_COUNT', 0))
+    if 'WIDE_FIRST' in ns and 'WIDE_COUNT' in ns:
+        add(VTF_WIDE, 'WIDE_FONT', ns['WIDE_FIRST'], ns['WIDE_COUNT'],
+            ns.get('WIDE_CHARS') or ())
+    else:
+        add(VTF_WIDE, 'WIDE_FONT', chars=ns.get('WIDE_CHARS') or ())
+
+    def align(n):
+        return (n + 3) & ~3
+
+    off = VTF_HEADER.size + VTF_BLOCK.size * len(blocks)
+    table = b''
+    data = b''
+    for block_id, bitmap, first, count, chars in blocks:
+        bitmap_off = align(off)
+        data += bytes(bitmap_off - off) + bitmap
+        off = bitmap_off + len(bitmap)
+        index_off = align(off)
+        index, index_count, paged = vtf_index(chars)
+        data += bytes(index_off - off) + index
+        off = index_off + len(index)
+        table += VTF_BLOCK.pack(block_id | (VTF_PAGED if paged else 0),
+                                bitmap_off, len(bitmap), first, count,
+                                index_off if chars else 0, index_count)
+    data += bytes(align(off) - off)
+    size = align(off)
+
+    header = VTF_HEADER.pack(VTF_MAGIC, size, name.encode()[:VTF_NAME_MAX],
+                             ns.get('WIDTH', 0), ns.get('HEIGHT', 0),
+                             ns.get('WIDE_WIDTH', 0), ns.get('WIDE_HEIGHT', 0),
+                             ns.get('FIRST', 0), ns.get('LAST', 0),
+                             len(blocks), 0)
+    return header + table + data
+
+
 def main():
     parser = argparse.ArgumentParser(prog='fontconvert')
     parser.add_argument('font_file', help='Path to the regular font file (.ttf/.otf or .bdf)')
@@ -208,14 +326,51 @@ def main():
                         help='Include double-width unicode characters (currently Chess Symbols, '
                              'U+2654-265F) as a separate WIDE_FONT block, rendered at 2x the '
                              'normal character width -- see ATTR_WIDE handling in st.c/fb.c')
+    parser.add_argument('--ranges', default=None,
+                        help='Extra single-width codepoints for the UNICODE_FONT block, e.g. '
+                             '0x370-0x3ff,0x400-0x4ff,0x2500-0x259f,0x2800-0x28ff '
+                             '(Greek, Cyrillic, box drawing/blocks, braille)')
+    parser.add_argument('--wide-ranges', default=None,
+                        help='Extra double-width codepoints for the WIDE_FONT block, e.g. '
+                             '0x3000-0x30ff,0x4e00-0x9fff,0xac00-0xd7a3 (CJK) -- see '
+                             'st_wcwidth() in st.c for what the terminal treats as wide')
     parser.add_argument('--icons', action='store_true', help='iconic font only')
     parser.add_argument('--statusbar-icons', action='store_true',
                         help='With --icons --wide-unicode: use the curated 6-icon '
                              'STATUSBAR_ICONS set instead of the full ~400-icon range')
     parser.add_argument('--force-height', type=int, help='Force a specific pixel height boundary', default=None)
     parser.add_argument('--force-width', type=int, help='Force a specific pixel width boundary', default=None)
+    parser.add_argument('--format', choices=('py', 'vtf', 'vtf-py'), default='py',
+                        help='py: a font module (default); vtf: a packed font container, '
+                             'written raw to stdout, for a fonts partition (see fontpack.py); '
+                             'vtf-py: the same container as a module defining VTF, to freeze')
+    parser.add_argument('--name', default='',
+                        help='Font name stored in the container -- what vt.flash_font() '
+                             'looks up, e.g. terminus_mpy_14. Required for --format vtf')
     args = parser.parse_args()
 
+    if args.format == 'py':
+        emit_module(parser, args)
+        return
+    if args.format == 'vtf' and not args.name:
+        parser.error('--format vtf needs --name')
+
+    # Packing works from the module's own globals, so both formats carry
+    # exactly what a font module would.
+    module = io.StringIO()
+    with contextlib.redirect_stdout(module):
+        emit_module(parser, args)
+    ns = {}
+    exec(module.getvalue(), ns)
+    blob = vtf_pack(ns, args.name)
+    if args.format == 'vtf':
+        sys.stdout.buffer.write(blob)
+    else:
+        emit_block('VTF', ''.join(f'{b:08b}' for b in blob))
+
+
+def emit_module(parser, args):
+
     bpp = BPP
     try:
         kind = font_kind(args.font_file)
@@ -323,23 +478,25 @@ def main():
             else:
                 print('\nBOLD_ITALIC = BOLD')
 
-            if args.unicode:
-                codepoints = ', '.join(hex(ord(c)) for c in UNICODE_SYM)
+            unicode_chars = glyph_set(UNICODE_SYM if args.unicode else '', args.ranges, reg_glyphs)
+            if unicode_chars:
+                codepoints = ', '.join(hex(ord(c)) for c in unicode_chars)
                 print()
                 print(f'UNICODE_CHARS = ({codepoints},)')
                 print()
                 emit_block('UNICODE_FONT', encode_chars_bdf(
-                    UNICODE_SYM, reg_glyphs, char_width, char_height, canvas_top, canvas_left, bpp, args.font_file))
+                    unicode_chars, reg_glyphs, char_width, char_height, canvas_top, canvas_left, bpp, args.font_file))
 
-            if args.wide_unicode:
+            wide_chars = glyph_set(WIDE_SYM if args.wide_unicode else '', args.wide_ranges, reg_glyphs)
+            if wide_chars:
                 wide_width = char_width * 2
-                codepoints = ', '.join(hex(ord(c)) for c in WIDE_SYM)
+                codepoints = ', '.join(hex(ord(c)) for c in wide_chars)
                 print()
                 print(f'WIDE_CHARS = ({codepoints},)')
                 print(f'WIDE_WIDTH = {wide_width}')
                 print()
                 emit_block('WIDE_FONT', encode_chars_bdf(
-                    WIDE_SYM, reg_glyphs, wide_width, char_height, canvas_top, canvas_left, bpp, args.font_file))
+                    wide_chars, reg_glyphs, wide_width, char_height, canvas_top, canvas_left, bpp, args.font_file))
 
         return
 
@@ -418,22 +575,24 @@ def main():
         print('\nBOLD_ITALIC = BOLD')
 
     # Emit UNICODE Block (Using Regular Font Metrics)
-    if args.unicode:
-        codepoints = ', '.join(hex(ord(c)) for c in UNICODE_SYM)
+    unicode_chars = glyph_set(UNICODE_SYM if args.unicode else '', args.ranges)
+    if unicode_chars:
+        codepoints = ', '.join(hex(ord(c)) for c in unicode_chars)
         print()
         print(f'UNICODE_CHARS = ({codepoints},)')
         print()
-        emit_block('UNICODE_FONT', encode_chars_ttf(UNICODE_SYM, reg_font, char_width, char_height, y_offset, bpp, sample_p, remap, palette))
+        emit_block('UNICODE_FONT', encode_chars_ttf(unicode_chars, reg_font, char_width, char_height, y_offset, bpp, sample_p, remap, palette))
 
     # Emit WIDE Block (double-width characters, e.g. Chess Symbols)
-    if args.wide_unicode:
+    wide_chars = glyph_set(WIDE_SYM if args.wide_unicode else '', args.wide_ranges)
+    if wide_chars:
         wide_width = char_width * 2
-        codepoints = ', '.join(hex(ord(c)) for c in WIDE_SYM)
+        codepoints = ', '.join(hex(ord(c)) for c in wide_chars)
         print()
         print(f'WIDE_CHARS = ({codepoints},)')
         print(f'WIDE_WIDTH = {wide_width}')
         print()
-        emit_block('WIDE_FONT', encode_chars_ttf(WIDE_SYM, reg_font, wide_width, char_height, y_offset, bpp, sample_p, remap, palette))
+        emit_block('WIDE_FONT', encode_chars_ttf(wide_chars, reg_font, wide_width, char_height, y_offset, bpp, sample_p, remap, palette))
 
 
 if __name__ == '__main__':
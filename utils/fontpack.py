@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+
+# Builds a fonts partition image for vt.flash_font() out of font modules
+# already generated by fontconvert.py (the ones in modules/scripts/fonts),
+# so they can be drawn straight from flash instead of being imported.
+#
+#   python3 fontpack.py -o fonts.bin ../modules/scripts/fonts/*_mpy_*.py
+#
+# Each module becomes one VTF container (see fontconvert.py's vtf_pack()),
+# named after the module -- the name main.py's update_font() is given --
+# and the containers are written back to back at 4-byte boundaries.
+#
+# A .vtf file is taken as it is, under the name it was built with. That's
+# the way in for fonts too big to ever be a module, e.g. Unifont with
+# Greek, Cyrillic, box drawing, braille and CJK -- ~1.4MB, drawn from
+# flash through its paged index:
+#
+#   python3 fontconvert.py unifont-16.0.04.bdf 16 -u --wide-unicode \
+#       --ranges 0xa0-0x24f,0x370-0x52f,0x2000-0x2bff \
+#       --wide-ranges 0x2e80-0x9fff,0xac00-0xd7a3,0xff00-0xff60 \
+#       --format vtf --name unifont_full_16 > unifont_full_16.vtf
+#   python3 fontpack.py -o fonts.bin unifont_full_16.vtf ...
+#
+# The stock partition table has no fonts partition. Add one, e.g.
+#
+#   fonts,      data, 0x40,     0x420000, 0x200000,
+#
+# (shrinking vfs to match -- which reformats it), then flash the image
+# with `parttool.py write_partition --partition-name fonts --input
+# fonts.bin`. Without the partition, vt.flash_font() returns None and
+# fonts load from their modules exactly as before.
+
+import argparse
+import os
+import sys
+
+from fontconvert import vtf_pack, VTF_HEADER, VTF_MAGIC, VTF_NAME_MAX
+
+
+def main():
+    parser = argparse.ArgumentParser(prog='fontpack')
+    parser.add_argument('modules', nargs='+',
+                        help='Generated font modules (fonts/*.py) or fontconvert.py --format vtf files')
+    parser.add_argument('-o', '--output', required=True, help='Partition image to write')
+    parser.add_argument('--size', type=lambda v: int(v, 0), default=None,
+                        help='Partition size; fail if the image does not fit')
+    args = parser.parse_args()
+
+    image = b''
+    for path in args.modules:
+        name = os.path.splitext(os.path.basename(path))[0]
+        if path.endswith('.vtf'):
+            with open(path, 'rb') as f:
+                blob = f.read()
+            if not blob.startswith(VTF_MAGIC):
+                parser.error(f'{path}: not a VTF container')
+            name = VTF_HEADER.unpack_from(blob)[2].rstrip(b'\0').decode()
+            blob += bytes(-len(blob) % 4)
+        else:
+            if len(name.encode()) > VTF_NAME_MAX:
+                parser.error(f'{name}: name longer than {VTF_NAME_MAX} bytes')
+            ns = {}
+            with open(path) as f:
+                exec(f.read(), ns)
+            blob = vtf_pack(ns, name)
+        print(f'{name}: {len(blob)} bytes at 0x{len(image):x}', file=sys.stderr)
+        image += blob
+
+    if args.size is not None and len(image) > args.size:
+        parser.error(f'image is {len(image)} bytes, partition is {args.size}')
+    with open(args.output, 'wb') as f:
+        f.write(image)
+
+
+if __name__ == '__main__':
+    main()